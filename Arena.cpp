@@ -0,0 +1,61 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Arena.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "Arena.h"
+#include "Debug.h"
+
+void* Arena::allocate(uint32_t size, uint32_t align)
+{
+	uint32_t start = (used + align - 1) & ~(align - 1);
+
+	if (start + size > ARENA_SIZE || start + size < start)
+	{
+		debugMsg(DebugError, "Arena: out of memory (%i bytes requested, %i of %i used)",
+				 size, used, ARENA_SIZE);
+		failed = true;
+		return NULL;
+	}
+
+	last = start;
+	used = start + size;
+	if (used > high_water)
+		high_water = used;
+
+	return &memory[start];
+}
+
+// Gives back the end of the last allocation
+void Arena::shrink(void* ptr, uint32_t size)
+{
+	uint32_t start = (uint8_t*) ptr - memory;
+
+	if (start == last && start + size <= used)
+		used = start + size;
+}
+
+void Arena::reset()
+{
+	used = 0;
+	last = 0;
+	failed = false;
+}
@@ -0,0 +1,86 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Arena.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <Arduino.h>
+#include <new>
+
+#ifndef ARENA_SIZE
+#define ARENA_SIZE				4096
+#endif
+
+// Fixed-size bump allocator for the objects created from the configuration
+// (IO pins and their file lists). They are laid out one after the other in
+// a static block and released all together with reset(). Running out of
+// space makes allocate() return NULL, always at the same point for a given
+// configuration.
+class Arena
+{
+public:
+	static Arena& getInstance()
+	{
+		static Arena instance;
+		return instance;
+	}
+
+	void* allocate(uint32_t size, uint32_t align = 4);
+	void shrink(void* ptr, uint32_t size);
+	void reset();
+
+	inline uint32_t getUsed() { return used; }
+	inline uint32_t getHighWater() { return high_water; }
+	inline uint32_t getSize() { return ARENA_SIZE; }
+
+	// True if an allocation failed since the last reset()
+	inline bool exhausted() { return failed; }
+
+	// Constructs an object in the arena
+	template <typename T, typename... Args>
+	T* create(Args... args)
+	{
+		void* mem = allocate(sizeof(T), alignof(T));
+		return mem ? new (mem) T(args...) : NULL;
+	}
+
+	// Destroys an object created with create(). The memory is
+	// only given back with reset().
+	template <typename T>
+	static void destroy(T* obj)
+	{
+		if (obj)
+			obj->~T();
+	}
+
+private:
+	Arena() : used(0), last(0), high_water(0), failed(false) {}
+
+	alignas(8) uint8_t memory[ARENA_SIZE];
+	uint32_t used;
+	uint32_t last;
+	uint32_t high_water;
+	bool failed;
+};
+
+#endif /* __ARENA_H__ */
@@ -0,0 +1,97 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### BootProfile.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __BOOTPROFILE_H__
+#define __BOOTPROFILE_H__
+
+#include <Arduino.h>
+#include "Debug.h"
+
+// Boot phases, in the order they complete
+enum BootPhase
+{
+	BootPhaseLeds,
+	BootPhaseConfig,
+	BootPhaseAudio,
+	BootPhaseMode,
+	BootPhaseAudioReady,
+	BootPhaseReady,
+	BootPhaseWake,				// Last wake from suspend
+	BootPhaseWakeSound,			// First sound after the last wake
+	BootPhasesCount
+};
+
+// Records when every boot phase finished, in microseconds since reset,
+// and when the board last woke from suspend. A phase that didn't run
+// (or hasn't finished yet) reads as 0.
+class BootProfile
+{
+public:
+	static BootProfile& getInstance()
+	{
+		static BootProfile instance;
+		return instance;
+	}
+
+	inline void mark(BootPhase phase)
+	{
+		if (phase < BootPhasesCount)
+			timestamps[phase] = micros();
+	}
+
+	inline uint32_t get(BootPhase phase)
+	{
+		return phase < BootPhasesCount ? timestamps[phase] : 0;
+	}
+
+	void report()
+	{
+#if ENABLE_DEBUG
+		static const char* const names[BootPhasesCount] =
+		{
+			"LEDs", "config", "audio", "mode", "audio ready", "ready", "wake", "wake sound"
+		};
+
+		uint32_t last = 0;
+
+		for (uint8_t i = 0; i < BootPhasesCount; i++)
+		{
+			if (!timestamps[i])
+				continue;
+
+			debugMsg(DebugInfo, "Boot %s at %i us (+%i us)", names[i], timestamps[i], timestamps[i] - last);
+			last = timestamps[i];
+		}
+#endif
+	}
+
+private:
+	BootProfile()
+	{
+		memset(timestamps, 0, sizeof(timestamps));
+	}
+
+	uint32_t timestamps[BootPhasesCount];
+};
+
+#endif /* __BOOTPROFILE_H__ */
@@ -0,0 +1,197 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ClockGovernor.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "ClockGovernor.h"
+#include "Mixer.h"
+#include "Debug.h"
+
+// Prescaler fields in RCC_CFGR
+#define HPRE_POS				4
+#define PPRE1_POS				10
+#define PPRE2_POS				13
+
+// HPRE is 0xxx for /1 and 1xxx for /2 to /16,
+// PPREx is 0xx for /1 and 1xx for /2 to /16
+static uint8_t hpreShift(uint32_t cfgr)
+{
+	uint32_t bits = (cfgr & RCC_CFGR_HPRE) >> HPRE_POS;
+	return (bits & 0x8) ? (bits & 0x7) + 1 : 0;
+}
+
+static uint8_t ppreShift(uint32_t cfgr, uint32_t mask, uint32_t pos)
+{
+	uint32_t bits = (cfgr & mask) >> pos;
+	return (bits & 0x4) ? (bits & 0x3) + 1 : 0;
+}
+
+static uint32_t hpreBits(uint8_t shift)
+{
+	return shift ? (0x8 | (shift - 1)) << HPRE_POS : 0;
+}
+
+static uint32_t ppreBits(uint8_t shift, uint32_t pos)
+{
+	return shift ? (0x4 | (shift - 1)) << pos : 0;
+}
+
+ClockGovernor::ClockGovernor() :
+	enabled(false), level(0), levels(0), load(0), hpre_shift(0), ppre1_shift(0),
+	ppre2_shift(0), systick_load(0), hold_until(0), last_poll(0), last_cycles(0), last_busy(0),
+	refill_cycles(0)
+{
+}
+
+bool ClockGovernor::begin()
+{
+	uint32_t cfgr = RCC->CFGR;
+
+	hpre_shift = hpreShift(cfgr);
+	ppre1_shift = ppreShift(cfgr, RCC_CFGR_PPRE1, PPRE1_POS);
+	ppre2_shift = ppreShift(cfgr, RCC_CFGR_PPRE2, PPRE2_POS);
+	systick_load = SysTick->LOAD;
+
+	// The core clock can be divided up to 16, and the buses
+	// have to stay divided by 2 at least
+	levels = GOVERNOR_MAX_LEVEL;
+	if (hpre_shift + levels > 4)
+		levels = (hpre_shift < 4) ? 4 - hpre_shift : 0;
+	if (ppre1_shift < levels + 1)
+		levels = ppre1_shift ? ppre1_shift - 1 : 0;
+	if (ppre2_shift < levels + 1)
+		levels = ppre2_shift ? ppre2_shift - 1 : 0;
+
+	// The SysTick reload has to be divisible too
+	while (levels && ((systick_load + 1) & ((1 << levels) - 1)))
+		levels--;
+
+	if (!levels)
+	{
+		debugMsg(DebugWarning, "Clock governor - the bus prescalers don't allow scaling");
+		return false;
+	}
+
+	// The mixing time is measured in core cycles
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	last_poll = GetTickCount();
+	last_cycles = DWT->CYCCNT;
+	last_busy = AudioMixer::getInstance().getBusyCycles();
+	refill_cycles = 0;
+	hold_until = last_poll + GOVERNOR_HOLD_MS;
+	enabled = true;
+
+	debugMsg(DebugInfo, "Clock governor - %i levels", levels);
+	return true;
+}
+
+void ClockGovernor::end()
+{
+	setLevel(0);
+	enabled = false;
+}
+
+void ClockGovernor::boost()
+{
+	if (!enabled)
+		return;
+
+	setLevel(0);
+	hold_until = GetTickCount() + GOVERNOR_HOLD_MS;
+}
+
+void ClockGovernor::poll(uint8_t voices)
+{
+	uint32_t now = GetTickCount();
+	uint8_t target;
+
+	if (!enabled || now - last_poll < GOVERNOR_PERIOD_MS)
+		return;
+
+	uint32_t cycles = DWT->CYCCNT;
+	uint32_t busy = AudioMixer::getInstance().getBusyCycles();
+
+	if (cycles != last_cycles)
+	{
+		uint64_t used = (uint64_t) (busy - last_busy) + refill_cycles;
+		uint64_t percent = (used * 100) / (cycles - last_cycles);
+		// Over 100 when the loop falls behind at this level
+		load = (percent > 255) ? 255 : percent;
+	}
+
+	last_poll = now;
+	last_cycles = cycles;
+	last_busy = busy;
+	refill_cycles = 0;
+
+	if (!voices)
+	{
+		target = levels;
+	} else {
+		// The load doubles with every level. Find the slowest one
+		// that keeps it under the limit.
+		uint32_t full_load = load >> level;
+
+		target = 0;
+		while (target < levels && (full_load << (target + 1)) <= GOVERNOR_MAX_LOAD)
+			target++;
+	}
+
+	// Slowing down waits for the hold time, speeding up doesn't
+	if (target > level && (int32_t) (now - hold_until) < 0)
+		return;
+
+	setLevel(target);
+}
+
+void ClockGovernor::setLevel(uint8_t new_level)
+{
+	if (new_level == level)
+		return;
+
+	uint32_t hpre = hpreBits(hpre_shift + new_level);
+	uint32_t ppre = ppreBits(ppre1_shift - new_level, PPRE1_POS) |
+					ppreBits(ppre2_shift - new_level, PPRE2_POS);
+
+	__disable_irq();
+
+	// The buses never run faster than they should: when slowing down
+	// the core clock is divided first, when speeding up it's the buses
+	if (new_level > level)
+	{
+		RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_HPRE) | hpre;
+		RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | ppre;
+	} else {
+		RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | ppre;
+		RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_HPRE) | hpre;
+	}
+
+	// SysTick runs from the core clock, keep its rate
+	SysTick->LOAD = ((systick_load + 1) >> new_level) - 1;
+	SysTick->VAL = 0;
+	level = new_level;
+
+	__enable_irq();
+
+	SystemCoreClockUpdate();
+}
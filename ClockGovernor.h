@@ -0,0 +1,104 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ClockGovernor.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __CLOCKGOVERNOR_H__
+#define __CLOCKGOVERNOR_H__
+
+#include <Arduino.h>
+
+// Slowest level, the core clock divided by 8
+#define GOVERNOR_MAX_LEVEL		3
+
+// Load (mixing and refilling the voices from the SD card, in percent
+// of the core time, at the clock it would run) allowed before going
+// to a slower level
+#define GOVERNOR_MAX_LOAD		50
+
+// How often the load is measured, and for how long the clock is kept
+// at full speed after a voice starts
+#define GOVERNOR_PERIOD_MS		100
+#define GOVERNOR_HOLD_MS		500
+
+// Chooses the core clock from the number of active voices and the time
+// the mixer takes. The clock is divided with the AHB prescaler, in steps
+// of two, while the APB prescalers are lowered by the same amount so the
+// peripheral clocks (UART baudrates, timers) don't change. The I2S and
+// SDIO clocks come from their own PLL outputs and aren't affected either.
+// The number of levels depends on the prescalers the core set up: the
+// APB ones have to stay at 2 or more, as the timers run at twice their
+// bus clock only then.
+class ClockGovernor
+{
+public:
+	static ClockGovernor& getInstance()
+	{
+		static ClockGovernor instance;
+		return instance;
+	}
+
+	bool begin();
+	void end();
+
+	// Full speed right away, called before a voice starts
+	void boost();
+
+	void poll(uint8_t voices);
+
+	// Brackets the main loop refilling the voices, which runs at the
+	// scaled clock too. An audio interrupt in between is counted twice,
+	// which only errs on the fast side.
+	inline uint32_t refillStart() { return DWT->CYCCNT; }
+
+	inline void refillEnd(uint32_t start)
+	{
+		if (enabled)
+			refill_cycles += DWT->CYCCNT - start;
+	}
+
+	inline uint8_t getLevel() { return level; }
+	inline uint8_t getLevels() { return levels; }
+	inline uint8_t getLoad() { return load; }
+
+private:
+	ClockGovernor();
+	void setLevel(uint8_t new_level);
+
+	bool enabled;
+	uint8_t level;
+	uint8_t levels;
+	uint8_t load;
+
+	// Prescalers and SysTick reload at full speed
+	uint8_t hpre_shift;
+	uint8_t ppre1_shift;
+	uint8_t ppre2_shift;
+	uint32_t systick_load;
+
+	uint32_t hold_until;
+	uint32_t last_poll;
+	uint32_t last_cycles;
+	uint32_t last_busy;
+	uint32_t refill_cycles;
+};
+
+#endif /* __CLOCKGOVERNOR_H__ */
@@ -25,6 +25,13 @@
 
 #if ENABLE_DEBUG
 
+void initDebug()
+{
+	DEBUG_SERIAL.begin(DEBUG_BAUDRATE);
+}
+
+#if !DEBUG_DEFERRED
+
 static char debug_string[255];
 
 void debugOut(char* str, bool crlf)
@@ -59,9 +66,6 @@ void debugPrint(uint32_t level, const char* fmt, ...)
 	debugOut(debug_string, true);
 }
 
-void initDebug()
-{
-	DEBUG_SERIAL.begin(9600);
-}
+#endif // !DEBUG_DEFERRED
 
 #endif // PBS_DEBUG
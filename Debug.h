@@ -30,6 +30,12 @@
 #define ENABLE_DEBUG 0
 #endif
 
+// Messages are stored in binary and sent from the main loop, see DebugLog.h.
+// Set to 0 to format and send them right away, as text.
+#ifndef DEBUG_DEFERRED
+#define DEBUG_DEFERRED 1
+#endif
+
 #if ENABLE_DEBUG
 
 #define DEBUG_CONTEXT(x)	x
@@ -42,7 +48,37 @@
 #define DEBUG_LEVEL_MASK	DebugInfoAll
 #endif
 
+// Records sent per loop while audio is playing
+#ifndef DEBUG_DRAIN_BUSY
+#define DEBUG_DRAIN_BUSY	1
+#endif
+
 void initDebug();
+
+#if DEBUG_DEFERRED
+
+#include "DebugLog.h"
+
+#ifndef DEBUG_BAUDRATE
+#define DEBUG_BAUDRATE		115200
+#endif
+
+#define debugMsg(level, fmt, ...)						\
+do {													\
+	if (level && (level & DEBUG_LEVEL_MASK))	\
+	{													\
+		DebugLog::getInstance().log(level, fmt, ##__VA_ARGS__);	\
+	}													\
+} while(0)
+
+#define debugDrain(busy) DebugLog::getInstance().drain((busy) ? DEBUG_DRAIN_BUSY : UINT32_MAX)
+
+#else
+
+#ifndef DEBUG_BAUDRATE
+#define DEBUG_BAUDRATE		9600
+#endif
+
 void debugPrint(uint32_t level, const char* fmt, ...);
 void debugOut(char* str, bool crlf);
 
@@ -54,12 +90,17 @@ do {													\
 	}													\
 } while(0)
 
+#define debugDrain(busy) (void)(0)
+
+#endif /* DEBUG_DEFERRED */
+
 #else
 #define DEBUG_CONTEXT(x)
 #define initDebug()
 #define debugPrint(x, y, ...) (void)(0)
 #define debugOut(x, y) (void)(0)
 #define debugMsg(level, fmt, ...) (void)(0)
+#define debugDrain(busy) (void)(0)
 #endif /* ENABLE_DEBUG */
 
 #define DebugError		0x01
@@ -0,0 +1,133 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### DebugLog.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "Debug.h"
+
+#if ENABLE_DEBUG && DEBUG_DEFERRED
+
+void DebugLog::putArg(uint8_t* record, uint32_t* len, const char* str)
+{
+	uint32_t str_len = str ? strlen(str) : 0;
+
+	if (str_len > DEBUG_LOG_MAX_STRING)
+		str_len = DEBUG_LOG_MAX_STRING;
+
+	if (*len + 2 + str_len > DEBUG_LOG_MAX_RECORD)
+	{
+		if (*len + 2 > DEBUG_LOG_MAX_RECORD)
+			return;
+
+		str_len = DEBUG_LOG_MAX_RECORD - *len - 2;
+	}
+
+	record[*len] = DEBUG_ARG_STRING;
+	record[*len + 1] = str_len;
+	memcpy(&record[*len + 2], str, str_len);
+	*len += 2 + str_len;
+}
+
+void DebugLog::push(const uint8_t* record, uint32_t len)
+{
+	// Slots are word aligned and start with a header word
+	uint32_t size = 4 + ((len + 3) & ~3);
+	uint32_t h = head;
+
+	do
+	{
+		if (h + size - tail > DEBUG_LOG_SIZE)
+		{
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&head, &h, h + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	for (uint32_t i = 0; i < len; i++)
+		ring[(h + 4 + i) & DEBUG_LOG_MASK] = record[i];
+
+	// Publish the slot once the record is in place
+	__DMB();
+	*((volatile uint32_t*) &ring[h & DEBUG_LOG_MASK]) = (DEBUG_LOG_MARKER << 16) | size;
+	__atomic_fetch_add(&records, 1, __ATOMIC_RELAXED);
+}
+
+uint32_t DebugLog::drain(uint32_t max)
+{
+	uint8_t record[2 + DEBUG_LOG_MAX_RECORD];
+	uint32_t sent = 0;
+
+	// Tell how many records were lost since the last time
+	uint32_t lost = dropped;
+	if (lost != reported && max)
+	{
+		uint32_t len = 12;
+
+		put16(&record[0], DEBUG_LOG_SYNC);
+		record[4] = DebugWarning;
+		record[5] = 1;
+		put32(&record[6], micros());
+		put32(&record[10], DEBUG_LOG_DROPPED);
+		putArg(&record[2], &len, DEBUG_ARG_UINT, lost - reported);
+		put16(&record[2], len);
+		DEBUG_SERIAL.write(record, len + 2);
+
+		reported = lost;
+		max--;
+		sent++;
+	}
+
+	while (sent < max)
+	{
+		uint32_t t = tail;
+		if (t == head)
+			break;
+
+		// Reserved but still being written
+		volatile uint32_t* slot = (volatile uint32_t*) &ring[t & DEBUG_LOG_MASK];
+		uint32_t word = *slot;
+		if ((word >> 16) != DEBUG_LOG_MARKER)
+			break;
+
+		__DMB();
+
+		uint32_t size = word & 0xFFFF;
+		uint32_t len = ring[(t + 4) & DEBUG_LOG_MASK] | (ring[(t + 5) & DEBUG_LOG_MASK] << 8);
+
+		put16(&record[0], DEBUG_LOG_SYNC);
+		for (uint32_t i = 0; i < len; i++)
+			record[2 + i] = ring[(t + 4 + i) & DEBUG_LOG_MASK];
+
+		// Leave the slot zeroed for the next records
+		for (uint32_t i = 0; i < size; i++)
+			ring[(t + i) & DEBUG_LOG_MASK] = 0;
+
+		__DMB();
+		tail = t + size;
+
+		DEBUG_SERIAL.write(record, len + 2);
+		sent++;
+	}
+
+	return sent;
+}
+
+#endif // ENABLE_DEBUG && DEBUG_DEFERRED
@@ -0,0 +1,173 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### DebugLog.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __DEBUGLOG_H__
+#define __DEBUGLOG_H__
+
+#include <Arduino.h>
+
+// Ring size in bytes, must be a power of two
+#define DEBUG_LOG_SIZE			2048
+#define DEBUG_LOG_MASK			(DEBUG_LOG_SIZE - 1)
+
+// Longest record, strings are truncated to fit
+#define DEBUG_LOG_MAX_RECORD	96
+#define DEBUG_LOG_MAX_STRING	32
+
+// Marks a ring slot whose record is completely written
+#define DEBUG_LOG_MARKER		0xD106
+
+// Records go out prefixed by this word
+#define DEBUG_LOG_SYNC			0x5AA5
+
+// Record sent with the count of records dropped
+// because the ring was full (format address 0)
+#define DEBUG_LOG_DROPPED		0
+
+// Argument tags
+#define DEBUG_ARG_INT			'i'
+#define DEBUG_ARG_UINT			'u'
+#define DEBUG_ARG_FLOAT			'f'
+#define DEBUG_ARG_PTR			'p'
+#define DEBUG_ARG_STRING		's'
+
+/*
+ * Deferred binary logger. Instead of formatting the message, a record is
+ * stored with the timestamp (microseconds), the address of the format
+ * string and the raw arguments. Records are formatted on the PC with
+ * tools/wtelogdec, which takes the format strings from the firmware ELF.
+ *
+ * Record layout (little endian), after the sync word:
+ *
+ *   uint16_t length		// Of the record, without the sync word
+ *   uint8_t level
+ *   uint8_t args
+ *   uint32_t timestamp
+ *   uint32_t format		// Address of the format string
+ *   ...					// Per argument: a tag and 4 bytes, or for
+ *							// strings the tag, a length byte and the text
+ *
+ * log() can be called from any context, interrupts included. Space in the
+ * ring is reserved with a compare-and-swap on 'head', then the record is
+ * copied and its slot header is written last. The main loop sends the
+ * records that are complete from drain(), and clears their slots so a
+ * stale header is never taken as a new one.
+ */
+class DebugLog
+{
+public:
+	static DebugLog& getInstance()
+	{
+		static DebugLog instance;
+		return instance;
+	}
+
+	template<typename... Args>
+	void log(uint8_t level, const char* fmt, Args... args)
+	{
+		uint8_t record[DEBUG_LOG_MAX_RECORD];
+		uint32_t len = 12;
+
+		record[2] = level;
+		record[3] = sizeof...(args);
+		put32(&record[4], micros());
+		put32(&record[8], (uint32_t) (uintptr_t) fmt);
+		encode(record, &len, args...);
+		put16(&record[0], len);
+		push(record, len);
+	}
+
+	// Sends up to 'max' complete records, returns how many were sent
+	uint32_t drain(uint32_t max);
+
+	inline uint32_t getRecords() { return records; }
+	inline uint32_t getDropped() { return dropped; }
+
+private:
+	DebugLog() : head(0), tail(0), records(0), dropped(0), reported(0)
+	{
+		memset(ring, 0, sizeof(ring));
+	}
+
+	void push(const uint8_t* record, uint32_t len);
+
+	static inline void put16(uint8_t* p, uint16_t value)
+	{
+		p[0] = value;
+		p[1] = value >> 8;
+	}
+
+	static inline void put32(uint8_t* p, uint32_t value)
+	{
+		p[0] = value;
+		p[1] = value >> 8;
+		p[2] = value >> 16;
+		p[3] = value >> 24;
+	}
+
+	static inline void putArg(uint8_t* record, uint32_t* len, uint8_t tag, uint32_t value)
+	{
+		if (*len + 5 > DEBUG_LOG_MAX_RECORD)
+			return;
+
+		record[*len] = tag;
+		put32(&record[*len + 1], value);
+		*len += 5;
+	}
+
+	static void putArg(uint8_t* record, uint32_t* len, const char* str);
+
+	static inline void putArg(uint8_t* record, uint32_t* len, char* str) { putArg(record, len, (const char*) str); }
+	static inline void putArg(uint8_t* record, uint32_t* len, int value) { putArg(record, len, DEBUG_ARG_INT, value); }
+	static inline void putArg(uint8_t* record, uint32_t* len, long value) { putArg(record, len, DEBUG_ARG_INT, value); }
+	static inline void putArg(uint8_t* record, uint32_t* len, unsigned int value) { putArg(record, len, DEBUG_ARG_UINT, value); }
+	static inline void putArg(uint8_t* record, uint32_t* len, unsigned long value) { putArg(record, len, DEBUG_ARG_UINT, value); }
+	static inline void putArg(uint8_t* record, uint32_t* len, const void* ptr) { putArg(record, len, DEBUG_ARG_PTR, (uint32_t) (uintptr_t) ptr); }
+
+	static inline void putArg(uint8_t* record, uint32_t* len, double value)
+	{
+		float f = value;
+		uint32_t bits;
+
+		memcpy(&bits, &f, 4);
+		putArg(record, len, DEBUG_ARG_FLOAT, bits);
+	}
+
+	static inline void encode(uint8_t*, uint32_t*) {}
+
+	template<typename T, typename... Args>
+	static inline void encode(uint8_t* record, uint32_t* len, T arg, Args... args)
+	{
+		putArg(record, len, arg);
+		encode(record, len, args...);
+	}
+
+	uint8_t ring[DEBUG_LOG_SIZE] __attribute__((aligned(4)));
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t records;
+	volatile uint32_t dropped;
+	uint32_t reported;
+};
+
+#endif /* __DEBUGLOG_H__ */
@@ -0,0 +1,166 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ImaAdpcm.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "ImaAdpcm.h"
+
+static const int16_t step_table[89] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+	19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+	130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+	5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] =
+{
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static inline int16_t expandNibble(ImaAdpcmChannel* ch, uint32_t nibble)
+{
+	int32_t step = step_table[ch->index];
+	int32_t diff = step >> 3;
+
+	if (nibble & 1)
+		diff += step >> 2;
+	if (nibble & 2)
+		diff += step >> 1;
+	if (nibble & 4)
+		diff += step;
+
+	int32_t predictor = ch->predictor + ((nibble & 8) ? -diff : diff);
+	if (predictor > INT16_MAX)
+		predictor = INT16_MAX;
+	else if (predictor < INT16_MIN)
+		predictor = INT16_MIN;
+
+	int32_t index = ch->index + index_table[nibble];
+	if (index < 0)
+		index = 0;
+	else if (index > 88)
+		index = 88;
+
+	ch->predictor = predictor;
+	ch->index = index;
+	return (int16_t) predictor;
+}
+
+bool ImaAdpcmDecoder::begin(uint16_t channels, uint16_t block_align, uint16_t samples_per_block)
+{
+	if (channels < 1 || channels > 2 || block_align <= 4 * channels)
+		return false;
+
+	// Some encoders don't write the extended format, so
+	// the block size is used to calculate it
+	uint16_t expected = ((block_align - 4 * channels) * 2) / channels + 1;
+	if (!samples_per_block || samples_per_block > expected)
+		samples_per_block = expected;
+
+	this->channels = channels;
+	this->samples_per_block = samples_per_block;
+	return true;
+}
+
+void ImaAdpcmDecoder::decode(const uint8_t* block, uint32_t frame, int16_t* out, uint32_t frames)
+{
+	const uint8_t* data = block + 4 * channels;
+	uint32_t last = frame + frames;
+
+	if (last > samples_per_block)
+		last = samples_per_block;
+
+	while (frame < last)
+	{
+		// First frame: the header holds the initial predictor and step
+		if (frame == 0)
+		{
+			for (uint8_t c = 0; c < channels; c++)
+			{
+				const uint8_t* hdr = block + 4 * c;
+				state[c].predictor = (int16_t) (hdr[0] | (hdr[1] << 8));
+				state[c].index = (hdr[2] > 88) ? 88 : hdr[2];
+			}
+
+			out[0] = (int16_t) state[0].predictor;
+			out[1] = (int16_t) state[channels - 1].predictor;
+			out += 2;
+			frame++;
+			continue;
+		}
+
+		uint32_t n = frame - 1;
+		uint32_t group = n >> 3;
+		uint32_t sample = n & 7;
+		const uint8_t* src = data + group * 4 * channels;
+
+		if (sample == 0 && last - frame >= 8)
+		{
+			// Whole group: 8 frames out of 4 bytes per channel
+			if (channels == 2)
+			{
+				uint32_t left = src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t) src[3] << 24);
+				uint32_t right = src[4] | (src[5] << 8) | (src[6] << 16) | ((uint32_t) src[7] << 24);
+
+				for (uint8_t i = 0; i < 8; i++)
+				{
+					*out++ = expandNibble(&state[0], left & 0x0F);
+					*out++ = expandNibble(&state[1], right & 0x0F);
+					left >>= 4;
+					right >>= 4;
+				}
+			} else {
+				uint32_t word = src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t) src[3] << 24);
+
+				for (uint8_t i = 0; i < 8; i++)
+				{
+					int16_t s = expandNibble(&state[0], word & 0x0F);
+					*out++ = s;
+					*out++ = s;
+					word >>= 4;
+				}
+			}
+
+			frame += 8;
+			continue;
+		}
+
+		// Single frame, low nibble first
+		for (uint8_t c = 0; c < channels; c++)
+		{
+			uint8_t byte = src[c * 4 + (sample >> 1)];
+			uint32_t nibble = (sample & 1) ? (byte >> 4) : (byte & 0x0F);
+			out[c] = expandNibble(&state[c], nibble);
+		}
+
+		if (channels == 1)
+			out[1] = out[0];
+
+		out += 2;
+		frame++;
+	}
+}
@@ -0,0 +1,60 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ImaAdpcm.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __IMAADPCM_H__
+#define __IMAADPCM_H__
+
+#include <Arduino.h>
+
+#define WAVE_FORMAT_IMA_ADPCM	0x0011
+
+typedef struct
+{
+	int32_t predictor;
+	int32_t index;
+} ImaAdpcmChannel;
+
+class ImaAdpcmDecoder
+{
+	/*
+	 * Decoder for IMA/DVI ADPCM WAV blocks. Every block starts with a
+	 * 4-byte header per channel followed by groups of 8 samples (4 bytes)
+	 * for every channel, interleaved. Frames of a block can be decoded in
+	 * any number of calls, as long as they are decoded in order. Output is
+	 * interleaved 16-bit stereo; mono files are copied to both channels.
+	*/
+
+public:
+	ImaAdpcmDecoder() : channels(1), samples_per_block(0) {}
+
+	bool begin(uint16_t channels, uint16_t block_align, uint16_t samples_per_block);
+	void decode(const uint8_t* block, uint32_t frame, int16_t* out, uint32_t frames);
+
+	inline uint16_t getSamplesPerBlock() { return samples_per_block; }
+
+private:
+	uint16_t channels;
+	uint16_t samples_per_block;
+	ImaAdpcmChannel state[2];
+};
+
+#endif /* __IMAADPCM_H__ */
@@ -0,0 +1,117 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### InputEvents.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __INPUTEVENTS_H__
+#define __INPUTEVENTS_H__
+
+#include <Arduino.h>
+
+// Must be a power of two
+#define INPUT_EVENTS_SIZE		32
+
+enum InputEventSource
+{
+	InputSourcePins,
+	InputSourceLatch
+};
+
+struct InputEvent
+{
+	uint32_t timestamp;		// GetTickCount() when the event was produced
+	uint16_t levels;		// Debounced pin levels, or the latched number
+	uint16_t changed;		// Pins that changed (InputSourcePins only)
+	uint8_t source;
+};
+
+// Single-producer/single-consumer ring of input events. It is filled from
+// interrupt context (the input scanner or the latch interrupt, never both
+// at the same time) and drained in order by the main loop. No locking is
+// needed: only the producer writes 'head' and only the consumer writes
+// 'tail'. When the ring is full the new event is dropped and counted.
+class InputEventQueue
+{
+public:
+	static InputEventQueue& getInstance()
+	{
+		static InputEventQueue instance;
+		return instance;
+	}
+
+	// Producer side
+	inline bool push(uint8_t source, uint16_t levels, uint16_t changed)
+	{
+		uint32_t h = head;
+
+		if (h - tail == INPUT_EVENTS_SIZE)
+		{
+			overflows++;
+			return false;
+		}
+
+		InputEvent* ev = &events[h & (INPUT_EVENTS_SIZE - 1)];
+		ev->timestamp = GetTickCount();
+		ev->levels = levels;
+		ev->changed = changed;
+		ev->source = source;
+
+		// The event must be written before it is published
+		__DMB();
+		head = h + 1;
+
+		if (h + 1 - tail > high_water)
+			high_water = h + 1 - tail;
+
+		return true;
+	}
+
+	// Consumer side
+	inline bool pop(InputEvent* ev)
+	{
+		uint32_t t = tail;
+
+		if (t == head)
+			return false;
+
+		*ev = events[t & (INPUT_EVENTS_SIZE - 1)];
+		__DMB();
+		tail = t + 1;
+		return true;
+	}
+
+	inline void clear() { tail = head; }
+	inline bool empty() { return head == tail; }
+	inline uint32_t getOverflows() { return overflows; }
+	inline uint32_t getHighWater() { return high_water; }
+	inline void resetCounters() { overflows = 0; high_water = 0; }
+
+private:
+	InputEventQueue() : head(0), tail(0), overflows(0), high_water(0) {}
+
+	InputEvent events[INPUT_EVENTS_SIZE];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t overflows;
+	volatile uint32_t high_water;
+};
+
+#endif /* __INPUTEVENTS_H__ */
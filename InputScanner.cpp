@@ -0,0 +1,134 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### InputScanner.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "InputScanner.h"
+#include "InputEvents.h"
+
+InputScanner::InputScanner() :
+	enabled(0), debounced(0), count0(0), count1(0), locked(0)
+{
+	memset(lock_ticks, 0, sizeof(lock_ticks));
+	memset(lock_counter, 0, sizeof(lock_counter));
+}
+
+void InputScanner::enable(uint8_t pin, uint32_t debounce_ms)
+{
+	if (pin >= INPUT_PINS_COUNT)
+		return;
+
+	// Convert the debounce time into scans
+	uint32_t ticks = (debounce_ms * getFrequency()) / 1000;
+	if (ticks > UINT16_MAX)
+		ticks = UINT16_MAX;
+
+	// Start from the current level, so enabling a pin while
+	// the scanner runs doesn't report a change
+	uint16_t bit = 1 << pin;
+	uint16_t level = inputReadPins() & bit;
+
+	__disable_irq();
+	lock_ticks[pin] = ticks;
+	lock_counter[pin] = 0;
+	locked &= ~bit;
+	count0 &= ~bit;
+	count1 &= ~bit;
+	debounced = (debounced & ~bit) | level;
+	enabled |= bit;
+	__enable_irq();
+}
+
+void InputScanner::disable(uint8_t pin)
+{
+	if (pin >= INPUT_PINS_COUNT)
+		return;
+
+	__disable_irq();
+	enabled &= ~(1 << pin);
+	__enable_irq();
+}
+
+void InputScanner::begin()
+{
+	// Start from the current levels, so no change is reported for
+	// pins that are already asserted
+	debounced = inputReadPins();
+	count0 = count1 = 0;
+	add();
+}
+
+void InputScanner::end()
+{
+	remove();
+}
+
+// Restarts scanning after end() without forgetting the debounced levels.
+// The enabled pins that are at a different level in 'levels' are posted
+// as an event right away, so a change seen while the scanner wasn't
+// running (i.e. the one that woke the board) isn't lost.
+void InputScanner::resume(uint16_t levels)
+{
+	uint16_t changed = (levels ^ debounced) & enabled;
+
+	debounced ^= changed;
+	count0 = count1 = 0;
+	if (changed)
+		InputEventQueue::getInstance().push(InputSourcePins, debounced, changed);
+
+	add();
+}
+
+void InputScanner::poll()
+{
+	uint16_t delta = (inputReadPins() ^ debounced) & enabled;
+
+	// Count the scans each pin has been different than its debounced level.
+	// The counters of the pins that match the debounced level are cleared.
+	count1 = (count1 ^ count0) & delta;
+	count0 = ~count0 & delta;
+
+	// Pins whose counter wrapped have been stable for four scans
+	uint16_t toggled = delta & ~(count0 | count1) & ~locked;
+	if (toggled)
+	{
+		debounced ^= toggled;
+		InputEventQueue::getInstance().push(InputSourcePins, debounced, toggled);
+
+		for (uint16_t bits = toggled; bits; bits &= bits - 1)
+		{
+			uint8_t pin = __builtin_ctz(bits);
+			if (lock_ticks[pin])
+			{
+				lock_counter[pin] = lock_ticks[pin];
+				locked |= (1 << pin);
+			}
+		}
+	}
+
+	// Update the lock-out timers, skipping the pins that just changed
+	for (uint16_t bits = locked & ~toggled; bits; bits &= bits - 1)
+	{
+		uint8_t pin = __builtin_ctz(bits);
+		if (--lock_counter[pin] == 0)
+			locked &= ~(1 << pin);
+	}
+}
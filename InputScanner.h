@@ -0,0 +1,79 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### InputScanner.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __INPUTSCANNER_H__
+#define __INPUTSCANNER_H__
+
+#include <Arduino.h>
+#include <ServiceTimer.h>
+
+#define INPUT_PINS_COUNT		16
+
+// IO pins 0 to 15, as bits in the input registers
+#define GPIOA_MASK				0x19FF
+#define GPIOB_MASK				0x600
+#define GPIOC_MASK 				0xE000
+
+// Collects the levels of the 16 IO pins into a 16 bit number,
+// where bit N is the level of pin N
+static inline uint16_t inputReadPins()
+{
+	return (GPIOA->IDR & GPIOA_MASK) | (GPIOB->IDR & GPIOB_MASK) | (GPIOC->IDR & GPIOC_MASK);
+}
+
+// Samples all the IO pins at once from the service timer and debounces them
+// with 2-bit vertical counters: a pin changes state after its new level
+// has been read on four consecutive scans. After a change, a pin can be
+// locked for its own debounce time before a new change is accepted.
+// Changes are posted to the InputEventQueue.
+class InputScanner : public STObject
+{
+public:
+	static InputScanner& getInstance()
+	{
+		static InputScanner instance;
+		return instance;
+	}
+
+	void enable(uint8_t pin, uint32_t debounce_ms);
+	void disable(uint8_t pin);
+	void begin();
+	void end();
+	void resume(uint16_t levels);
+	inline uint16_t getEnabled() { return enabled; }
+
+	void poll();
+
+private:
+	InputScanner();
+
+	uint16_t enabled;
+	uint16_t debounced;
+	uint16_t count0;
+	uint16_t count1;
+	uint16_t locked;
+	uint16_t lock_ticks[INPUT_PINS_COUNT];
+	uint16_t lock_counter[INPUT_PINS_COUNT];
+};
+
+#endif /* __INPUTSCANNER_H__ */
@@ -23,26 +23,289 @@
 #include "Debug.h"
 #include "IoPin.h"
 #include "Player.h"
+#include "InputScanner.h"
+#include "StringPool.h"
+#include "Arena.h"
+#include <ff.h>
+#include <ctype.h>
+#include <strings.h>
 
 extern PlayersPool players;
 
-IoPin::IoPin(uint8_t num, char* file, PinPolarity polarity, PinTriggerType trigger,
-		  PlayMode playback, float volume, DeassertMode deassert, uint32_t debounce) :
+// Paths of the files being resolved. Shared by every pin, as pins are only
+// started from the main loop, one at a time.
+static char path[256];
+
+IoPin::IoPin(uint8_t num, uint16_t file, PinPolarity polarity, PinTriggerType trigger,
+		  PlayMode playback, float volume, float rate, uint8_t group, DeassertMode deassert,
+		  uint32_t debounce, PinSelectMode select, uint8_t priority) :
 
 	      player(NULL), pin_num(num), enabled(false), state(PinDeasserted),
-		  last_state(PinDeasserted), error(false), deassert_mode(deassert),
+		  last_state(PinDeasserted), file_spec(file), error(false), deassert_mode(deassert),
 		  io_polarity(polarity), trigger_type(trigger), playback_mode(playback), volume(volume),
-		  debounce(debounce), debouncer_state(PinDeasserted)
+		  rate(rate), group(group), priority(priority), debounce(debounce), files(NULL), files_count(0),
+		  file_index(0), select_mode(select), sequence_running(false), random_seed(0)
+{
+}
+
+// Case-insensitive match of a name against a pattern with * and ? wildcards.
+// The pattern ends at 'end', it's a piece of the file setting.
+bool IoPin::match(const char* pattern, const char* end, const char* name)
+{
+	while (pattern < end)
+	{
+		if (*pattern == '*')
+		{
+			pattern++;
+			do
+			{
+				if (match(pattern, end, name))
+					return true;
+			} while (*name++);
+
+			return false;
+		}
+
+		if (!*name || (*pattern != '?' && tolower(*pattern) != tolower(*name)))
+			return false;
+
+		pattern++;
+		name++;
+	}
+
+	return *name == 0;
+}
+
+// Adds a file to the list, if it can be played. The header is parsed
+// now, so triggering the pin only has to open the file.
+bool IoPin::addFile(const char* path)
+{
+	FIL file;
+	IoPinFile* entry;
+
+	if (files_count == IO_PIN_MAX_FILES)
+	{
+		debugMsg(DebugWarning, "Pin %i - too many files, %s ignored", pin_num, path);
+		return false;
+	}
+
+	entry = &files[files_count];
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+	{
+		debugMsg(DebugWarning, "Pin %i - cannot open %s", pin_num, path);
+		return false;
+	}
+
+	bool ok = wavReadHeader(&file, &entry->info) && wavIsSupported(&entry->info);
+	f_close(&file);
+
+	if (!ok)
+	{
+		debugMsg(DebugWarning, "Pin %i - %s is not a supported WAV file", pin_num, path);
+		return false;
+	}
+
+	entry->path = StringPool::getInstance().add(path);
+	if (entry->path == STRING_POOL_INVALID)
+		return false;
+
+	files_count++;
+	return true;
+}
+
+// Adds every file matching the pattern, sorted by name. The wildcards
+// can only be in the file name, not in the directory part.
+bool IoPin::addMatchingFiles(const char* pattern, uint32_t len)
 {
-	if (file)
-		strcpy(file_path, file);
+	DIR dir;
+	FILINFO info;
+	const char* end = pattern + len;
+	const char* name = end;
+	uint8_t first = files_count;
+
+	while (name > pattern && name[-1] != '/')
+		name--;
+
+	uint32_t dir_len = (name > pattern) ? name - pattern - 1 : 0;
+	memcpy(path, pattern, dir_len);
+	path[dir_len] = 0;
+
+	if (f_opendir(&dir, path) != FR_OK)
+	{
+		debugMsg(DebugWarning, "Pin %i - cannot open directory '%s'", pin_num, path);
+		return false;
+	}
+
+	while (f_readdir(&dir, &info) == FR_OK && info.fname[0])
+	{
+		if (info.fattrib & AM_DIR || !match(name, end, info.fname))
+			continue;
+
+		if (dir_len)
+			snprintf(path + dir_len, sizeof(path) - dir_len, "/%s", info.fname);
+		else
+			snprintf(path, sizeof(path), "%s", info.fname);
+
+		addFile(path);
+	}
+
+	f_closedir(&dir);
+
+	// Directory order is not meaningful, sort the new entries
+	StringPool& pool = StringPool::getInstance();
+	for (uint8_t i = first + 1; i < files_count; i++)
+	{
+		IoPinFile tmp = files[i];
+		uint8_t j = i;
+
+		while (j > first && strcasecmp(pool.get(files[j - 1].path), pool.get(tmp.path)) > 0)
+		{
+			files[j] = files[j - 1];
+			j--;
+		}
+
+		files[j] = tmp;
+	}
+
+	return files_count != first;
+}
+
+// Parses the file setting: a single file, a comma separated list, or
+// patterns like "hit*.wav". Every entry of the list can be a pattern.
+// The setting is read in place from the string pool.
+bool IoPin::resolveFiles()
+{
+	const char* spec = StringPool::getInstance().get(file_spec);
+
+	// The list takes the room for the maximum number of files,
+	// and gives back what is not used once it is complete
+	Arena& arena = Arena::getInstance();
+	files = (IoPinFile*) arena.allocate(IO_PIN_MAX_FILES * sizeof(IoPinFile), alignof(IoPinFile));
+	if (!files)
+		return false;
+
+	while (*spec)
+	{
+		const char* token = spec;
+		const char* end = strchr(spec, ',');
+		bool pattern = false;
+
+		if (!end)
+			end = spec + strlen(spec);
+
+		spec = *end ? end + 1 : end;
+
+		// Trim spaces
+		while (token < end && (*token == ' ' || *token == '\t'))
+			token++;
+
+		while (end > token && (end[-1] == ' ' || end[-1] == '\t'))
+			end--;
+
+		uint32_t len = end - token;
+		if (!len)
+			continue;
+
+		if (len >= sizeof(path))
+		{
+			debugMsg(DebugWarning, "Pin %i - file name too long", pin_num);
+			continue;
+		}
+
+		for (const char* c = token; c < end; c++)
+			pattern |= (*c == '*' || *c == '?');
+
+		if (pattern)
+		{
+			addMatchingFiles(token, len);
+		} else {
+			memcpy(path, token, len);
+			path[len] = 0;
+			addFile(path);
+		}
+	}
+
+	arena.shrink(files, files_count * sizeof(IoPinFile));
+
+	if (!files_count)
+	{
+		files = NULL;
+		return false;
+	}
+
+	// Nothing to choose from with a single file
+	if (files_count == 1)
+		select_mode = SelectRoundRobin;
+
+	file_index = (select_mode == SelectRandom) ? files_count : 0;
+	random_seed = GetTickCount() ^ (0x9E3779B9 * (pin_num + 1));
+	return true;
+}
+
+IoPinFile* IoPin::selectFile()
+{
+	uint8_t next;
+
+	switch (select_mode)
+	{
+		case SelectRandom:
+			// xorshift32, stirred with the trigger time
+			random_seed ^= GetTickCount();
+			random_seed ^= random_seed << 13;
+			random_seed ^= random_seed >> 17;
+			random_seed ^= random_seed << 5;
+
+			// Never the last one played
+			if (file_index >= files_count)
+			{
+				next = random_seed % files_count;
+			} else {
+				next = random_seed % (files_count - 1);
+				if (next >= file_index)
+					next++;
+			}
+
+			file_index = next;
+			return &files[next];
+
+		case SelectSequence:
+			file_index = 0;
+			sequence_running = true;
+			return &files[0];
+
+		case SelectRoundRobin:
+		default:
+			next = file_index;
+			file_index = (file_index + 1) % files_count;
+			return &files[next];
+	}
+}
+
+bool IoPin::playFile(IoPinFile* file)
+{
+	// A sequence is looped as a whole, not file by file
+	PlayMode mode = (select_mode == SelectSequence) ? PlayModeNormal : playback_mode;
+
+	if (player->play(StringPool::getInstance().get(file->path), mode, &file->info))
+		return true;
+
+	sequence_running = false;
+	return false;
 }
 
 bool IoPin::begin()
 {
+	if (!files && !resolveFiles())
+	{
+		debugMsg(DebugError, "Pin %i - no playable files in %s", pin_num, StringPool::getInstance().get(file_spec));
+		error = true;
+		return false;
+	}
+
 	// Initialize pin
 	pinMode(pin_num, (io_polarity == PinActiveHigh) ? INPUT_PULLDOWN : INPUT_PULLUP);
-	attachInterruptWithParam(pin_num, triggeredStub, CHANGE, this);
+	InputScanner::getInstance().enable(pin_num, debounce);
 
 	// If trigger type is 'level', check the current level and act accordingly
 	if (trigger_type == LevelTrigger)
@@ -56,46 +319,39 @@ bool IoPin::begin()
 
 	enabled = true;
 
-	debugMsg(DebugInfo, "Pin %i enabled (%s, %s, %s)" ,
+	debugMsg(DebugInfo, "Pin %i enabled (%s, %s, %s, %i files)" ,
 				 pin_num, io_polarity == PinActiveHigh ? "IoActiveHigh" : "IoActiveLow",
 						 trigger_type == LevelTrigger ? "LevelTrigger" : "EdgeTrigger",
-						 file_path);
+						 StringPool::getInstance().get(file_spec), files_count);
 	return true;
 }
 
 void IoPin::end()
 {
-	detachInterrupt(pin_num);
+	InputScanner::getInstance().disable(pin_num);
+
+	// Let go of the player, unless another pin took it
+	if (player && player->getOwner() == this)
+		players.release(player);
+
+	player = NULL;
+	sequence_running = false;
 
 	// Set pin pull-up
 	digitalWrite(pin_num, HIGH);
 }
 
-void IoPin::triggered()
+// Called from the main loop with the debounced level
+// of the pin, when the input scanner detects a change
+void IoPin::update(uint8_t level)
 {
 	if (!enabled)
 		return;
 
-	// This function is called when an interrupt is triggered. Since we can
-	// set different trigger modes and each of them follows a certain logic,
-	// we just set a variable with the last state. No audio files operations
-	// are done within this function.
-
-	uint8_t level = digitalRead(pin_num);
 	if (io_polarity == PinActiveHigh)
 		state = (level) ? PinAsserted : PinDeasserted;
 	else
 		state = (!level) ? PinAsserted : PinDeasserted;
-
-	// Check if there is a debouncer setting
-	if (debounce)
-	{
-		if (debouncer_state != state)
-		{
-			debouncer_state = state;
-			debouncer.startCounter();
-		}
-	}
 }
 
 inline void IoPin::processEdgeAsserted()
@@ -103,12 +359,16 @@ inline void IoPin::processEdgeAsserted()
 	if (!player)
 	{
 		// Try to get a free player
-		player = players.acquire();
+		player = players.acquire(priority, this);
 		if (!player)
 		{
 			debugMsg(DebugWarning, "Pin %i player not available", pin_num);
 			return;
 		}
+
+		player->setVolume(volume);
+		player->setRate(rate);
+		player->setGroup(group);
 	}
 
 	switch (player->getStatus())
@@ -122,7 +382,7 @@ inline void IoPin::processEdgeAsserted()
 					break;
 
 				case DeassertRestart:
-					if (!player->play(file_path, playback_mode))
+					if (!playFile(selectFile()))
 					{
 						debugMsg(DebugError, "Pin %i - error re-playing", pin_num);
 						players.release(player);
@@ -134,6 +394,7 @@ inline void IoPin::processEdgeAsserted()
 					break;
 
 				case DeassertStop:
+					sequence_running = false;
 					player->stop();
 					players.release(player);
 					player = NULL;
@@ -148,7 +409,7 @@ inline void IoPin::processEdgeAsserted()
 			break;
 
 		case playerStopped:
-			if (!player->play(file_path, playback_mode))
+			if (!playFile(selectFile()))
 			{
 				debugMsg(DebugError, "Pin %i - error playing", pin_num);
 				players.release(player);
@@ -166,7 +427,7 @@ inline void IoPin::processLevelAsserted()
 	if (!player)
 	{
 		// Try to get a free player
-		player = players.acquire();
+		player = players.acquire(priority, this);
 		if (!player)
 		{
 			debugMsg(DebugWarning, "Pin %i processLevelAsserted() player not available", pin_num);
@@ -174,6 +435,8 @@ inline void IoPin::processLevelAsserted()
 		}
 
         player->setVolume(volume);
+        player->setRate(rate);
+        player->setGroup(group);
 	}
 
 	if (player->getStatus() == playerPlaying)
@@ -186,7 +449,7 @@ inline void IoPin::processLevelAsserted()
 		return;
 	}
 
-	if (!player->play(file_path, playback_mode))
+	if (!playFile(selectFile()))
 	{
 		debugMsg(DebugError, "Pin %i - error playing", pin_num);
         players.release(player);
@@ -216,6 +479,7 @@ inline void IoPin::processLevelDeasserted()
         player->pause(true);
 		debugMsg(DebugInfo, "Pin %i paused", pin_num);
 	} else {
+		sequence_running = false;
         player->stop(true);
 		debugMsg(DebugInfo, "Pin %i stopped", pin_num);
 	}
@@ -228,6 +492,29 @@ bool IoPin::poll()
 	if (error || !enabled)
 		return false;
 
+	// The player may have been taken by a pin with higher priority
+	if (player && player->getOwner() != this)
+	{
+		debugMsg(DebugInfo, "Pin %i preempted", pin_num);
+		player = NULL;
+		sequence_running = false;
+	}
+
+	// Continue the sequence when a file ends
+	if (player && sequence_running && player->idle())
+	{
+		if (++file_index == files_count)
+		{
+			file_index = 0;
+			if (playback_mode != PlayModeLoop)
+				sequence_running = false;
+		}
+
+		if (sequence_running && playFile(&files[file_index]))
+			debugMsg(DebugInfo, "Pin %i playing %s", pin_num,
+					 StringPool::getInstance().get(files[file_index].path));
+	}
+
     // Free and invalidate the player if we are not playing
 	if (player && player->getStatus() == playerStopped)
     {
@@ -237,15 +524,6 @@ bool IoPin::poll()
 
 	PinState read_state = state;
 
-	// Check if there is an active debouncer
-	if (debouncer.active())
-	{
-		if (debouncer.elapsed() < debounce)
-			return false;
-
-		debouncer.stopCounter();
-	}
-
 	if (last_state == read_state)
 		return false;
 
@@ -269,3 +547,34 @@ bool IoPin::poll()
 
 	return true;
 }
+
+// Polls the pins in 'mask', giving the ones in 'changed' their level from
+// 'levels' first, and keeps track in 'busy' of the pins holding a player.
+// The main loop polls 'busy' on every pass, so a pin is polled again until
+// it releases its player. Returns true if any pin changed state.
+bool IoPin::pollPins(IoPin* const* pins, uint16_t mask, uint16_t levels, uint16_t changed, uint16_t* busy)
+{
+	bool activity = false;
+
+	for (uint16_t bits = mask; bits; bits &= bits - 1)
+	{
+		uint8_t i = __builtin_ctz(bits);
+		if (!pins[i])
+		{
+			*busy &= ~(1 << i);
+			continue;
+		}
+
+		if (changed & (1 << i))
+			pins[i]->update(levels & (1 << i));
+
+		activity |= pins[i]->poll();
+
+		if (pins[i]->busy())
+			*busy |= (1 << i);
+		else
+			*busy &= ~(1 << i);
+	}
+
+	return activity;
+}
@@ -24,7 +24,6 @@
 #define __CHANNEL_H__
 
 #include <Arduino.h>
-#include "TimeCounter.h"
 #include "Player.h"
 
 enum PinPolarity
@@ -52,42 +51,72 @@ enum DeassertMode
 	DeassertStop
 };
 
+// How a pin with several files chooses the one to play
+enum PinSelectMode
+{
+	SelectRoundRobin,	// The next file on every trigger
+	SelectRandom,		// A random file, never the same twice in a row
+	SelectSequence		// All the files one after the other on every trigger
+};
+
+// Maximum number of files a pin can play
+#define IO_PIN_MAX_FILES		16
+
+struct IoPinFile
+{
+	uint16_t path;		// In the StringPool
+	WavInfo info;
+};
+
 class IoPin
 {
 
 public:
-	IoPin(uint8_t num, char* file, PinPolarity polarity, PinTriggerType trigger,
-			  PlayMode playback, float volume, DeassertMode deassert, uint32_t debounce);
+	IoPin(uint8_t num, uint16_t file, PinPolarity polarity, PinTriggerType trigger,
+			  PlayMode playback, float volume, float rate, uint8_t group, DeassertMode deassert,
+			  uint32_t debounce, PinSelectMode select = SelectRoundRobin, uint8_t priority = 0);
 	bool begin();
 	void end();
 	bool poll();
+	void update(uint8_t level);
+	inline bool busy() { return player != NULL; }
+
+	static bool pollPins(IoPin* const* pins, uint16_t mask, uint16_t levels, uint16_t changed, uint16_t* busy);
 
 private:
 	Player* player;
 	uint8_t pin_num;
 	bool enabled;
-	volatile PinState state;
+	PinState state;
 	PinState last_state;
-	char file_path[256];
+	uint16_t file_spec;		// In the StringPool
 	bool error;
 	DeassertMode deassert_mode;
 	PinPolarity io_polarity;
 	PinTriggerType trigger_type;
 	PlayMode playback_mode;
 	float volume;
+	float rate;
+	uint8_t group;
+	uint8_t priority;
 
-	// Debouncing
-	TimeCounter debouncer;
 	uint32_t debounce;
-	PinState debouncer_state;
 
-	static void triggeredStub(void* param)
-	{
-		if (param)
-			((IoPin*) param)->triggered();
-	}
+	// Files, resolved when the pin is enabled
+	IoPinFile* files;
+	uint8_t files_count;
+	uint8_t file_index;
+	PinSelectMode select_mode;
+	bool sequence_running;
+	uint32_t random_seed;
+
+	bool resolveFiles();
+	bool addFile(const char* path);
+	bool addMatchingFiles(const char* pattern, uint32_t len);
+	static bool match(const char* pattern, const char* end, const char* name);
+	IoPinFile* selectFile();
+	bool playFile(IoPinFile* file);
 
-	void triggered();
 	void processEdgeAsserted();
 	void processLevelAsserted();
 	void processLevelDeasserted();
@@ -0,0 +1,223 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### LatchedVoices.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "LatchedVoices.h"
+#include "Debug.h"
+#include "WavIndex.h"
+
+extern PlayersPool players;
+
+void LatchedVoices::begin(uint8_t limit, LatchStealMode steal, uint8_t group, float volume)
+{
+	if (!limit || limit > MAX_PLAYERS)
+		limit = MAX_PLAYERS;
+
+	this->limit = limit;
+	this->steal = steal;
+	this->group = group;
+	this->volume = volume;
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+		voices[i].player = NULL;
+
+	debugMsg(DebugInfo, "Latched mode polyphonic (%i voices, %s)", limit,
+			 steal == LatchStealOldest ? "steal oldest" : "no stealing");
+}
+
+// Stops every sound and gives the players back to the pool
+void LatchedVoices::end()
+{
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		if (voices[i].player && voices[i].player->getOwner() == this)
+			players.release(voices[i].player);
+
+		voices[i].player = NULL;
+	}
+}
+
+// Returns to the pool the players that finished (including fade-outs)
+void LatchedVoices::reap()
+{
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		// Taken by someone else with higher priority
+		if (voices[i].player && voices[i].player->getOwner() != this)
+		{
+			voices[i].player = NULL;
+			continue;
+		}
+
+		if (voices[i].player && voices[i].player->idle())
+		{
+			players.release(voices[i].player);
+			voices[i].player = NULL;
+		}
+	}
+}
+
+LatchedVoices::LatchVoice* LatchedVoices::oldest(bool playing_only)
+{
+	LatchVoice* ret = NULL;
+	uint32_t now = GetTickCount();
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		LatchVoice* v = &voices[i];
+		if (!v->player)
+			continue;
+
+		if (playing_only && v->player->getStatus() != playerPlaying)
+			continue;
+
+		if (!ret || (now - v->started) > (now - ret->started))
+			ret = v;
+	}
+
+	return ret;
+}
+
+void LatchedVoices::stopAll()
+{
+	// Players taken by someone else are not ours to stop
+	reap();
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		if (voices[i].player)
+			voices[i].player->stop(true);
+	}
+}
+
+// A latch code: plays N.wav, or stops sounds with the reserved codes
+bool LatchedVoices::trigger(uint16_t num, uint32_t timestamp)
+{
+	if (num == LATCH_STOP_ALL)
+	{
+		stopAll();
+		debugMsg(DebugInfo, "Latched mode - stop all");
+		return true;
+	}
+
+	if (num & LATCH_STOP_FLAG)
+	{
+		reap();
+
+		num &= ~LATCH_STOP_FLAG;
+		for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+		{
+			if (voices[i].player && voices[i].num == num)
+				voices[i].player->stop(true);
+		}
+
+		debugMsg(DebugInfo, "Latched mode - stop %i.wav", num);
+		return true;
+	}
+
+	return play(num, timestamp);
+}
+
+// Plays N.wav for any number, the stop codes included. The pin selector
+// comes here, so every value of a 16 pin selector is a file.
+bool LatchedVoices::play(uint16_t num, uint32_t timestamp)
+{
+	LatchVoice* slot = NULL;
+	uint8_t active = 0;
+	char file[10];
+
+	// Only used for the debug message
+	(void) timestamp;
+
+	reap();
+
+	// Fail before stealing anything if there is no such file
+	if (!WavIndex::getInstance().exists(num))
+	{
+		debugMsg(DebugError, "Latched mode - %i.wav not found", num);
+		return false;
+	}
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		if (voices[i].player && voices[i].player->getStatus() == playerPlaying)
+			active++;
+	}
+
+	// Make room if the limit has been reached. The stolen sound fades out
+	// while the new one starts, as long as the pool has a spare player.
+	if (active >= limit)
+	{
+		LatchVoice* victim = oldest(true);
+		if (steal == LatchStealNone || !victim)
+		{
+			debugMsg(DebugWarning, "Latched mode - voice limit reached, %i ignored", num);
+			return false;
+		}
+
+		debugMsg(DebugInfo, "Latched mode - stealing %i.wav", victim->num);
+		victim->player->stop(true);
+	}
+
+	Player* player = players.acquire(0, this);
+	if (!player)
+	{
+		// Every player is busy, probably fading out. Cut the oldest.
+		slot = oldest(false);
+		if (!slot)
+			return false;
+
+		player = slot->player;
+		player->stop();
+	} else {
+		for (uint8_t i = 0; i < MAX_PLAYERS && !slot; i++)
+		{
+			if (!voices[i].player)
+				slot = &voices[i];
+		}
+
+		if (!slot)
+		{
+			players.release(player);
+			return false;
+		}
+	}
+
+	player->setVolume(volume);
+	player->setGroup(group);
+
+	sprintf(file, "%i.wav", num);
+	if (!player->play(file))
+	{
+		debugMsg(DebugError, "Latched mode - error playing %s", file);
+		players.release(player);
+		slot->player = NULL;
+		return false;
+	}
+
+	slot->player = player;
+	slot->num = num;
+	slot->started = GetTickCount();
+
+	debugMsg(DebugInfo, "Latched mode - playing %s (%i ms)", file, slot->started - timestamp);
+	return true;
+}
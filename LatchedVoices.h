@@ -0,0 +1,74 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### LatchedVoices.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __LATCHEDVOICES_H__
+#define __LATCHEDVOICES_H__
+
+#include <Arduino.h>
+#include "Player.h"
+
+// Reserved latch codes in polyphonic mode
+#define LATCH_STOP_FLAG			0x8000		// 0x8000 | N stops N.wav
+#define LATCH_STOP_ALL			0xFFFF
+
+enum LatchStealMode
+{
+	LatchStealNone,		// Ignore new strobes when the limit is reached
+	LatchStealOldest	// Fade out the oldest sound to make room
+};
+
+// Polyphonic latched mode. Every strobe takes a player from the pool, so
+// new sounds don't cut off the ones already playing.
+class LatchedVoices
+{
+public:
+	LatchedVoices() : limit(MAX_PLAYERS), steal(LatchStealOldest), group(0), volume(1.0f) {}
+
+	void begin(uint8_t limit, LatchStealMode steal, uint8_t group, float volume);
+	void end();
+	bool trigger(uint16_t num, uint32_t timestamp);
+	bool play(uint16_t num, uint32_t timestamp);
+	void stopAll();
+
+	// Gives back the players that finished, call it every loop
+	inline void poll() { reap(); }
+
+private:
+	struct LatchVoice
+	{
+		Player* player;
+		uint16_t num;
+		uint32_t started;
+	};
+
+	void reap();
+	LatchVoice* oldest(bool playing_only);
+
+	LatchVoice voices[MAX_PLAYERS];
+	uint8_t limit;
+	LatchStealMode steal;
+	uint8_t group;
+	float volume;
+};
+
+#endif /* __LATCHEDVOICES_H__ */
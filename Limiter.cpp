@@ -0,0 +1,140 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Limiter.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "Limiter.h"
+#include <math.h>
+
+// Rounded, so unity gain leaves the samples untouched. It can't take a
+// sample past the threshold: |sample * gain| is at most threshold << 31.
+static inline int32_t applyGain(int32_t sample, int32_t gain)
+{
+	return (int32_t) (((int64_t) sample * gain + (1 << 30)) >> 31);
+}
+
+static float gainToDb(int32_t gain)
+{
+	if (gain <= 0)
+		return 0;
+
+	return -20.0f * log10f((float) gain / LIMITER_UNITY_GAIN);
+}
+
+Limiter::Limiter() :
+	threshold(INT16_MAX), release_coeff(0), gain(LIMITER_UNITY_GAIN),
+	delay_gain(LIMITER_UNITY_GAIN), min_gain(LIMITER_UNITY_GAIN)
+{
+	memset(delay, 0, sizeof(delay));
+}
+
+void Limiter::configure(float threshold_db, uint32_t release_ms, uint32_t sample_rate, uint32_t block_frames)
+{
+	if (threshold_db > 0)
+		threshold_db = 0;
+
+	threshold = (int32_t) (INT16_MAX * powf(10.0f, threshold_db / 20.0f));
+	if (threshold < 1)
+		threshold = 1;
+
+	// Per-block coefficient of the exponential release
+	float release_blocks = (float) release_ms * sample_rate / (1000.0f * block_frames);
+	float coeff = (release_blocks > 0) ? 1.0f - expf(-1.0f / release_blocks) : 1.0f;
+	release_coeff = (int32_t) (coeff * LIMITER_UNITY_GAIN);
+
+	reset();
+}
+
+void Limiter::reset()
+{
+	memset(delay, 0, sizeof(delay));
+	gain = LIMITER_UNITY_GAIN;
+	delay_gain = LIMITER_UNITY_GAIN;
+	min_gain = LIMITER_UNITY_GAIN;
+}
+
+void Limiter::process(int32_t* block, uint32_t samples)
+{
+	int32_t peak = 0;
+	int32_t needed = LIMITER_UNITY_GAIN;
+
+	// Peak of the incoming block
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		int32_t s = block[i];
+		if (s < 0)
+			s = -s;
+
+		if (s > peak)
+			peak = s;
+	}
+
+	if (peak > threshold)
+		needed = (int32_t) (((int64_t) threshold << 31) / peak);
+
+	// The target must satisfy both the block being output now (delayed)
+	// and the one that has just come in, and can't release faster than
+	// the configured time.
+	int32_t target = gain + (int32_t) (((int64_t) (LIMITER_UNITY_GAIN - gain) * release_coeff) >> 31);
+	if (target > delay_gain)
+		target = delay_gain;
+
+	if (target > needed)
+		target = needed;
+
+	// Linear ramp towards the target. Every gain in the ramp lies between
+	// the current gain and the target, both safe for the delayed block.
+	uint32_t frames = samples / 2;
+	int32_t step = (target - gain) / (int32_t) frames;
+	int32_t g = gain;
+
+	for (uint32_t i = 0; i < samples; i += 2)
+	{
+		g += step;
+
+		int32_t l = block[i];
+		int32_t r = block[i + 1];
+		block[i] = applyGain(delay[i], g);
+		block[i + 1] = applyGain(delay[i + 1], g);
+		delay[i] = l;
+		delay[i + 1] = r;
+	}
+
+	gain = target;
+	delay_gain = needed;
+
+	if (target < min_gain)
+		min_gain = target;
+}
+
+float Limiter::getGainReduction()
+{
+	return gainToDb(gain);
+}
+
+float Limiter::getMaxGainReduction(bool clear)
+{
+	int32_t value = min_gain;
+
+	if (clear)
+		min_gain = gain;
+
+	return gainToDb(value);
+}
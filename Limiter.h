@@ -0,0 +1,69 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Limiter.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __LIMITER_H__
+#define __LIMITER_H__
+
+#include <Arduino.h>
+
+// Gains are Q31, so unity is the largest positive number
+#define LIMITER_UNITY_GAIN			INT32_MAX
+
+// Largest block (interleaved stereo samples) that can be processed.
+// This is also the look-ahead of the limiter.
+#define LIMITER_MAX_SAMPLES			128
+
+#define LIMITER_DEFAULT_THRESHOLD	-1.0f
+#define LIMITER_DEFAULT_RELEASE		100
+
+class Limiter
+{
+	/*
+	 * Look-ahead peak limiter for the master bus. The output is delayed by
+	 * one block, so the gain needed by the next block is known in advance
+	 * and the gain is ramped across the current block to reach it. Every
+	 * output sample is then guaranteed to stay below the threshold, while
+	 * the gain recovers exponentially following the release time.
+	 *
+	 * Samples are the unsaturated output of the mixer, in sample units.
+	*/
+
+public:
+	Limiter();
+
+	void configure(float threshold_db, uint32_t release_ms, uint32_t sample_rate, uint32_t block_frames);
+	void process(int32_t* block, uint32_t samples);
+	void reset();
+
+	float getGainReduction();
+	float getMaxGainReduction(bool clear = true);
+
+private:
+	int32_t delay[LIMITER_MAX_SAMPLES];
+	int32_t threshold;
+	int32_t release_coeff;
+	int32_t gain;
+	int32_t delay_gain;
+	volatile int32_t min_gain;
+};
+
+#endif /* __LIMITER_H__ */
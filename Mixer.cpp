@@ -0,0 +1,310 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Mixer.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "Mixer.h"
+#include "Profiler.h"
+
+#define MIXER_ROUNDING		(1 << (MIXER_GAIN_SHIFT - 1))
+
+int16_t mixerGain(float volume)
+{
+	if (volume <= 0)
+		return 0;
+
+	float gain = volume * MIXER_UNITY_GAIN + 0.5f;
+	if (gain >= INT16_MAX)
+		return INT16_MAX;
+
+	return (int16_t) gain;
+}
+
+void mixerMixReference(int32_t* out, const int16_t* const* src, const int16_t* gains,
+					   uint32_t voices, uint32_t samples)
+{
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		int64_t acc = MIXER_ROUNDING;
+
+		for (uint32_t v = 0; v < voices; v++)
+			acc += (int32_t) src[v][i] * gains[v];
+
+		out[i] = (int32_t) (acc >> MIXER_GAIN_SHIFT);
+	}
+}
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+
+static inline uint32_t load16x2(const int16_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+void mixerMix(int32_t* out, const int16_t* const* src, const int16_t* gains,
+			  uint32_t voices, uint32_t samples)
+{
+	uint32_t packed_gains[(MIXER_MAX_VOICES + 1) / 2];
+	uint32_t pairs = voices / 2;
+	uint32_t v;
+
+	for (v = 0; v < pairs; v++)
+		packed_gains[v] = __PKHBT(gains[v * 2], gains[v * 2 + 1], 16);
+
+	for (uint32_t i = 0; i < samples; i += 2)
+	{
+		uint64_t acc0 = MIXER_ROUNDING;
+		uint64_t acc1 = MIXER_ROUNDING;
+
+		// Two voices per step. Sample 'i' of both voices is packed in
+		// one register and sample 'i + 1' in another, so each SMLALD
+		// does both multiplications and the 64-bit accumulation.
+		for (v = 0; v < pairs; v++)
+		{
+			uint32_t a = load16x2(src[v * 2] + i);
+			uint32_t b = load16x2(src[v * 2 + 1] + i);
+
+			acc0 = __SMLALD(__PKHBT(a, b, 16), packed_gains[v], acc0);
+			acc1 = __SMLALD(__PKHTB(b, a, 16), packed_gains[v], acc1);
+		}
+
+		if (voices & 1)
+		{
+			uint32_t a = load16x2(src[voices - 1] + i);
+			int32_t g = gains[voices - 1];
+
+			acc0 += (int64_t) ((int16_t) a * g);
+			acc1 += (int64_t) (((int32_t) a >> 16) * g);
+		}
+
+		out[i] = (int32_t) ((int64_t) acc0 >> MIXER_GAIN_SHIFT);
+		out[i + 1] = (int32_t) ((int64_t) acc1 >> MIXER_GAIN_SHIFT);
+	}
+}
+
+void mixerSaturate(int16_t* out, const int32_t* in, uint32_t samples)
+{
+	uint32_t* dst = (uint32_t*) out;
+
+	for (uint32_t i = 0; i < samples; i += 2)
+		*dst++ = __PKHBT(__SSAT(in[i], 16), __SSAT(in[i + 1], 16), 16);
+}
+
+#else
+
+void mixerMix(int32_t* out, const int16_t* const* src, const int16_t* gains,
+			  uint32_t voices, uint32_t samples)
+{
+	mixerMixReference(out, src, gains, voices, samples);
+}
+
+void mixerSaturate(int16_t* out, const int32_t* in, uint32_t samples)
+{
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		int32_t s = in[i];
+
+		if (s > INT16_MAX)
+			s = INT16_MAX;
+		else if (s < INT16_MIN)
+			s = INT16_MIN;
+
+		out[i] = (int16_t) s;
+	}
+}
+
+#endif // __ARM_FEATURE_DSP
+
+AudioMixer::AudioMixer() :
+	voices_count(0), sample_rate(44100), limiter_enabled(false), output_pos(MIXER_BLOCK_FRAMES),
+	requests(0), busy_cycles(0)
+{
+	for (uint8_t i = 0; i <= MIXER_MAX_GROUPS; i++)
+	{
+		groups[i].target = MIXER_UNITY_GAIN;
+		groups[i].step = 0;
+		groups[i].gain = MIXER_UNITY_GAIN;
+	}
+}
+
+bool AudioMixer::begin(uint32_t sample_rate)
+{
+	this->sample_rate = sample_rate;
+	requests = 0;
+	return addToPlaylist();
+}
+
+void AudioMixer::end()
+{
+	removeFromPlaylist();
+}
+
+bool AudioMixer::addVoice(Voice* voice)
+{
+	if (!voice || voices_count == MIXER_MAX_VOICES)
+		return false;
+
+	for (uint8_t i = 0; i < voices_count; i++)
+	{
+		if (voices[i] == voice)
+			return true;
+	}
+
+	voices[voices_count++] = voice;
+	return true;
+}
+
+void AudioMixer::configureLimiter(bool enable, float threshold_db, uint32_t release_ms, uint32_t sample_rate)
+{
+	limiter_enabled = false;
+	limiter.configure(threshold_db, release_ms, sample_rate, MIXER_BLOCK_FRAMES);
+	limiter_enabled = enable;
+}
+
+void AudioMixer::setGroupVolume(uint8_t group, float volume, uint32_t fade_ms)
+{
+	if (!group || group > MIXER_MAX_GROUPS)
+		return;
+
+	MixerGroup* g = &groups[group];
+	int16_t target = mixerGain(volume);
+	int32_t blocks = (int32_t) (((uint64_t) fade_ms * sample_rate) / (1000 * MIXER_BLOCK_FRAMES));
+	int32_t distance = (target > g->gain) ? target - g->gain : g->gain - target;
+
+	// A zero step means jumping straight to the target
+	int32_t step = blocks ? distance / blocks : 0;
+	if (blocks && !step)
+		step = 1;
+
+	__disable_irq();
+	g->step = (int16_t) step;
+	g->target = target;
+	__enable_irq();
+}
+
+float AudioMixer::getGroupVolume(uint8_t group)
+{
+	if (!group || group > MIXER_MAX_GROUPS)
+		return 1.0f;
+
+	return (float) groups[group].target / MIXER_UNITY_GAIN;
+}
+
+void AudioMixer::updateGroups()
+{
+	for (uint8_t i = 1; i <= MIXER_MAX_GROUPS; i++)
+	{
+		MixerGroup* g = &groups[i];
+		int16_t target = g->target;
+		int16_t step = g->step;
+
+		if (g->gain == target)
+			continue;
+
+		if (!step)
+			g->gain = target;
+		else if (g->gain < target)
+			g->gain = (target - g->gain > step) ? g->gain + step : target;
+		else
+			g->gain = (g->gain - target > step) ? g->gain - step : target;
+	}
+}
+
+void AudioMixer::mixBlock(int16_t* out)
+{
+	const int16_t* src[MIXER_MAX_VOICES];
+	int16_t gains[MIXER_MAX_VOICES];
+	uint8_t active = 0;
+
+	updateGroups();
+
+	for (uint8_t i = 0; i < voices_count; i++)
+	{
+		Voice* voice = voices[i];
+		if (!voice->isMixing())
+			continue;
+
+		int32_t gain = voice->nextGain();
+		uint8_t group = voice->getGroup();
+
+		if (group)
+		{
+			gain = (gain * groups[group].gain) >> MIXER_GAIN_SHIFT;
+			if (gain > INT16_MAX)
+				gain = INT16_MAX;
+		}
+
+		voice->render(render_buffer[active], MIXER_BLOCK_FRAMES);
+		src[active] = render_buffer[active];
+		gains[active] = (int16_t) gain;
+		active++;
+	}
+
+	if (active)
+		mixerMix(mix_buffer, src, gains, active, MIXER_BLOCK_SAMPLES);
+	else
+		memset(mix_buffer, 0, sizeof(mix_buffer));
+
+	// The limiter keeps running on silence to flush its look-ahead
+	if (limiter_enabled)
+		limiter.process(mix_buffer, MIXER_BLOCK_SAMPLES);
+
+	mixerSaturate(out, mix_buffer, MIXER_BLOCK_SAMPLES);
+}
+
+bool AudioMixer::getSamples(int16_t* buffer, uint32_t count)
+{
+	PROFILE_SCOPE(ProfileMix);
+	uint32_t start = DWT->CYCCNT;
+
+	requests++;
+
+	while (count)
+	{
+		// Mix straight into the driver buffer when a whole block fits
+		if (output_pos == MIXER_BLOCK_FRAMES && count >= MIXER_BLOCK_FRAMES)
+		{
+			mixBlock(buffer);
+			buffer += MIXER_BLOCK_SAMPLES;
+			count -= MIXER_BLOCK_FRAMES;
+			continue;
+		}
+
+		if (output_pos == MIXER_BLOCK_FRAMES)
+		{
+			mixBlock(output_block);
+			output_pos = 0;
+		}
+
+		uint32_t frames = MIXER_BLOCK_FRAMES - output_pos;
+		if (frames > count)
+			frames = count;
+
+		memcpy(buffer, &output_block[output_pos * MIXER_CHANNELS], frames * MIXER_CHANNELS * sizeof(int16_t));
+		buffer += frames * MIXER_CHANNELS;
+		output_pos += frames;
+		count -= frames;
+	}
+
+	busy_cycles += DWT->CYCCNT - start;
+	return true;
+}
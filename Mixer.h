@@ -0,0 +1,135 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Mixer.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __MIXER_H__
+#define __MIXER_H__
+
+#include <Arduino.h>
+#include "Voice.h"
+#include "Limiter.h"
+
+// Gains are signed 16-bit fixed point numbers with 12 fractional bits, so
+// the maximum channel volume (5.0) fits in a halfword and two voices can
+// be multiplied and accumulated at once with the Cortex-M4 SMLALD
+// instruction. Products are accumulated exactly in 64 bits and saturated
+// only once, when converting the mix back to 16-bit samples.
+#define MIXER_GAIN_SHIFT		12
+#define MIXER_UNITY_GAIN		(1 << MIXER_GAIN_SHIFT)
+#define MIXER_MAX_VOICES		10
+
+// Output is interleaved 16-bit stereo, mixed in blocks of this many frames
+#define MIXER_CHANNELS			2
+#define MIXER_BLOCK_FRAMES		64
+#define MIXER_BLOCK_SAMPLES		(MIXER_BLOCK_FRAMES * MIXER_CHANNELS)
+
+// Channel groups are numbered from 1, group 0 means no group
+#define MIXER_MAX_GROUPS		8
+
+int16_t mixerGain(float volume);
+
+// Mixing kernels. 'src' holds 'voices' pointers to 4-byte aligned buffers of
+// 'samples' samples each ('samples' must be even), 'gains' the gain of every
+// voice. 'out' receives the mix scaled back to sample units, not saturated.
+// mixerMix() uses the DSP instructions when available and it's bit-exact
+// with the portable mixerMixReference().
+void mixerMix(int32_t* out, const int16_t* const* src, const int16_t* gains,
+			  uint32_t voices, uint32_t samples);
+void mixerMixReference(int32_t* out, const int16_t* const* src, const int16_t* gains,
+					   uint32_t voices, uint32_t samples);
+void mixerSaturate(int16_t* out, const int32_t* in, uint32_t samples);
+
+class AudioMixer : public AudioSource
+{
+	/*
+	 * The mixing stage. It is the only source registered with the audio
+	 * driver and, every time the driver asks for samples, it renders all
+	 * the active voices block by block, mixes them together and passes
+	 * the result through the master bus limiter.
+	 *
+	 * Voices can belong to a group. The gain of a group is combined with
+	 * the gain of each of its voices once per block, and ramps towards
+	 * its target with a per-block step when fading.
+	*/
+
+public:
+	static AudioMixer& getInstance()
+	{
+		static AudioMixer mixer;
+		return mixer;
+	}
+
+	bool begin(uint32_t sample_rate);
+	void end();
+	bool addVoice(Voice* voice);
+
+	void setGroupVolume(uint8_t group, float volume, uint32_t fade_ms = 0);
+	float getGroupVolume(uint8_t group);
+
+	void configureLimiter(bool enable, float threshold_db, uint32_t release_ms, uint32_t sample_rate);
+	inline Limiter& getLimiter() { return limiter; }
+
+	// Number of times the driver asked for samples since begin(). The
+	// driver only does it once the codec is clocking samples out.
+	inline uint32_t getRequests() { return requests; }
+
+	// Core cycles spent in getSamples(), counted with the DWT cycle
+	// counter. Only moves if the counter was enabled.
+	inline uint32_t getBusyCycles() { return busy_cycles; }
+
+protected:
+	// Called from the audio interrupt to fetch 'count'
+	// frames of interleaved stereo samples
+	bool getSamples(int16_t* buffer, uint32_t count);
+
+private:
+	typedef struct
+	{
+		volatile int16_t target;
+		volatile int16_t step;
+		int16_t gain;
+	} MixerGroup;
+
+	AudioMixer();
+	void updateGroups();
+	void mixBlock(int16_t* out);
+
+	Voice* voices[MIXER_MAX_VOICES];
+	uint8_t voices_count;
+	uint32_t sample_rate;
+
+	MixerGroup groups[MIXER_MAX_GROUPS + 1];
+
+	Limiter limiter;
+	volatile bool limiter_enabled;
+
+	int16_t render_buffer[MIXER_MAX_VOICES][MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+	int32_t mix_buffer[MIXER_BLOCK_SAMPLES];
+
+	// Holds a mixed block when the driver asks for less than a block
+	int16_t output_block[MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+	uint32_t output_pos;
+
+	volatile uint32_t requests;
+	volatile uint32_t busy_cycles;
+};
+
+#endif /* __MIXER_H__ */
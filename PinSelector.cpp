@@ -0,0 +1,122 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### PinSelector.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "PinSelector.h"
+#include "InputScanner.h"
+#include "Debug.h"
+
+void PinSelector::begin(uint16_t mask, bool active_low, uint32_t settle_ms, bool stop_on_zero,
+						uint8_t polyphony, LatchStealMode steal, uint8_t group, float volume)
+{
+	this->mask = mask;
+	this->active_low = active_low;
+	this->settle = settle_ms;
+	this->stop_on_zero = stop_on_zero;
+
+	// The scanner debounces the pins, the settle time takes care
+	// of the bits not changing all at the same time
+	for (uint8_t i = 0; i < INPUT_PINS_COUNT; i++)
+	{
+		if (mask & (1 << i))
+		{
+			pinMode(i, active_low ? INPUT_PULLUP : INPUT_PULLDOWN);
+			InputScanner::getInstance().enable(i, 0);
+		}
+	}
+
+	value = decode(inputReadPins());
+	last = value;
+	pending = false;
+	voices.begin(polyphony, steal, group, volume);
+
+	debugMsg(DebugInfo, "Pin selector enabled (mask 0x%04X, %i ms settle)", mask, settle);
+}
+
+void PinSelector::end()
+{
+	// The players go back to the pool before the voices are forgotten
+	voices.end();
+
+	for (uint8_t i = 0; i < INPUT_PINS_COUNT; i++)
+	{
+		if (mask & (1 << i))
+			InputScanner::getInstance().disable(i);
+	}
+
+	mask = 0;
+	pending = false;
+}
+
+// Packs the pins of the group into consecutive bits
+uint16_t PinSelector::decode(uint16_t levels)
+{
+	uint16_t ret = 0;
+	uint16_t bit = 1;
+
+	if (active_low)
+		levels = ~levels;
+
+	for (uint16_t bits = mask; bits; bits &= bits - 1, bit <<= 1)
+	{
+		if (levels & bits & -bits)
+			ret |= bit;
+	}
+
+	return ret;
+}
+
+// Called with every input event that changes any of the group pins
+void PinSelector::update(uint16_t levels, uint32_t timestamp)
+{
+	value = decode(levels);
+	changed_at = timestamp;
+	pending = true;
+}
+
+bool PinSelector::poll()
+{
+	// Finished sounds free their players for the pins right away
+	voices.poll();
+
+	if (!pending || GetTickCount() - changed_at < settle)
+		return false;
+
+	pending = false;
+
+	if (value == last)
+		return false;
+
+	last = value;
+
+	if (!value)
+	{
+		if (stop_on_zero)
+			voices.stopAll();
+		return true;
+	}
+
+	debugMsg(DebugInfo, "Pin selector - value %i", value);
+	// Not trigger(): the latch stop codes are files here
+	voices.play(value, changed_at);
+	return true;
+}
@@ -0,0 +1,64 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### PinSelector.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __PINSELECTOR_H__
+#define __PINSELECTOR_H__
+
+#include <Arduino.h>
+#include "LatchedVoices.h"
+
+// A group of IO pins read as a binary number. The lowest pin of the group
+// is bit 0. When the number changes and then stays the same for the settle
+// time, N.wav is played, as if it had been latched. Zero means no sound,
+// and the same number is played again only after going through zero.
+// Unlike the latch, no number is a stop code: with 16 pins every value
+// from 1 to 65535 plays a file.
+class PinSelector
+{
+public:
+	PinSelector() : mask(0), active_low(false), settle(0), value(0), last(0), pending(false),
+					changed_at(0), stop_on_zero(false) {}
+
+	void begin(uint16_t mask, bool active_low, uint32_t settle_ms, bool stop_on_zero,
+			   uint8_t polyphony, LatchStealMode steal, uint8_t group, float volume);
+	void end();
+	void update(uint16_t levels, uint32_t timestamp);
+	bool poll();
+
+	inline uint16_t getMask() { return mask; }
+
+private:
+	uint16_t decode(uint16_t levels);
+
+	LatchedVoices voices;
+	uint16_t mask;
+	bool active_low;
+	uint32_t settle;
+	uint16_t value;
+	uint16_t last;
+	bool pending;
+	uint32_t changed_at;
+	bool stop_on_zero;
+};
+
+#endif /* __PINSELECTOR_H__ */
@@ -2,6 +2,11 @@
 #define __PLAYER_H__
 
 #include <Arduino.h>
+#include "Voice.h"
+#include "Mixer.h"
+#include "ClockGovernor.h"
+#include "Debug.h"
+#include "Trace.h"
 
 #define MAX_PLAYERS     10
 
@@ -21,49 +26,84 @@ class Player
     friend class PlayersPool;
 
 public:
-    bool play(const char* filename, PlayMode mode = PlayModeNormal)
+    bool play(const char* filename, PlayMode mode = PlayModeNormal, const WavInfo* header = NULL)
     {
+        // The clock has to be up before the voice adds to the load
+        ClockGovernor::getInstance().boost();
+
+        // A preempted player is still fading out the previous sound, the
+        // new one starts from poll() when the fade is over. The file name
+        // and header must stay valid until then.
+        if (status == playerStopping && preempted)
+        {
+            pending_file = filename;
+            pending_mode = mode;
+            pending_header = header;
+            pending = true;
+            return true;
+        }
+
         if (status == playerPausing ||
             status == playerStopping)
         {
-            wav.stop();
+            voice.stop();
             status = playerStopped;
         }
 
         if (status == playerStopped ||
             status == playerPaused)
         {
-            wav.setVolume(base_volume);
+            voice.setVolume(base_volume);
+            voice.setRate(base_rate);
         }
 
-        if (wav.play(filename, mode))
+        if (voice.play(filename, mode, header))
         {
+            Trace::getInstance().recordName(TracePlay, number + 1, mode, filename);
             status = playerPlaying;
+            trace();
             return true;
         }
 
+        Trace::getInstance().recordName(TracePlayError, number + 1, mode, filename);
+        trace();
         return false;
     }
 
     void stop(bool ramp_volume = false)
     {
+        // A stop by the owner is not a preemption fade anymore
+        pending = false;
+        preempted = false;
+
         if (status == playerStopped)
             return;
 
         if (ramp_volume && status != playerPaused)
         {
             if (status == playerPlaying)
-                wav.setVolume(0);
+                voice.setVolume(0);
 
             status = playerStopping;
         } else {
-            wav.stop();
+            voice.stop();
             status = playerStopped;
         }
+
+        trace();
+    }
+
+    // True when the player is stopped and no longer fading out
+    bool idle()
+    {
+        return status == playerStopped;
     }
 
     int32_t getStatus()
     {
+        if (pending)
+            return playerPlaying;
+
         switch (status)
         {
             case playerStopping:
@@ -82,6 +122,9 @@ public:
 
     void pause(bool ramp_volume = false)
     {
+        if (pending)
+            stop();
+
         if (status == playerPaused  ||
             status == playerStopped ||
             status == playerStopping)
@@ -91,13 +134,15 @@ public:
         {
             if (status == playerPlaying)
             {
-                wav.setVolume(0);
+                voice.setVolume(0);
 				status = playerPausing;
             }
         } else {
-            wav.pause();
+            voice.pause();
 			status = playerPaused;
         }
+
+        trace();
     }
 
     void resume()
@@ -108,11 +153,12 @@ public:
             return;
 
         if (status == playerPausing)
-            wav.pause();
+            voice.pause();
 
-        wav.setVolume(base_volume);
-        wav.resume();
+        voice.setVolume(base_volume);
+        voice.resume();
         status = playerPlaying;
+        trace();
     }
 
     float getVolume()
@@ -123,30 +169,143 @@ public:
     void setVolume(float volume)
     {
         base_volume = volume;
-        wav.setVolume(volume);
+
+        // Don't interrupt a fade-out, play() sets the volume
+        if (status != playerStopping)
+            voice.setVolume(volume);
+    }
+
+    float getRate()
+    {
+        return base_rate;
+    }
+
+    void setRate(float rate)
+    {
+        base_rate = rate;
+        voice.setRate(rate);
+    }
+
+    uint8_t getGroup()
+    {
+        return voice.getGroup();
+    }
+
+    void setGroup(uint8_t group)
+    {
+        if (group > MIXER_MAX_GROUPS)
+            group = 0;
+
+        voice.setGroup(group);
+    }
+
+    inline uint8_t getPriority() { return priority; }
+    inline void* getOwner() { return owner; }
+
+    inline uint32_t getUnderruns() { return voice.getUnderruns(); }
+    inline uint32_t getMinFill() { return voice.getMinFill(); }
+
+    void resetStats()
+    {
+        voice.resetStats();
+        reported_underruns = 0;
     }
 
 protected:
-    Player() : status(playerStopped), busy(false), base_volume(1.0f) {}
+    Player() : status(playerStopped), busy(false), base_volume(1.0f), base_rate(1.0f),
+               priority(0), owner(NULL), acquired(0), preempted(false), pending(false),
+               number(0), reported_underruns(0), traced_status(playerStopped) {}
+
+    // Records the status if it changed since the last call
+    void trace()
+    {
+        if (status != traced_status)
+        {
+            Trace::getInstance().record(TracePlayer, number + 1, status);
+            traced_status = status;
+        }
+    }
+
+    // Quickly fades out whatever is playing, for a new owner
+    void preempt()
+    {
+        pending = false;
+
+        if (status == playerPlaying || status == playerPausing)
+        {
+            voice.setVolume(0, VOICE_FAST_RAMP_STEP);
+            status = playerStopping;
+            preempted = true;
+        } else if (status != playerStopping)
+        {
+            voice.stop();
+            status = playerStopped;
+        } else {
+            preempted = true;
+        }
+
+        trace();
+    }
+
     void poll()
     {
-        if (status == playerStopping && wav.getVolume() == 0)
+        voice.poll();
+
+        // Underruns happen in the audio interrupt, they are logged from here
+        uint32_t underruns = voice.getUnderruns();
+        if (underruns != reported_underruns)
         {
-            wav.stop();
-        } else if (status == playerPausing && wav.getVolume() == 0)
+            debugMsg(DebugWarning, "Channel %i - %i underruns, min. buffer fill %i bytes",
+                     number + 1, underruns, voice.getMinFill());
+            Trace::getInstance().record(TraceUnderrun, number + 1, 0, underruns);
+            reported_underruns = underruns;
+        }
+
+        if (status == playerStopping && voice.getVolume() == 0)
         {
-            wav.pause();
+            voice.stop();
+            status = playerStopped;
+            preempted = false;
+
+            if (pending)
+            {
+                pending = false;
+                play(pending_file, pending_mode, pending_header);
+            }
+        } else if (status == playerPausing && voice.getVolume() == 0)
+        {
+            voice.pause();
             status = playerPaused;
         }
 
-        if (wav.getStatus() == AudioSourceStopped)
+        if (voice.getStatus() == AudioSourceStopped)
             status = playerStopped;
+
+        trace();
     }
 
     playerStatus status;
     bool busy;
     float base_volume;
-    WavPlayer wav;
+    float base_rate;
+    Voice voice;
+
+    // Ownership, set by PlayersPool::acquire()
+    uint8_t priority;
+    void* owner;
+    uint32_t acquired;
+    bool preempted;
+
+    // Play request waiting for a preemption fade
+    bool pending;
+    const char* pending_file;
+    PlayMode pending_mode;
+    const WavInfo* pending_header;
+
+    // Position in the pool, and what was already logged
+    uint8_t number;
+    uint32_t reported_underruns;
+    playerStatus traced_status;
 };
 
 class PlayersPool
@@ -162,16 +321,36 @@ class PlayersPool
     */
 
 private:
-    PlayersPool() : initialized(false), synchronized(true) {}
+    PlayersPool() : initialized(false), synchronized(true), reserved(0), reserved_priority(1)
+    {
+        for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+            players[i].number = i;
+    }
     Player players[MAX_PLAYERS];
 
     bool initialized;
     bool synchronized;
+    uint8_t reserved;
+    uint8_t reserved_priority;
+
+    Player* take(Player* player, uint8_t priority, void* owner)
+    {
+        player->busy = true;
+        player->priority = priority;
+        player->owner = owner;
+        player->acquired = GetTickCount();
+        return player;
+    }
 
 public:
     void initialize(bool synchronized = true)
     {
         this->synchronized = synchronized;
+
+        // Hand the voices to the mixing stage
+        for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+            AudioMixer::getInstance().addVoice(&players[i].voice);
+
         initialized = true;
     }
 
@@ -181,21 +360,57 @@ public:
         return pool;
     }
 
-    Player* acquire()
+    /*
+     * Players are given to the highest priority. The last 'reserved'
+     * free players can only be taken with at least 'reserved_priority'.
+     * If no player can be taken, the one playing with the lowest priority
+     * (the oldest among equals) is preempted if its priority is lower
+     * than the requested one: it fades out quickly, and changes owner
+     * right away. The previous owner finds out by checking getOwner().
+    */
+
+    void setReserved(uint8_t count, uint8_t min_priority)
+    {
+        reserved = (count < MAX_PLAYERS) ? count : MAX_PLAYERS - 1;
+        reserved_priority = min_priority;
+    }
+
+    Player* acquire(uint8_t priority = 0, void* owner = NULL)
     {
+        Player* free_player = NULL;
+        Player* victim = NULL;
+        uint8_t free_count = 0;
+        uint32_t now = GetTickCount();
+
         if (!synchronized || !initialized)
             return NULL;
 
         for (uint8_t i = 0; i < MAX_PLAYERS; i++)
         {
-            if (!players[i].busy)
+            Player* player = &players[i];
+
+            if (!player->busy)
             {
-                players[i].busy = true;
-                return &players[i];
+                if (!free_player)
+                    free_player = player;
+                free_count++;
+            } else if (player->priority < priority && !player->pending)
+            {
+                if (!victim || player->priority < victim->priority ||
+                    (player->priority == victim->priority &&
+                     now - player->acquired > now - victim->acquired))
+                    victim = player;
             }
         }
 
-        return NULL;
+        if (free_player && (free_count > reserved || priority >= reserved_priority))
+            return take(free_player, priority, owner);
+
+        if (!victim)
+            return NULL;
+
+        victim->preempt();
+        return take(victim, priority, owner);
     }
 
     void release(Player* player)
@@ -203,8 +418,10 @@ public:
         if (!synchronized || !initialized || !player)
             return;
 
-        // Ensure stopped state
+        // Ensure stopped state, with no preemption left behind
         player->stop();
+        player->pending = false;
+        player->preempted = false;
         player->busy = false;
     }
 
@@ -213,7 +430,7 @@ public:
         if (synchronized || !initialized)
             return NULL;
 
-        if (num > MAX_PLAYERS)
+        if (num >= MAX_PLAYERS)
             return NULL;
 
         players[num].busy = true;
@@ -268,6 +485,62 @@ public:
         }
     }
 
+    /*
+     * Group transport. Ramped operations only change volumes and
+     * states, so they are done with interrupts masked and all the
+     * voices of the group change within the same mixer block.
+    */
+
+    void stopGroup(uint8_t group, bool ramp_volume = false)
+    {
+        if (!initialized || !group)
+            return;
+
+        if (ramp_volume)
+            __disable_irq();
+
+        for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+        {
+            if (players[i].busy && players[i].getGroup() == group)
+                players[i].stop(ramp_volume);
+        }
+
+        if (ramp_volume)
+            __enable_irq();
+    }
+
+    void pauseGroup(uint8_t group, bool ramp_volume = false)
+    {
+        if (!initialized || !group)
+            return;
+
+        __disable_irq();
+
+        for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+        {
+            if (players[i].busy && players[i].getGroup() == group)
+                players[i].pause(ramp_volume);
+        }
+
+        __enable_irq();
+    }
+
+    void resumeGroup(uint8_t group)
+    {
+        if (!initialized || !group)
+            return;
+
+        __disable_irq();
+
+        for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+        {
+            if (players[i].busy && players[i].getGroup() == group)
+                players[i].resume();
+        }
+
+        __enable_irq();
+    }
+
     void releaseAll()
     {
         if (!initialized || !synchronized)
@@ -283,7 +556,7 @@ public:
 
     	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
         {
-    			status = players[i].wav.getStatus();
+    			status = players[i].voice.getStatus();
             if (status == AudioSourcePlaying || status == AudioSourcePaused)
                 return true;
         }
@@ -291,7 +564,23 @@ public:
         return false;
     }
 
+    uint8_t playingCount()
+    {
+        uint8_t count = 0;
+
+        for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+        {
+            if (players[i].voice.getStatus() == AudioSourcePlaying)
+                count++;
+        }
+
+        return count;
+    }
+
     inline uint8_t getMaxPlayers() { return MAX_PLAYERS; }
+
+    // Any player, in use or not, for reading its statistics
+    inline Player* at(uint8_t num) { return (num < MAX_PLAYERS) ? &players[num] : NULL; }
 };
 
 #endif // __PLAYER_H__
@@ -0,0 +1,234 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Profiler.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <Arduino.h>
+#include "Debug.h"
+
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+// Time source: the DWT cycle counter on the board, std::chrono
+// when the code is built for a host simulation
+#ifndef PROFILER_CHRONO
+#if defined(__arm__)
+#define PROFILER_CHRONO 0
+#else
+#define PROFILER_CHRONO 1
+#endif
+#endif
+
+#if PROFILER_CHRONO
+#include <chrono>
+#endif
+
+// Stages of loop() that are measured, plus the mixer interrupt
+enum ProfileStage
+{
+	ProfileLoop,			// Whole loop() body
+	ProfileLoopPeriod,		// Start to start of loop(), sleep included
+	ProfileLeds,
+	ProfilePlayers,			// Voices reading from the SD card
+	ProfileMode,			// pollIoMode()/pollSerialMode()/pollLatchedMode()
+	ProfileSerial,			// Serial control in IO and latched modes
+	ProfileGovernor,
+	ProfileDebug,			// Sending debug messages
+	ProfileMix,				// AudioMixer::getSamples()
+	ProfileTrace,			// Writing the event trace to the SD card
+	ProfileStagesCount
+};
+
+struct ProfileStats
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+};
+
+class Profiler
+{
+public:
+	static Profiler& getInstance()
+	{
+		static Profiler instance;
+		return instance;
+	}
+
+	void begin()
+	{
+#if !PROFILER_CHRONO
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+		reset();
+	}
+
+	// Ticks are core cycles (at whatever clock the core runs at the
+	// moment) or nanoseconds with std::chrono
+	static inline uint32_t now()
+	{
+#if PROFILER_CHRONO
+		return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+		return DWT->CYCCNT;
+#endif
+	}
+
+	// Statistics are kept in nanoseconds, so stages shorter than a
+	// microsecond still count and the average isn't biased by rounding
+	inline void add(ProfileStage stage, uint32_t ticks)
+	{
+		ProfileStats* s = &stats[stage];
+		uint32_t ns = toNanoseconds(ticks);
+
+		if (ns < s->min)
+			s->min = ns;
+		if (ns > s->max)
+			s->max = ns;
+		s->total += ns;
+		s->count++;
+	}
+
+	// Called at the start of every loop()
+	inline void loopStart()
+	{
+		uint32_t t = now();
+
+		if (loop_started)
+			add(ProfileLoopPeriod, t - last_loop);
+
+		last_loop = t;
+		loop_started = true;
+	}
+
+	// Statistics of a stage, in nanoseconds
+	bool get(uint8_t stage, ProfileStats* out)
+	{
+		if (stage >= ProfileStagesCount)
+			return false;
+
+		// The mixer stage is updated from the audio interrupt
+		lock();
+		*out = stats[stage];
+		unlock();
+		return true;
+	}
+
+	void reset()
+	{
+		lock();
+		clear();
+		unlock();
+	}
+
+private:
+	Profiler() : last_loop(0), loop_started(false), scale_clock(0), ns_scale(0)
+	{
+		clear();
+	}
+
+	// With the clock governor the core clock changes, so cycles are
+	// converted at the clock they were counted at. The factor is 16.16
+	// fixed point and only computed again when the clock changes.
+	inline uint32_t toNanoseconds(uint32_t ticks)
+	{
+#if PROFILER_CHRONO
+		return ticks;
+#else
+		uint32_t clock = SystemCoreClock;
+
+		if (clock != scale_clock)
+		{
+			// The factor first: the mixer interrupt that comes in
+			// between sees the old clock and computes it again
+			ns_scale = (uint32_t) ((1000000000ull << 16) / clock);
+			scale_clock = clock;
+		}
+
+		uint64_t ns = ((uint64_t) ticks * ns_scale) >> 16;
+		return (ns > UINT32_MAX) ? UINT32_MAX : (uint32_t) ns;
+#endif
+	}
+
+	void clear()
+	{
+		for (uint8_t i = 0; i < ProfileStagesCount; i++)
+		{
+			stats[i].count = 0;
+			stats[i].min = UINT32_MAX;
+			stats[i].max = 0;
+			stats[i].total = 0;
+		}
+
+		loop_started = false;
+	}
+
+	static inline void lock()
+	{
+#if !PROFILER_CHRONO
+		__disable_irq();
+#endif
+	}
+
+	static inline void unlock()
+	{
+#if !PROFILER_CHRONO
+		__enable_irq();
+#endif
+	}
+
+	ProfileStats stats[ProfileStagesCount];
+	uint32_t last_loop;
+	bool loop_started;
+	volatile uint32_t scale_clock;
+	volatile uint32_t ns_scale;
+};
+
+// Measures from its construction to the end of the enclosing block
+class ProfileScope
+{
+public:
+	inline ProfileScope(ProfileStage stage) : stage(stage), start(Profiler::now()) {}
+	inline ~ProfileScope() { Profiler::getInstance().add(stage, Profiler::now() - start); }
+
+private:
+	ProfileStage stage;
+	uint32_t start;
+};
+
+#if ENABLE_PROFILER
+#define PROFILE_CONCAT2(a, b)	a##b
+#define PROFILE_CONCAT(a, b)	PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(stage)	ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(stage)
+#define PROFILE_LOOP_START()	Profiler::getInstance().loopStart()
+#else
+#define PROFILE_SCOPE(stage)	do {} while (0)
+#define PROFILE_LOOP_START()	do {} while (0)
+#endif
+
+#endif /* __PROFILER_H__ */
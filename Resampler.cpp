@@ -0,0 +1,245 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Resampler.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "Resampler.h"
+#include <math.h>
+
+// Cutoff of the interpolation filter, relative to the input rate, when
+// not downsampling
+#define RESAMPLER_CUTOFF		0.45f
+
+// Q15 coefficients. Two taps are packed in every word, in the
+// order expected by SMLALD.
+static uint32_t coefficients[RESAMPLER_BANKS][RESAMPLER_PHASES][RESAMPLER_TAPS / 2];
+static bool coefficients_ready = false;
+
+// Bank N is for a step of 2^(N/2) and has its cutoff scaled by the inverse.
+// These are the steps where the next bank gets nearer, 2^((N + 0.5) / 2).
+static const uint32_t bank_limits[RESAMPLER_BANKS - 1] =
+{
+	77936, 110218, 155872, 220436, 311744, 440872
+};
+
+static uint32_t bankForStep(uint32_t step)
+{
+	uint32_t bank = 0;
+
+	while (bank < RESAMPLER_BANKS - 1 && step >= bank_limits[bank])
+		bank++;
+
+	return bank;
+}
+
+// Builds the Blackman-windowed sinc filter banks. Every phase is
+// normalized to unity gain at DC.
+void Resampler::initialize()
+{
+	float x[RESAMPLER_TAPS];
+	float window[RESAMPLER_TAPS];
+	float taps[RESAMPLER_TAPS];
+
+	if (coefficients_ready)
+		return;
+
+	for (uint32_t p = 0; p < RESAMPLER_PHASES; p++)
+	{
+		float frac = (float) p / RESAMPLER_PHASES;
+
+		// The window and the position of the taps are the same for all the banks
+		for (uint32_t t = 0; t < RESAMPLER_TAPS; t++)
+		{
+			float n;
+
+			x[t] = (float) t - (RESAMPLER_TAPS / 2 - 1) - frac;
+			n = x[t] + RESAMPLER_TAPS / 2;
+			window[t] = 0.42f - 0.5f * cosf(2.0f * (float) M_PI * n / RESAMPLER_TAPS) +
+						0.08f * cosf(4.0f * (float) M_PI * n / RESAMPLER_TAPS);
+		}
+
+		for (uint32_t b = 0; b < RESAMPLER_BANKS; b++)
+		{
+			float cutoff = RESAMPLER_CUTOFF * powf(2.0f, -0.5f * b);
+			float sum = 0;
+
+			for (uint32_t t = 0; t < RESAMPLER_TAPS; t++)
+			{
+				float h;
+
+				if (fabsf(x[t]) < 1e-6f)
+					h = 2.0f * cutoff;
+				else
+					h = sinf(2.0f * (float) M_PI * cutoff * x[t]) / ((float) M_PI * x[t]);
+
+				taps[t] = h * window[t];
+				sum += taps[t];
+			}
+
+			for (uint32_t t = 0; t < RESAMPLER_TAPS; t += 2)
+			{
+				int16_t c0 = (int16_t) lrintf(taps[t] / sum * INT16_MAX);
+				int16_t c1 = (int16_t) lrintf(taps[t + 1] / sum * INT16_MAX);
+				coefficients[b][p][t / 2] = (uint16_t) c0 | ((uint32_t) (uint16_t) c1 << 16);
+			}
+		}
+	}
+
+	coefficients_ready = true;
+}
+
+void Resampler::reset(ResamplerMode mode, uint32_t step)
+{
+	if (mode == ResamplerPolyphase && !coefficients_ready)
+		mode = ResamplerLinear;
+
+	this->mode = mode;
+	setStep(step);
+	phase = 0;
+	input_frames = 0;
+	memset(history, 0, sizeof(history));
+}
+
+void Resampler::setStep(uint32_t step)
+{
+	if (step > RESAMPLER_MAX_STEP)
+		step = RESAMPLER_MAX_STEP;
+
+	this->step = step;
+	bank = bankForStep(step);
+}
+
+uint32_t Resampler::prepare(uint32_t frames, int16_t** input)
+{
+	if (frames > RESAMPLER_CHUNK)
+		frames = RESAMPLER_CHUNK;
+
+	// Every new frame past the current history is needed: the last output
+	// frame reads up to them, and the history will be moved past them.
+	input_frames = (phase + frames * step) >> RESAMPLER_STEP_SHIFT;
+	*input = &history[RESAMPLER_TAPS * 2];
+	return input_frames;
+}
+
+void Resampler::process(int16_t* out, uint32_t frames)
+{
+	if (frames > RESAMPLER_CHUNK)
+		frames = RESAMPLER_CHUNK;
+
+	if (mode == ResamplerPolyphase)
+		processPolyphase(out, frames);
+	else
+		processLinear(out, frames);
+
+	// Keep the last frames as history for the next chunk
+	uint32_t position = phase + frames * step;
+	uint32_t consumed = position >> RESAMPLER_STEP_SHIFT;
+
+	memmove(history, &history[consumed * 2], RESAMPLER_TAPS * 2 * sizeof(int16_t));
+	phase = position & (RESAMPLER_UNITY_STEP - 1);
+}
+
+void Resampler::processLinear(int16_t* out, uint32_t frames)
+{
+	uint32_t position = phase;
+
+	for (uint32_t k = 0; k < frames; k++)
+	{
+		const int16_t* h = &history[((position >> RESAMPLER_STEP_SHIFT) + RESAMPLER_TAPS - 2) * 2];
+		int32_t frac = (position & (RESAMPLER_UNITY_STEP - 1)) >> 1;
+
+		*out++ = (int16_t) (h[0] + (((h[2] - h[0]) * frac) >> 15));
+		*out++ = (int16_t) (h[1] + (((h[3] - h[1]) * frac) >> 15));
+		position += step;
+	}
+}
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+
+static inline uint32_t load16x2(const int16_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+void Resampler::processPolyphase(int16_t* out, uint32_t frames)
+{
+	uint32_t position = phase;
+
+	for (uint32_t k = 0; k < frames; k++)
+	{
+		const int16_t* h = &history[(position >> RESAMPLER_STEP_SHIFT) * 2];
+		const uint32_t* c = coefficients[bank][(position >> (RESAMPLER_STEP_SHIFT - RESAMPLER_PHASE_BITS)) &
+											   (RESAMPLER_PHASES - 1)];
+		uint64_t left = 1 << 14;
+		uint64_t right = 1 << 14;
+
+		// Two taps per step: pack the left samples of two consecutive
+		// frames in a register and the right ones in another.
+		for (uint32_t t = 0; t < RESAMPLER_TAPS / 2; t++)
+		{
+			uint32_t f0 = load16x2(h);
+			uint32_t f1 = load16x2(h + 2);
+
+			left = __SMLALD(__PKHBT(f0, f1, 16), c[t], left);
+			right = __SMLALD(__PKHTB(f1, f0, 16), c[t], right);
+			h += 4;
+		}
+
+		*out++ = (int16_t) __SSAT((int32_t) ((int64_t) left >> 15), 16);
+		*out++ = (int16_t) __SSAT((int32_t) ((int64_t) right >> 15), 16);
+		position += step;
+	}
+}
+
+#else
+
+void Resampler::processPolyphase(int16_t* out, uint32_t frames)
+{
+	uint32_t position = phase;
+
+	for (uint32_t k = 0; k < frames; k++)
+	{
+		const int16_t* h = &history[(position >> RESAMPLER_STEP_SHIFT) * 2];
+		const uint32_t* c = coefficients[bank][(position >> (RESAMPLER_STEP_SHIFT - RESAMPLER_PHASE_BITS)) &
+											   (RESAMPLER_PHASES - 1)];
+		int64_t left = 1 << 14;
+		int64_t right = 1 << 14;
+
+		for (uint32_t t = 0; t < RESAMPLER_TAPS / 2; t++)
+		{
+			int32_t c0 = (int16_t) c[t];
+			int32_t c1 = (int16_t) (c[t] >> 16);
+
+			left += (int64_t) h[0] * c0 + (int64_t) h[2] * c1;
+			right += (int64_t) h[1] * c0 + (int64_t) h[3] * c1;
+			h += 4;
+		}
+
+		left >>= 15;
+		right >>= 15;
+		*out++ = (int16_t) (left > INT16_MAX ? INT16_MAX : (left < INT16_MIN ? INT16_MIN : left));
+		*out++ = (int16_t) (right > INT16_MAX ? INT16_MAX : (right < INT16_MIN ? INT16_MIN : right));
+		position += step;
+	}
+}
+
+#endif // __ARM_FEATURE_DSP
@@ -0,0 +1,93 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Resampler.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __RESAMPLER_H__
+#define __RESAMPLER_H__
+
+#include <Arduino.h>
+
+// Polyphase filter geometry: every output sample is computed with
+// RESAMPLER_TAPS input frames and one of RESAMPLER_PHASES filters.
+#define RESAMPLER_TAPS			16
+#define RESAMPLER_PHASE_BITS	6
+#define RESAMPLER_PHASES		(1 << RESAMPLER_PHASE_BITS)
+
+// The step is the amount of input frames per output frame, in Q16
+#define RESAMPLER_STEP_SHIFT	16
+#define RESAMPLER_UNITY_STEP	(1 << RESAMPLER_STEP_SHIFT)
+#define RESAMPLER_MAX_STEP		(8 << RESAMPLER_STEP_SHIFT)
+
+// When downsampling, the cutoff of the filter follows the output rate, so
+// what the output can't represent is filtered out instead of aliasing.
+// There is a filter bank for every half octave of step, up to the maximum,
+// and every step uses the nearest one.
+#define RESAMPLER_BANKS			7
+
+// Output frames produced per process() call and the input
+// frames that may be needed to produce them at the maximum step
+#define RESAMPLER_CHUNK			16
+#define RESAMPLER_MAX_INPUT		(RESAMPLER_CHUNK * (RESAMPLER_MAX_STEP >> RESAMPLER_STEP_SHIFT) + 2)
+
+enum ResamplerMode
+{
+	ResamplerOff,
+	ResamplerLinear,
+	ResamplerPolyphase
+};
+
+class Resampler
+{
+	/*
+	 * Streaming sample rate converter for interleaved 16-bit stereo.
+	 * Input frames are appended to a history that always keeps the
+	 * last RESAMPLER_TAPS frames, and the output position advances
+	 * through it in fixed point, so any ratio can be used.
+	 *
+	 * For every chunk, prepare() tells how many input frames are
+	 * needed and where to write them, then process() produces the
+	 * output frames.
+	*/
+
+public:
+	Resampler() : mode(ResamplerLinear), step(RESAMPLER_UNITY_STEP), phase(0), bank(0) {}
+
+	static void initialize();
+
+	void reset(ResamplerMode mode, uint32_t step);
+
+	void setStep(uint32_t step);
+	uint32_t prepare(uint32_t frames, int16_t** input);
+	void process(int16_t* out, uint32_t frames);
+
+private:
+	void processLinear(int16_t* out, uint32_t frames);
+	void processPolyphase(int16_t* out, uint32_t frames);
+
+	ResamplerMode mode;
+	uint32_t step;
+	uint32_t phase;
+	uint32_t bank;
+	uint32_t input_frames;
+	int16_t history[(RESAMPLER_TAPS + RESAMPLER_MAX_INPUT) * 2] __attribute__((aligned(4)));
+};
+
+#endif /* __RESAMPLER_H__ */
@@ -1,5 +1,10 @@
 #include "SerialProtocol.h"
 #include "Player.h"
+#include "Mixer.h"
+#include "InputEvents.h"
+#include "BootProfile.h"
+#include "Profiler.h"
+#include "WavIndex.h"
 #include "version.h"
 
 extern PlayersPool players;
@@ -15,7 +20,7 @@ Player* SerialProtocol::verify(wtePacket* packet)
 
     uint8_t channel = packet->data[0];
 	uint8_t num = channel - 1;
-	if (!channel || num > players.getMaxPlayers())
+	if (!channel || num >= players.getMaxPlayers())
 	{
 		sendErrorCode(ERROR_INVALID_CHANNEL);
 		return NULL;
@@ -28,6 +33,26 @@ Player* SerialProtocol::verify(wtePacket* packet)
     return player;
 }
 
+// Checks the group number in the first byte of the packet
+// and sends the appropriate error if it isn't valid.
+bool SerialProtocol::verifyGroup(wtePacket* packet)
+{
+	if (packet->data_len < 1)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return false;
+	}
+
+	uint8_t group = packet->data[0];
+	if (!group || group > MIXER_MAX_GROUPS)
+	{
+		sendErrorCode(ERROR_INVALID_GROUP);
+		return false;
+	}
+
+	return true;
+}
+
 void SerialProtocol::onPlayFile(wtePacket* packet)
 {
 	if (packet->data_len < 3)
@@ -92,6 +117,12 @@ void SerialProtocol::onPlayChannel(wtePacket* packet)
 	if (!player)
 		return;
 
+	if (!WavIndex::getInstance().exists(packet->data[0]))
+	{
+		sendErrorCode(ERROR_PLAYING);
+		return;
+	}
+
 	// Max. file can be 16.wav
 	char path[8];
 	snprintf(path, 8, "%i.wav", packet->data[0]);
@@ -258,6 +289,164 @@ void SerialProtocol::onSetChannelVolume(wtePacket* packet)
 	sendPacket(packet);
 }
 
+void SerialProtocol::onGetChannelRate(wtePacket* packet)
+{
+    Player* player = verify(packet);
+	if (!player)
+		return;
+
+	float rate = player->getRate();
+	uint16_t packet_rate = (uint16_t) (rate * 100.0f + 0.5f);
+	memcpy(packet->data, (uint8_t*) &packet_rate, 2);
+	packet->data_len = 2;
+	sendPacket(packet);
+}
+
+void SerialProtocol::onSetChannelRate(wtePacket* packet)
+{
+	if (packet->data_len != 3)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+    Player* player = verify(packet);
+	if (!player)
+		return;
+
+	uint16_t packet_rate;
+
+	// Rate in hundredths, from 0.25x to 4x
+	memcpy((uint8_t*) &packet_rate, &packet->data[1], 2);
+	if (packet_rate < 25)
+		packet_rate = 25;
+	else if (packet_rate > 400)
+		packet_rate = 400;
+
+    player->setRate((float) packet_rate / 100.0f);
+	packet->data_len = 0;
+	sendPacket(packet);
+}
+
+void SerialProtocol::onGetChannelGroup(wtePacket* packet)
+{
+	if (packet->data_len != 1)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+    Player* player = verify(packet);
+	if (!player)
+		return;
+
+	packet->data[0] = player->getGroup();
+	packet->data_len = 1;
+	sendPacket(packet);
+}
+
+void SerialProtocol::onSetChannelGroup(wtePacket* packet)
+{
+	if (packet->data_len != 2)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+    Player* player = verify(packet);
+	if (!player)
+		return;
+
+	uint8_t group = packet->data[1];
+	if (group > MIXER_MAX_GROUPS)
+	{
+		sendErrorCode(ERROR_INVALID_GROUP);
+		return;
+	}
+
+	player->setGroup(group);
+	packet->data_len = 0;
+	sendPacket(packet);
+}
+
+// Stop, pause and resume of a whole group. Stop
+// and pause are always done with a volume ramp.
+void SerialProtocol::onGroupTransport(wtePacket* packet)
+{
+	if (packet->data_len != 1)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	if (!verifyGroup(packet))
+		return;
+
+	uint8_t group = packet->data[0];
+
+	switch (packet->cmd)
+	{
+		case CMD_STOP_GROUP:
+			players.stopGroup(group, true);
+			break;
+
+		case CMD_PAUSE_GROUP:
+			players.pauseGroup(group, true);
+			break;
+
+		case CMD_RESUME_GROUP:
+			players.resumeGroup(group);
+			break;
+	}
+
+	packet->data_len = 1;
+	sendPacket(packet);
+}
+
+void SerialProtocol::onGetGroupVolume(wtePacket* packet)
+{
+	if (packet->data_len != 1)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	if (!verifyGroup(packet))
+		return;
+
+	float volume = AudioMixer::getInstance().getGroupVolume(packet->data[0]);
+	uint16_t packet_vol = (uint16_t) (volume * 100.0f + 0.5f);
+	memcpy(packet->data, (uint8_t*) &packet_vol, 2);
+	packet->data_len = 2;
+	sendPacket(packet);
+}
+
+// Sets the volume of a group, in hundredths, fading
+// to it in the given time (milliseconds) if not zero
+void SerialProtocol::onSetGroupVolume(wtePacket* packet)
+{
+	if (packet->data_len != 5)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	if (!verifyGroup(packet))
+		return;
+
+	uint16_t packet_vol;
+	uint16_t fade_ms;
+
+	memcpy((uint8_t*) &packet_vol, &packet->data[1], 2);
+	memcpy((uint8_t*) &fade_ms, &packet->data[3], 2);
+	if (packet_vol > 500)
+		packet_vol = 500;
+
+	AudioMixer::getInstance().setGroupVolume(packet->data[0], (float) packet_vol / 100.0f, fade_ms);
+	packet->data_len = 0;
+	sendPacket(packet);
+}
+
 void SerialProtocol::onSetSpeakersVolume(wtePacket* packet)
 {
 	if (packet->data_len != 2)
@@ -332,11 +521,184 @@ void SerialProtocol::onGetHeadphoneVolume(wtePacket* packet)
 	sendPacket(packet);
 }
 
+// Reports the limiter gain reduction, in tenths of dB: the current one
+// and the largest since the last time this command was received.
+void SerialProtocol::onGetGainReduction(wtePacket* packet)
+{
+	if (packet->data_len)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	Limiter& limiter = AudioMixer::getInstance().getLimiter();
+	int16_t gr[2];
+
+	gr[0] = (int16_t) (limiter.getGainReduction() * 10.0f);
+	gr[1] = (int16_t) (limiter.getMaxGainReduction() * 10.0f);
+
+	memcpy(packet->data, (uint8_t*) gr, 4);
+	packet->data_len = 4;
+	sendPacket(packet);
+}
+
+// Returns the number of input events dropped because the event queue
+// was full, and the maximum number of events that were waiting to be
+// handled. Sending a non-zero byte clears both counters after reading.
+void SerialProtocol::onGetInputStats(wtePacket* packet)
+{
+	if (packet->data_len > 1)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	InputEventQueue& queue = InputEventQueue::getInstance();
+	bool clear = (packet->data_len == 1 && packet->data[0]);
+	uint32_t stats[2];
+
+	stats[0] = queue.getOverflows();
+	stats[1] = queue.getHighWater();
+	if (clear)
+		queue.resetCounters();
+
+	memcpy(packet->data, (uint8_t*) stats, 8);
+	packet->data_len = 8;
+	sendPacket(packet);
+}
+
+// Returns when every boot phase completed, in microseconds since reset,
+// one 32-bit value per phase in the BootPhase order. 0 means the phase
+// didn't complete.
+void SerialProtocol::onGetBootProfile(wtePacket* packet)
+{
+	BootProfile& boot = BootProfile::getInstance();
+	uint32_t timestamps[BootPhasesCount];
+
+	for (uint8_t i = 0; i < BootPhasesCount; i++)
+		timestamps[i] = boot.get((BootPhase) i);
+
+	memcpy(packet->data, (uint8_t*) timestamps, sizeof(timestamps));
+	packet->data_len = sizeof(timestamps);
+	sendPacket(packet);
+}
+
+// Re-reads config.ini and applies the changes. Returns the pins that
+// were rebuilt (16 bits) and the RELOAD_* flags (8 bits).
+void SerialProtocol::onReloadConfig(wtePacket* packet)
+{
+	uint16_t pins;
+	uint8_t flags;
+
+	if (!reload_handler || !reload_handler(&pins, &flags))
+	{
+		sendErrorCode(ERROR_INTERNAL);
+		return;
+	}
+
+	memcpy(packet->data, (uint8_t*) &pins, 2);
+	packet->data[2] = flags;
+	packet->data_len = 3;
+	sendPacket(packet);
+}
+
+// Returns the runs, and the minimum, average and maximum time in
+// nanoseconds of a profiled stage (see ProfileStage). Sending a
+// non-zero second byte clears every stage after reading.
+void SerialProtocol::onGetProfile(wtePacket* packet)
+{
+	Profiler& profiler = Profiler::getInstance();
+	ProfileStats stats;
+	uint32_t data[4];
+
+	if (packet->data_len < 1 || packet->data_len > 2)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	if (!profiler.get(packet->data[0], &stats))
+	{
+		sendErrorCode(ERROR_INVALID_STAGE);
+		return;
+	}
+
+	if (packet->data_len == 2 && packet->data[1])
+		profiler.reset();
+
+	data[0] = stats.count;
+	data[1] = stats.count ? stats.min : 0;
+	data[2] = stats.count ? (uint32_t) (stats.total / stats.count) : 0;
+	data[3] = stats.max;
+
+	memcpy(packet->data, (uint8_t*) data, sizeof(data));
+	packet->data_len = sizeof(data);
+	sendPacket(packet);
+}
+
+void SerialProtocol::onGetChannelStats(wtePacket* packet)
+{
+	uint32_t data[3];
+
+	if (packet->data_len < 1 || packet->data_len > 2)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	uint8_t channel = packet->data[0];
+	Player* player = channel ? players.at(channel - 1) : NULL;
+	if (!player)
+	{
+		sendErrorCode(ERROR_INVALID_CHANNEL);
+		return;
+	}
+
+	data[0] = player->getUnderruns();
+	data[1] = player->getMinFill();
+	data[2] = VOICE_BUFFER_SIZE;
+
+	if (packet->data_len == 2 && packet->data[1])
+		player->resetStats();
+
+	memcpy(packet->data, (uint8_t*) data, sizeof(data));
+	packet->data_len = sizeof(data);
+	sendPacket(packet);
+}
+
+void SerialProtocol::onGetSdStats(wtePacket* packet)
+{
+	uint32_t data[VOICE_READ_BUCKETS * 2 + 1];
+
+	if (packet->data_len > 1)
+	{
+		sendErrorCode(ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	for (uint8_t i = 0; i < VOICE_READ_BUCKETS; i++)
+	{
+		data[i] = Voice::getReadCount(i);
+		data[VOICE_READ_BUCKETS + i] = Voice::getReadBucketLimit(i);
+	}
+
+	data[VOICE_READ_BUCKETS * 2] = Voice::getReadMax();
+
+	if (packet->data_len == 1 && packet->data[0])
+		Voice::resetReadStats();
+
+	memcpy(packet->data, (uint8_t*) data, sizeof(data));
+	packet->data_len = sizeof(data);
+	sendPacket(packet);
+}
+
 bool SerialProtocol::poll()
 {
 	if (!pullPacket(&packet))
 		return false;
 
+	Trace::getInstance().record(TraceCommand, packet.cmd, packet.data_len);
+
 	switch (packet.cmd)
 	{
 		case CMD_HELLO:
@@ -416,6 +778,64 @@ bool SerialProtocol::poll()
 			onGetHeadphoneVolume(&packet);
 			break;
 
+		case CMD_GET_GAIN_REDUCTION:
+			onGetGainReduction(&packet);
+			break;
+
+		case CMD_GET_CHANNEL_RATE:
+			onGetChannelRate(&packet);
+			break;
+
+		case CMD_SET_CHANNEL_RATE:
+			onSetChannelRate(&packet);
+			break;
+
+		case CMD_GET_CHANNEL_GROUP:
+			onGetChannelGroup(&packet);
+			break;
+
+		case CMD_SET_CHANNEL_GROUP:
+			onSetChannelGroup(&packet);
+			break;
+
+		case CMD_STOP_GROUP:
+		case CMD_PAUSE_GROUP:
+		case CMD_RESUME_GROUP:
+			onGroupTransport(&packet);
+			break;
+
+		case CMD_GET_GROUP_VOL:
+			onGetGroupVolume(&packet);
+			break;
+
+		case CMD_SET_GROUP_VOL:
+			onSetGroupVolume(&packet);
+			break;
+
+		case CMD_GET_INPUT_STATS:
+			onGetInputStats(&packet);
+			break;
+
+		case CMD_GET_BOOT_PROFILE:
+			onGetBootProfile(&packet);
+			break;
+
+		case CMD_RELOAD_CONFIG:
+			onReloadConfig(&packet);
+			break;
+
+		case CMD_GET_PROFILE:
+			onGetProfile(&packet);
+			break;
+
+		case CMD_GET_CHANNEL_STATS:
+			onGetChannelStats(&packet);
+			break;
+
+		case CMD_GET_SD_STATS:
+			onGetSdStats(&packet);
+			break;
+
 		default:
 			return false;
 	}
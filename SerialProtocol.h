@@ -3,8 +3,12 @@
 
 #include <Arduino.h>
 #include "Player.h"
+#include "Trace.h"
 #include "WaveTooEasy_Protocol.h"
 
+// Re-reads the configuration. Receives the rebuilt pins and RELOAD_* flags.
+typedef bool (*ReloadHandler)(uint16_t* pins, uint8_t* flags);
+
 class SerialProtocol
 {
 public:
@@ -63,14 +67,21 @@ public:
 
 	void sendErrorCode(uint8_t code)
 	{
+		Trace::getInstance().record(TraceError, code);
 		wteSendErrorCode(code);
 	}
 
     bool poll();
 
+	void setReloadHandler(ReloadHandler handler)
+	{
+		reload_handler = handler;
+	}
+
 private:
-    SerialProtocol() : serial(NULL) {}
+    SerialProtocol() : serial(NULL), reload_handler(NULL) {}
     Player* verify(wtePacket* packet);
+    bool verifyGroup(wtePacket* packet);
     void onPlayFile(wtePacket* packet);
     void onPlayChannel(wtePacket* packet);
     void onStopAll(wtePacket* packet);
@@ -87,8 +98,23 @@ private:
     void onSetHeadphoneVolume(wtePacket* packet);
     void onGetSpeakersVolume(wtePacket* packet);
     void onGetHeadphoneVolume(wtePacket* packet);
+    void onGetGainReduction(wtePacket* packet);
+    void onGetChannelRate(wtePacket* packet);
+    void onSetChannelRate(wtePacket* packet);
+    void onGetChannelGroup(wtePacket* packet);
+    void onSetChannelGroup(wtePacket* packet);
+    void onGroupTransport(wtePacket* packet);
+    void onGetGroupVolume(wtePacket* packet);
+    void onSetGroupVolume(wtePacket* packet);
+    void onGetInputStats(wtePacket* packet);
+    void onGetBootProfile(wtePacket* packet);
+    void onReloadConfig(wtePacket* packet);
+    void onGetProfile(wtePacket* packet);
+    void onGetChannelStats(wtePacket* packet);
+    void onGetSdStats(wtePacket* packet);
 
 	UARTClass* serial;
+	ReloadHandler reload_handler;
 	wtePacket packet;
 };
 
@@ -0,0 +1,609 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Settings.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "Settings.h"
+#include "StringPool.h"
+#include "Debug.h"
+#include <ff.h>
+#include <stddef.h>
+#include <strings.h>
+#include <ctype.h>
+
+enum SettingType
+{
+	SettingUInt,
+	SettingFloat,
+	SettingBool,
+	SettingString,
+	SettingMode,
+	SettingResampler,
+	SettingSteal,
+	SettingPinList,
+	SettingPinMode,
+	SettingPinSelect,
+	SettingFile
+};
+
+struct SettingKey
+{
+	const char* section;
+	const char* key;
+	uint8_t type;
+	uint16_t offset;
+	uint16_t size;
+};
+
+#define SETTING(section, key, type, field) \
+	{ section, key, type, offsetof(Settings, field), sizeof(((Settings*) 0)->field) }
+
+#define PIN_SETTING(key, type, field) \
+	{ "io", key, type, offsetof(PinSettings, field), sizeof(((PinSettings*) 0)->field) }
+
+static const SettingKey settings_keys[] =
+{
+	SETTING("settings", "mode", SettingMode, mode),
+	SETTING("settings", "sample_rate", SettingUInt, sample_rate),
+	SETTING("settings", "speakers_volume", SettingFloat, speakers_volume),
+	SETTING("settings", "headphone_volume", SettingFloat, headphone_volume),
+	SETTING("settings", "baudrate", SettingUInt, baudrate),
+	SETTING("settings", "disable_leds", SettingBool, disable_leds),
+	SETTING("settings", "serial_control", SettingBool, serial_control),
+	SETTING("settings", "wav_index", SettingBool, wav_index),
+	SETTING("settings", "low_power_timeout", SettingUInt, low_power_timeout),
+	SETTING("settings", "low_power_suspend", SettingBool, low_power_suspend),
+	SETTING("settings", "clock_governor", SettingBool, clock_governor),
+	SETTING("settings", "trace", SettingBool, trace),
+	SETTING("settings", "trace_size", SettingUInt, trace_size),
+	SETTING("settings", "limiter", SettingBool, limiter),
+	SETTING("settings", "limiter_threshold", SettingFloat, limiter_threshold),
+	SETTING("settings", "limiter_release", SettingUInt, limiter_release),
+	SETTING("settings", "resampler", SettingResampler, resampler),
+	SETTING("io", "reserved_voices", SettingUInt, reserved_voices),
+	SETTING("io", "reserved_priority", SettingUInt, reserved_priority),
+	SETTING("io", "selector_pins", SettingPinList, selector_pins),
+	SETTING("io", "selector_active_low", SettingBool, selector_active_low),
+	SETTING("io", "selector_settle", SettingUInt, selector_settle),
+	SETTING("io", "selector_stop", SettingBool, selector_stop),
+	SETTING("io", "selector_polyphony", SettingUInt, selector_polyphony),
+	SETTING("io", "selector_steal", SettingSteal, selector_steal),
+	SETTING("io", "selector_group", SettingString, selector_group),
+	SETTING("io", "selector_volume", SettingFloat, selector_volume),
+	SETTING("latch", "latch_polarity", SettingBool, latch_polarity),
+	SETTING("latch", "input_polarity", SettingBool, input_polarity),
+	SETTING("latch", "polyphony", SettingUInt, polyphony),
+	SETTING("latch", "steal", SettingSteal, steal),
+	SETTING("latch", "group", SettingString, latch_group),
+	SETTING("latch", "volume", SettingFloat, latch_volume),
+};
+
+// Keys of [io] in the form pinN_key
+static const SettingKey pin_keys[] =
+{
+	PIN_SETTING("mode", SettingPinMode, playback),
+	PIN_SETTING("file", SettingFile, file),
+	PIN_SETTING("volume", SettingFloat, volume),
+	PIN_SETTING("rate", SettingFloat, rate),
+	PIN_SETTING("debounce", SettingUInt, debounce),
+	PIN_SETTING("priority", SettingUInt, priority),
+	PIN_SETTING("select", SettingPinSelect, select),
+	PIN_SETTING("group", SettingString, group),
+};
+
+#define COUNT_OF(x)		(sizeof(x) / sizeof(x[0]))
+
+void settingsDefaults(Settings* settings)
+{
+	memset(settings, 0, sizeof(Settings));
+
+	settings->mode = MODE_IO;
+	settings->sample_rate = 44100;
+	settings->baudrate = 115200;
+	settings->wav_index = true;
+	settings->limiter = true;
+	settings->limiter_threshold = LIMITER_DEFAULT_THRESHOLD;
+	settings->limiter_release = LIMITER_DEFAULT_RELEASE;
+	settings->resampler = ResamplerPolyphase;
+	settings->trace_size = 1024;
+
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
+		settings->group_volumes[i] = 1.0f;
+
+	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	{
+		PinSettings* pin = &settings->pins[i];
+		pin->playback = PlayModeNormal;
+		pin->polarity = PinActiveHigh;
+		pin->trigger = LevelTrigger;
+		pin->deassert = DeassertRestart;
+		pin->select = SelectRoundRobin;
+		pin->volume = 1.0f;
+		pin->rate = 1.0f;
+		pin->debounce = 5;
+		pin->file = STRING_POOL_INVALID;
+	}
+
+	settings->reserved_priority = 1;
+	settings->selector_settle = 10;
+	settings->selector_stop = true;
+	settings->selector_polyphony = 1;
+	settings->selector_steal = LatchStealOldest;
+	settings->selector_volume = 1.0f;
+
+	settings->polyphony = 1;
+	settings->steal = LatchStealOldest;
+	settings->latch_volume = 1.0f;
+}
+
+static bool parseBool(const char* value)
+{
+	return strcmp(value, "1") == 0 || strcasecmp(value, "true") == 0 ||
+		   strcasecmp(value, "yes") == 0 || strcasecmp(value, "on") == 0;
+}
+
+// Parses a list of pins like "1-4, 7, 9" into a mask (pin 1 is bit 0)
+static uint16_t parsePinList(const char* str)
+{
+	uint16_t mask = 0;
+	const char* p = str;
+
+	while (*p)
+	{
+		char* end;
+		uint32_t first = strtoul(p, &end, 10);
+		uint32_t last = first;
+
+		if (end == p)
+		{
+			p++;
+			continue;
+		}
+
+		p = end;
+		while (*p == ' ')
+			p++;
+
+		if (*p == '-')
+		{
+			last = strtoul(p + 1, &end, 10);
+			p = end;
+		}
+
+		for (uint32_t i = first; i <= last && i <= IO_PINS_COUNT; i++)
+		{
+			if (i)
+				mask |= (1 << (i - 1));
+		}
+	}
+
+	return mask;
+}
+
+static void parsePinMode(const char* value, PinSettings* pin)
+{
+	char mode[32];
+	uint8_t i;
+
+	for (i = 0; value[i] && i < sizeof(mode) - 1; i++)
+		mode[i] = tolower(value[i]);
+	mode[i] = 0;
+
+	pin->configured = true;
+
+	if (strstr(mode, "loop") != NULL)
+		pin->playback = PlayModeLoop;
+
+	if (strstr(mode, "low") != NULL)
+		pin->polarity = PinActiveLow;
+
+	if (strstr(mode, "edge") != NULL)
+		pin->trigger = EdgeTrigger;
+
+	if (strstr(mode, "pause") != NULL)
+		pin->deassert = DeassertPause;
+	else if (strstr(mode, "stop") != NULL)
+		// This should have sense only when trigger = EdgeTrigger
+		pin->deassert = DeassertStop;
+}
+
+static void storeValue(const SettingKey* key, uint8_t* base, const char* value)
+{
+	void* field = base + key->offset;
+
+	switch (key->type)
+	{
+		case SettingUInt:
+			*(uint32_t*) field = strtoul(value, NULL, 10);
+			break;
+
+		case SettingFloat:
+			*(float*) field = strtof(value, NULL);
+			break;
+
+		case SettingBool:
+			*(bool*) field = parseBool(value);
+			break;
+
+		case SettingString:
+			strncpy((char*) field, value, key->size - 1);
+			((char*) field)[key->size - 1] = 0;
+			break;
+
+		case SettingMode:
+			if (strcasecmp("serial", value) == 0)
+				*(uint8_t*) field = MODE_SERIAL;
+			else if (strcasecmp("io", value) == 0)
+				*(uint8_t*) field = MODE_IO;
+			else if (strcasecmp("latch", value) == 0)
+				*(uint8_t*) field = MODE_LATCHED;
+			break;
+
+		case SettingResampler:
+			if (strcasecmp("off", value) == 0)
+				*(ResamplerMode*) field = ResamplerOff;
+			else if (strcasecmp("linear", value) == 0)
+				*(ResamplerMode*) field = ResamplerLinear;
+			else if (strcasecmp("polyphase", value) == 0)
+				*(ResamplerMode*) field = ResamplerPolyphase;
+			break;
+
+		case SettingSteal:
+			if (strcasecmp("none", value) == 0)
+				*(LatchStealMode*) field = LatchStealNone;
+			else if (strcasecmp("oldest", value) == 0)
+				*(LatchStealMode*) field = LatchStealOldest;
+			break;
+
+		case SettingPinList:
+			*(uint16_t*) field = parsePinList(value);
+			break;
+
+		case SettingPinMode:
+			parsePinMode(value, (PinSettings*) base);
+			break;
+
+		case SettingPinSelect:
+			if (strcasecmp("random", value) == 0)
+				*(PinSelectMode*) field = SelectRandom;
+			else if (strcasecmp("sequence", value) == 0)
+				*(PinSelectMode*) field = SelectSequence;
+			else if (strcasecmp("roundrobin", value) == 0)
+				*(PinSelectMode*) field = SelectRoundRobin;
+			break;
+
+		case SettingFile:
+			if (*value)
+			{
+				uint16_t index = StringPool::getInstance().add(value);
+				*(uint16_t*) field = (index == STRING_POOL_INVALID) ? STRING_POOL_FULL : index;
+			}
+			break;
+	}
+}
+
+// Splits keys like "pin12_volume" into the number (1 based) and the suffix
+static bool parseIndexedKey(const char* key, const char* prefix, uint32_t* num, const char** suffix)
+{
+	uint32_t len = strlen(prefix);
+	char* end;
+
+	if (strncasecmp(key, prefix, len) != 0 || !isdigit((uint8_t) key[len]))
+		return false;
+
+	*num = strtoul(key + len, &end, 10);
+	if (*end != '_')
+		return false;
+
+	*suffix = end + 1;
+	return true;
+}
+
+static void setValue(Settings* settings, const char* section, const char* key, const char* value)
+{
+	const char* suffix;
+	uint32_t num;
+
+	for (uint32_t i = 0; i < COUNT_OF(settings_keys); i++)
+	{
+		if (strcasecmp(settings_keys[i].section, section) == 0 &&
+			strcasecmp(settings_keys[i].key, key) == 0)
+		{
+			storeValue(&settings_keys[i], (uint8_t*) settings, value);
+			return;
+		}
+	}
+
+	if (strcasecmp(section, "io") == 0 && parseIndexedKey(key, "pin", &num, &suffix) &&
+		num && num <= IO_PINS_COUNT)
+	{
+		for (uint32_t i = 0; i < COUNT_OF(pin_keys); i++)
+		{
+			if (strcasecmp(pin_keys[i].key, suffix) == 0)
+			{
+				storeValue(&pin_keys[i], (uint8_t*) &settings->pins[num - 1], value);
+				return;
+			}
+		}
+	} else if (strcasecmp(section, "groups") == 0)
+	{
+		if (parseIndexedKey(key, "group", &num, &suffix) && num && num <= MIXER_MAX_GROUPS)
+		{
+			if (strcasecmp(suffix, "name") == 0)
+			{
+				strncpy(settings->group_names[num - 1], value, SETTINGS_NAME_LEN - 1);
+				return;
+			} else if (strcasecmp(suffix, "volume") == 0)
+			{
+				settings->group_volumes[num - 1] = strtof(value, NULL);
+				return;
+			}
+		} else if (parseIndexedKey(key, "channel", &num, &suffix) && num && num <= MAX_PLAYERS &&
+				   strcasecmp(suffix, "group") == 0)
+		{
+			strncpy(settings->channel_groups[num - 1], value, SETTINGS_NAME_LEN - 1);
+			return;
+		}
+	}
+
+	debugMsg(DebugWarning, "Unknown setting [%s] %s", section, key);
+}
+
+static char* trim(char* str)
+{
+	char* end;
+
+	while (*str == ' ' || *str == '\t')
+		str++;
+
+	end = str + strlen(str);
+	while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+		*--end = 0;
+
+	return str;
+}
+
+static void parseLine(Settings* settings, char* line, char* section, uint32_t section_size)
+{
+	line = trim(line);
+
+	// Empty lines and comments
+	if (!*line || *line == ';' || *line == '#')
+		return;
+
+	if (*line == '[')
+	{
+		char* end = strchr(line, ']');
+		if (end)
+		{
+			*end = 0;
+			strncpy(section, trim(line + 1), section_size - 1);
+			section[section_size - 1] = 0;
+		}
+		return;
+	}
+
+	char* equal = strchr(line, '=');
+	if (!equal)
+		return;
+
+	*equal = 0;
+	char* key = trim(line);
+	char* value = trim(equal + 1);
+
+	// Remove quotes
+	uint32_t len = strlen(value);
+	if (len >= 2 && value[0] == '"' && value[len - 1] == '"')
+	{
+		value[len - 1] = 0;
+		value++;
+	}
+
+	setValue(settings, section, key, value);
+}
+
+// Reads the whole configuration file in one pass. Keys that are not
+// in the file keep the values from settingsDefaults().
+bool settingsLoad(const char* path, Settings* settings)
+{
+	FIL file;
+	char chunk[256];
+	char line[SETTINGS_MAX_LINE];
+	char section[16] = "";
+	uint32_t line_len = 0;
+	UINT read;
+
+	settingsDefaults(settings);
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+		return false;
+
+	do
+	{
+		if (f_read(&file, chunk, sizeof(chunk), &read) != FR_OK)
+		{
+			f_close(&file);
+			return false;
+		}
+
+		for (UINT i = 0; i < read; i++)
+		{
+			char c = chunk[i];
+
+			if (c == '\n')
+			{
+				line[line_len] = 0;
+				parseLine(settings, line, section, sizeof(section));
+				line_len = 0;
+			} else if (line_len < sizeof(line) - 1)
+			{
+				line[line_len++] = c;
+			}
+		}
+	} while (read == sizeof(chunk));
+
+	// Last line without a line feed
+	if (line_len)
+	{
+		line[line_len] = 0;
+		parseLine(settings, line, section, sizeof(section));
+	}
+
+	f_close(&file);
+	return true;
+}
+
+#define FNV_OFFSET_BASIS		0x811C9DC5
+#define FNV_PRIME				0x01000193
+
+static uint32_t fnv1a(const void* data, uint32_t len, uint32_t hash = FNV_OFFSET_BASIS)
+{
+	const uint8_t* p = (const uint8_t*) data;
+
+	while (len--)
+	{
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+// The size and modification time of config.ini, from its directory
+// entry: checking them doesn't read the file
+static bool statFile(const char* path, uint32_t* size, uint32_t* time)
+{
+	FILINFO info;
+
+	if (f_stat(path, &info) != FR_OK)
+		return false;
+
+	*size = info.fsize;
+	*time = ((uint32_t) info.fdate << 16) | info.ftime;
+	return true;
+}
+
+// Images written by another firmware build are never used, as the
+// layout of Settings may have changed
+static uint32_t buildHash()
+{
+	static const char build[] = __DATE__ " " __TIME__;
+	return fnv1a(build, sizeof(build));
+}
+
+static bool readCache(const char* cache_path, uint32_t ini_size, uint32_t ini_time, Settings* settings)
+{
+	FIL file;
+	SettingsCacheHeader header;
+	StringPool& pool = StringPool::getInstance();
+	uint32_t pool_room;
+	char* pool_data;
+	UINT read;
+
+	if (f_open(&file, cache_path, FA_READ) != FR_OK)
+		return false;
+
+	bool ok = f_read(&file, &header, sizeof(header), &read) == FR_OK &&
+			  read == sizeof(header) &&
+			  header.magic == SETTINGS_CACHE_MAGIC &&
+			  header.build == buildHash() &&
+			  header.settings_size == sizeof(Settings) &&
+			  header.ini_size == ini_size &&
+			  header.ini_time == ini_time &&
+			  f_read(&file, settings, sizeof(Settings), &read) == FR_OK &&
+			  read == sizeof(Settings);
+
+	if (ok)
+	{
+		pool_data = pool.reserve(&pool_room);
+		ok = header.pool_size <= pool_room &&
+			 f_read(&file, pool_data, header.pool_size, &read) == FR_OK &&
+			 read == header.pool_size &&
+			 fnv1a(pool_data, header.pool_size, fnv1a(settings, sizeof(Settings))) == header.checksum &&
+			 (!header.pool_size || pool.adopt(header.pool_size));
+	}
+
+	f_close(&file);
+	return ok;
+}
+
+static void writeCache(const char* cache_path, uint32_t ini_size, uint32_t ini_time, Settings* settings)
+{
+	FIL file;
+	SettingsCacheHeader header;
+	StringPool& pool = StringPool::getInstance();
+	UINT written;
+
+	header.magic = SETTINGS_CACHE_MAGIC;
+	header.build = buildHash();
+	header.settings_size = sizeof(Settings);
+	header.ini_size = ini_size;
+	header.ini_time = ini_time;
+	header.pool_size = pool.getUsed();
+	header.checksum = fnv1a(pool.getData(), header.pool_size, fnv1a(settings, sizeof(Settings)));
+
+	if (f_open(&file, cache_path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		debugMsg(DebugWarning, "Cannot write %s", cache_path);
+		return;
+	}
+
+	bool ok = f_write(&file, &header, sizeof(header), &written) == FR_OK &&
+			  f_write(&file, settings, sizeof(Settings), &written) == FR_OK &&
+			  f_write(&file, pool.getData(), header.pool_size, &written) == FR_OK;
+
+	f_close(&file);
+
+	// Don't leave a half written image around
+	if (!ok)
+		f_unlink(cache_path);
+}
+
+// Loads the settings from the binary image if it was made from a config.ini
+// of the same size and modification time (and by the same firmware), so a
+// boot with an unchanged config.ini reads the image alone. Otherwise parses
+// config.ini and writes a new image. FAT times have a two seconds
+// resolution: an edit that keeps the size within the same two seconds is
+// only seen after deleting the image. Must be called while the string pool
+// is empty.
+bool settingsLoadCached(const char* path, const char* cache_path, Settings* settings,
+						bool* from_cache)
+{
+	uint32_t ini_size;
+	uint32_t ini_time;
+
+	*from_cache = false;
+
+	if (!statFile(path, &ini_size, &ini_time))
+		return false;
+
+	if (readCache(cache_path, ini_size, ini_time, settings))
+	{
+		*from_cache = true;
+		return true;
+	}
+
+	if (!settingsLoad(path, settings))
+		return false;
+
+	writeCache(cache_path, ini_size, ini_time, settings);
+	return true;
+}
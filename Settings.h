@@ -0,0 +1,127 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Settings.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __SETTINGS_H__
+#define __SETTINGS_H__
+
+#include <Arduino.h>
+#include "IoPin.h"
+#include "LatchedVoices.h"
+#include "Resampler.h"
+#include "Mixer.h"
+
+#define IO_PINS_COUNT			16
+#define MODE_IO					1
+#define MODE_LATCHED			2
+#define MODE_SERIAL				3
+
+// Longest line of the configuration file. Longer lines are truncated.
+#define SETTINGS_MAX_LINE		320
+#define SETTINGS_NAME_LEN		16
+
+struct PinSettings
+{
+	bool configured;			// pinN_mode is present
+	PlayMode playback;
+	PinPolarity polarity;
+	PinTriggerType trigger;
+	DeassertMode deassert;
+	PinSelectMode select;
+	float volume;
+	float rate;
+	uint32_t debounce;
+	uint32_t priority;
+	uint16_t file;				// In the StringPool, STRING_POOL_INVALID if not set,
+								// STRING_POOL_FULL if it didn't fit
+	char group[SETTINGS_NAME_LEN];
+};
+
+// Everything in config.ini, read in a single pass
+struct Settings
+{
+	// [settings]
+	uint8_t mode;
+	uint32_t sample_rate;
+	float speakers_volume;
+	float headphone_volume;
+	uint32_t baudrate;
+	bool disable_leds;
+	bool serial_control;
+	bool wav_index;
+	uint32_t low_power_timeout;
+	bool low_power_suspend;
+	bool clock_governor;
+	bool trace;
+	uint32_t trace_size;		// In KB
+	bool limiter;
+	float limiter_threshold;
+	uint32_t limiter_release;
+	ResamplerMode resampler;
+
+	// [groups]
+	char group_names[MIXER_MAX_GROUPS][SETTINGS_NAME_LEN];
+	float group_volumes[MIXER_MAX_GROUPS];
+	char channel_groups[MAX_PLAYERS][SETTINGS_NAME_LEN];
+
+	// [io]
+	PinSettings pins[IO_PINS_COUNT];
+	uint32_t reserved_voices;
+	uint32_t reserved_priority;
+	uint16_t selector_pins;
+	bool selector_active_low;
+	uint32_t selector_settle;
+	bool selector_stop;
+	uint32_t selector_polyphony;
+	LatchStealMode selector_steal;
+	char selector_group[SETTINGS_NAME_LEN];
+	float selector_volume;
+
+	// [latch]
+	bool latch_polarity;
+	bool input_polarity;
+	uint32_t polyphony;
+	LatchStealMode steal;
+	char latch_group[SETTINGS_NAME_LEN];
+	float latch_volume;
+};
+
+// Binary image of the parsed settings, written next to config.ini
+#define SETTINGS_CACHE_MAGIC	0x43455457		// "WTEC"
+
+struct SettingsCacheHeader
+{
+	uint32_t magic;
+	uint32_t build;				// Hash of the firmware build time
+	uint32_t settings_size;
+	uint32_t ini_size;			// Size of config.ini
+	uint32_t ini_time;			// FAT date (high half) and time of config.ini
+	uint32_t pool_size;			// StringPool bytes following the settings
+	uint32_t checksum;			// FNV-1a of the settings and the pool
+};
+
+void settingsDefaults(Settings* settings);
+bool settingsLoad(const char* path, Settings* settings);
+bool settingsLoadCached(const char* path, const char* cache_path, Settings* settings,
+						bool* from_cache);
+
+#endif /* __SETTINGS_H__ */
@@ -0,0 +1,81 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### StringPool.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "StringPool.h"
+#include "Debug.h"
+
+uint16_t StringPool::find(const char* str, uint32_t len)
+{
+	uint32_t pos = 0;
+
+	while (pos < used)
+	{
+		uint32_t entry_len = strlen(&pool[pos]);
+		if (entry_len == len && memcmp(&pool[pos], str, len) == 0)
+			return pos;
+
+		pos += entry_len + 1;
+	}
+
+	return STRING_POOL_INVALID;
+}
+
+uint16_t StringPool::add(const char* str)
+{
+	if (!str)
+		return STRING_POOL_INVALID;
+
+	uint32_t len = strlen(str);
+	uint16_t index = find(str, len);
+	if (index != STRING_POOL_INVALID)
+		return index;
+
+	if (used + len + 1 > STRING_POOL_SIZE)
+	{
+		debugMsg(DebugError, "String pool full, cannot add %s", str);
+		return STRING_POOL_INVALID;
+	}
+
+	memcpy(&pool[used], str, len + 1);
+	index = used;
+	used += len + 1;
+	return index;
+}
+
+char* StringPool::reserve(uint32_t* size)
+{
+	*size = STRING_POOL_SIZE - used;
+	if (*size)
+		pool[used] = 0;
+
+	return &pool[used];
+}
+
+bool StringPool::adopt(uint32_t size)
+{
+	if (used || !size || size > STRING_POOL_SIZE || pool[size - 1] != 0)
+		return false;
+
+	used = size;
+	return true;
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### StringPool.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __STRINGPOOL_H__
+#define __STRINGPOOL_H__
+
+#include <Arduino.h>
+
+#ifndef STRING_POOL_SIZE
+#define STRING_POOL_SIZE		2048
+#endif
+
+#define STRING_POOL_INVALID		0xFFFF
+
+// Not returned by the pool, marks a setting whose string didn't fit
+#define STRING_POOL_FULL		0xFFFE
+
+// Append-only storage for the strings kept for the whole run (file names).
+// Strings are stored once, one after the other, and referenced by their
+// 16-bit offset. Adding a string that is already in the pool returns the
+// existing one.
+class StringPool
+{
+public:
+	static StringPool& getInstance()
+	{
+		static StringPool instance;
+		return instance;
+	}
+
+	uint16_t add(const char* str);
+
+	// The free space after the strings, i.e. to read a saved pool into it
+	// before adopt(). What is written there is not kept otherwise.
+	char* reserve(uint32_t* size);
+
+	// Takes as contents the first 'size' bytes written in the area
+	// given by reserve(), i.e. a pool saved with getData()
+	bool adopt(uint32_t size);
+
+	// Forgets every string. Nothing may refer to them anymore.
+	inline void reset() { used = 0; }
+
+	inline const char* getData() { return pool; }
+
+	inline const char* get(uint16_t index)
+	{
+		return (index < used) ? &pool[index] : "";
+	}
+
+	inline uint32_t getUsed() { return used; }
+	inline uint32_t getSize() { return STRING_POOL_SIZE; }
+
+private:
+	StringPool() : used(0) {}
+	uint16_t find(const char* str, uint32_t len);
+
+	char pool[STRING_POOL_SIZE];
+	uint32_t used;
+};
+
+#endif /* __STRINGPOOL_H__ */
@@ -0,0 +1,305 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Trace.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+
+#include "Trace.h"
+#include "Debug.h"
+
+bool Trace::begin(uint32_t size)
+{
+	if (active)
+		end();
+
+	// Whole blocks, and at least two
+	max_size = size - (size % TRACE_BLOCK_SIZE);
+	if (max_size < TRACE_BLOCK_SIZE * 2)
+		max_size = TRACE_BLOCK_SIZE * 2;
+
+	ready = false;
+	dropped = 0;
+	reported = 0;
+	unsynced = false;
+	last_write = GetTickCount();
+
+	if (!open())
+	{
+		debugMsg(DebugError, "Trace - cannot open %s", TRACE_FILE);
+		return false;
+	}
+
+	active = true;
+	debugMsg(DebugInfo, "Trace - recording to %s, file %i at %i bytes", TRACE_FILE,
+			 sequence, offsets[filling] + fill);
+	return true;
+}
+
+void Trace::end()
+{
+	if (!active)
+		return;
+
+	flush();
+	f_close(&file);
+	active = false;
+}
+
+// Opens trace.bin and continues it, or starts a new one if it can't be
+// continued. The last partial block is read back to be completed.
+bool Trace::open()
+{
+	TraceHeader header;
+	UINT br;
+
+	if (f_open(&file, TRACE_FILE, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK)
+		return false;
+
+	uint32_t size = f_size(&file);
+	filling = 0;
+
+	if (size >= sizeof(header) &&
+		f_read(&file, &header, sizeof(header), &br) == FR_OK && br == sizeof(header) &&
+		header.magic == TRACE_MAGIC &&
+		header.version == TRACE_VERSION &&
+		header.block_size == TRACE_BLOCK_SIZE)
+	{
+		uint32_t offset = size - (size % TRACE_BLOCK_SIZE);
+		uint32_t partial = size - offset;
+
+		sequence = header.sequence;
+		file_sequence = header.sequence;
+
+		// Already full, the next block goes to a new file
+		if (offset >= max_size)
+		{
+			startBlock(0, 0);
+			return true;
+		}
+
+		startBlock(0, offset);
+
+		if (partial)
+		{
+			if (f_lseek(&file, offset) != FR_OK ||
+				f_read(&file, blocks[0], partial, &br) != FR_OK || br != partial)
+			{
+				f_close(&file);
+				return false;
+			}
+
+			fill = partial;
+			written = partial;
+		}
+
+		return true;
+	}
+
+	// Empty, or written by another version
+	f_close(&file);
+	if (f_open(&file, TRACE_FILE, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+		return false;
+
+	sequence = 0;
+	startBlock(0, 0);
+	file_sequence = sequence;
+	return true;
+}
+
+// Replaces trace.old with the current file and starts a new one
+bool Trace::rotate(uint32_t next_sequence)
+{
+	f_close(&file);
+	f_unlink(TRACE_OLD_FILE);
+
+	if (f_rename(TRACE_FILE, TRACE_OLD_FILE) != FR_OK)
+		debugMsg(DebugWarning, "Trace - cannot rename %s", TRACE_FILE);
+
+	if (f_open(&file, TRACE_FILE, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+		return false;
+
+	file_sequence = next_sequence;
+	return true;
+}
+
+void Trace::startBlock(uint8_t block, uint32_t offset)
+{
+	offsets[block] = offset;
+	fill = 0;
+	written = 0;
+
+	// The first block of a file starts with the header
+	if (offset == 0)
+	{
+		TraceHeader* header = (TraceHeader*) blocks[block];
+		header->magic = TRACE_MAGIC;
+		header->version = TRACE_VERSION;
+		header->block_size = TRACE_BLOCK_SIZE;
+		header->sequence = ++sequence;
+		header->reserved = 0;
+		fill = sizeof(TraceHeader);
+	}
+}
+
+void Trace::put(uint8_t* ptr, TraceEvent event, uint8_t arg, uint16_t value, uint32_t data)
+{
+	TraceRecord* rec = (TraceRecord*) ptr;
+
+	rec->time = GetTickCount();
+	rec->event = event;
+	rec->arg = arg;
+	rec->value = value;
+	rec->data = data;
+}
+
+// Space for a record in the filling block. When it doesn't fit, the block
+// is handed to poll() and the other one is started, unless it's still
+// waiting to be written.
+uint8_t* Trace::reserve(uint32_t size)
+{
+	if (fill + size > TRACE_BLOCK_SIZE)
+	{
+		if (ready)
+		{
+			dropped++;
+			return NULL;
+		}
+
+		uint32_t next = offsets[filling] + TRACE_BLOCK_SIZE;
+
+		memset(&blocks[filling][fill], 0, TRACE_BLOCK_SIZE - fill);
+		ready = true;
+		filling ^= 1;
+		startBlock(filling, (next < max_size) ? next : 0);
+
+		if (dropped != reported)
+		{
+			put(&blocks[filling][fill], TraceDropped, 0, 0, dropped);
+			fill += sizeof(TraceRecord);
+			reported = dropped;
+		}
+	}
+
+	uint8_t* ptr = &blocks[filling][fill];
+	fill += size;
+	return ptr;
+}
+
+void Trace::record(TraceEvent event, uint8_t arg, uint16_t value, uint32_t data)
+{
+	if (!active)
+		return;
+
+	uint8_t* ptr = reserve(sizeof(TraceRecord));
+	if (ptr)
+		put(ptr, event, arg, value, data);
+}
+
+void Trace::recordName(TraceEvent event, uint8_t arg, uint32_t data, const char* name)
+{
+	if (!active)
+		return;
+
+	uint32_t len = name ? strnlen(name, TRACE_MAX_NAME) : 0;
+	uint32_t padded = (len + 3) & ~3;
+
+	uint8_t* ptr = reserve(sizeof(TraceRecord) + padded);
+	if (!ptr)
+		return;
+
+	put(ptr, event, arg, len, data);
+	ptr += sizeof(TraceRecord);
+	memcpy(ptr, name, len);
+	memset(ptr + len, 0, padded - len);
+}
+
+bool Trace::writeBlock(uint8_t block, uint32_t len)
+{
+	UINT bw;
+
+	// A block with a newer header than the open file starts the next one
+	if (offsets[block] == 0 &&
+		((TraceHeader*) blocks[block])->sequence != file_sequence &&
+		!rotate(((TraceHeader*) blocks[block])->sequence))
+	{
+		debugMsg(DebugError, "Trace - cannot create %s, stopped", TRACE_FILE);
+		active = false;
+		return false;
+	}
+
+	if (f_lseek(&file, offsets[block]) != FR_OK ||
+		f_write(&file, blocks[block], len, &bw) != FR_OK || bw != len)
+	{
+		debugMsg(DebugError, "Trace - cannot write %s, stopped", TRACE_FILE);
+		f_close(&file);
+		active = false;
+		return false;
+	}
+
+	unsynced = true;
+	last_write = GetTickCount();
+	return true;
+}
+
+void Trace::poll(bool busy)
+{
+	if (!active)
+		return;
+
+	if (ready)
+	{
+		if (!writeBlock(filling ^ 1, TRACE_BLOCK_SIZE))
+			return;
+
+		ready = false;
+	}
+
+	if (!busy && GetTickCount() - last_write >= TRACE_IDLE_FLUSH)
+		flush();
+}
+
+void Trace::flush()
+{
+	if (!active)
+		return;
+
+	if (ready)
+	{
+		if (!writeBlock(filling ^ 1, TRACE_BLOCK_SIZE))
+			return;
+
+		ready = false;
+	}
+
+	if (fill > written)
+	{
+		if (!writeBlock(filling, fill))
+			return;
+
+		written = fill;
+	}
+
+	if (unsynced)
+	{
+		f_sync(&file);
+		unsynced = false;
+	}
+}
@@ -0,0 +1,160 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Trace.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <Arduino.h>
+#include <ff.h>
+
+// Bytes written to the card at once, a multiple of the sector size
+#define TRACE_BLOCK_SIZE		2048
+
+#define TRACE_FILE				"trace.bin"
+#define TRACE_OLD_FILE			"trace.old"
+
+#define TRACE_MAGIC				0x54455457		// "WTET"
+#define TRACE_VERSION			1
+
+// A block that isn't full is written after this many
+// milliseconds without audio, so it's on the card if
+// the board is reset or loses power
+#define TRACE_IDLE_FLUSH		2000
+
+// Longest file name kept by a play record
+#define TRACE_MAX_NAME			64
+
+typedef enum
+{
+	TracePadding,				// Rest of the block is unused
+	TraceStart,					// arg: mode, value: version major.minor, data: version fix
+	TraceInput,					// value: changed pins, data: debounced levels
+	TraceLatch,					// value: latched number
+	TracePlay,					// arg: channel, value: name length, data: play mode.
+	TracePlayError,				// The name follows, padded to 4 bytes
+	TracePlayer,				// arg: channel, value: player status
+	TraceUnderrun,				// arg: channel, data: underruns so far
+	TraceCommand,				// arg: serial command, value: data length
+	TraceError,					// arg: serial error code
+	TraceReload,				// arg: reload flags, value: rebuilt pins
+	TraceLowPower,
+	TraceSuspend,
+	TraceWake,
+	TraceDropped,				// data: records lost so far while the card was behind
+} TraceEvent;
+
+struct TraceRecord
+{
+	uint32_t time;				// GetTickCount()
+	uint8_t event;
+	uint8_t arg;
+	uint16_t value;
+	uint32_t data;
+};
+
+// At the start of every file
+struct TraceHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t block_size;
+	uint32_t sequence;			// Incremented on every new file
+	uint32_t reserved;
+};
+
+/*
+ * Event recorder for post-mortem analysis. Records of input changes, player
+ * states, serial commands and errors are appended to trace.bin on the SD
+ * card, to be turned into a timeline on the PC with tools/wtetrace.
+ *
+ * Records are collected in two blocks of TRACE_BLOCK_SIZE bytes. A full
+ * block is written from poll(), which runs after the players topped up
+ * their buffers, so the card is only written in large chunks and never
+ * while a voice is waiting for data. If the second block fills up before
+ * the first one is written, records are dropped and counted. Records never
+ * cross a block, the unused end of a block is zeroed.
+ *
+ * Once trace.bin reaches the configured size it is renamed to trace.old,
+ * replacing the previous one, and a new trace.bin is started. After a reset
+ * the recorder appends to the existing file.
+ *
+ * Everything here runs in the main loop, not from interrupts.
+ */
+class Trace
+{
+public:
+	static Trace& getInstance()
+	{
+		static Trace instance;
+		return instance;
+	}
+
+	bool begin(uint32_t max_size);
+	void end();
+
+	void record(TraceEvent event, uint8_t arg = 0, uint16_t value = 0, uint32_t data = 0);
+	void recordName(TraceEvent event, uint8_t arg, uint32_t data, const char* name);
+
+	// Writes the full block, or the partial one after TRACE_IDLE_FLUSH
+	// milliseconds if 'busy' is false
+	void poll(bool busy);
+
+	// Writes everything now, before sleeping
+	void flush();
+
+	inline bool enabled() { return active; }
+	inline uint32_t getDropped() { return dropped; }
+
+private:
+	Trace() : active(false), file_sequence(0), filling(0), fill(0), ready(false), written(0),
+			  max_size(0), sequence(0), dropped(0), reported(0), unsynced(false), last_write(0) {}
+
+	bool open();
+	bool rotate(uint32_t next_sequence);
+	void startBlock(uint8_t block, uint32_t offset);
+	uint8_t* reserve(uint32_t size);
+	bool writeBlock(uint8_t block, uint32_t len);
+
+	static void put(uint8_t* ptr, TraceEvent event, uint8_t arg, uint16_t value, uint32_t data);
+
+	FIL file;
+	bool active;
+	uint32_t file_sequence;		// Of the open file
+
+	uint8_t blocks[2][TRACE_BLOCK_SIZE] __attribute__((aligned(4)));
+	uint32_t offsets[2];		// Of each block in the file
+	uint8_t filling;			// Block taking new records
+	uint32_t fill;
+	bool ready;					// The other block is full and not written yet
+	uint32_t written;			// Bytes of the filling block already on the card
+
+	uint32_t max_size;
+	uint32_t sequence;
+	uint32_t dropped;
+	uint32_t reported;			// Dropped records already in the trace
+	bool unsynced;
+	uint32_t last_write;
+};
+
+#endif /* __TRACE_H__ */
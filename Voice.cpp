@@ -0,0 +1,493 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Voice.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "Voice.h"
+#include "Mixer.h"
+#include "Debug.h"
+
+#define VOICE_BUFFER_MASK	(VOICE_BUFFER_SIZE - 1)
+
+uint32_t Voice::output_rate = 0;
+ResamplerMode Voice::resampler_mode = ResamplerOff;
+uint32_t Voice::read_histogram[VOICE_READ_BUCKETS];
+uint32_t Voice::read_max = 0;
+
+static const uint32_t read_bucket_limits[VOICE_READ_BUCKETS - 1] =
+{
+	250, 500, 1000, 2000, 5000, 10000, 20000
+};
+
+Voice::Voice() :
+	file_open(false), play_mode(PlayModeNormal), unit_bytes(0), file_remaining(0),
+	eof(false), finished(false), status(AudioSourceStopped), resampling(false),
+	base_step(RESAMPLER_UNITY_STEP), rate(RESAMPLER_UNITY_STEP), rate_changed(false),
+	compressed(false), block_frame(0),
+	target_gain(MIXER_UNITY_GAIN), ramp_step(VOICE_RAMP_STEP), gain(MIXER_UNITY_GAIN), group(0), rd_pos(0), wr_pos(0),
+	underruns(0), min_fill(VOICE_BUFFER_SIZE), starved(false)
+{
+	memset(&info, 0, sizeof(info));
+}
+
+void Voice::resetStats()
+{
+	underruns = 0;
+	min_fill = VOICE_BUFFER_SIZE;
+}
+
+// Upper limit of a bucket in microseconds, open-ended for the last one
+uint32_t Voice::getReadBucketLimit(uint8_t bucket)
+{
+	return (bucket < VOICE_READ_BUCKETS - 1) ? read_bucket_limits[bucket] : 0xFFFFFFFF;
+}
+
+void Voice::resetReadStats()
+{
+	memset(read_histogram, 0, sizeof(read_histogram));
+	read_max = 0;
+}
+
+void Voice::setOutput(uint32_t sample_rate, ResamplerMode mode)
+{
+	output_rate = sample_rate;
+	resampler_mode = mode;
+
+	if (mode == ResamplerPolyphase)
+		Resampler::initialize();
+}
+
+bool Voice::play(const char* filename, PlayMode mode, const WavInfo* header)
+{
+	stop();
+
+	if (!filename || f_open(&file, filename, FA_READ) != FR_OK)
+		return false;
+
+	if (header)
+	{
+		info = *header;
+		if (f_lseek(&file, info.data_offset) != FR_OK)
+		{
+			f_close(&file);
+			return false;
+		}
+	} else if (!wavReadHeader(&file, &info) || !wavIsSupported(&info))
+	{
+		f_close(&file);
+		return false;
+	}
+
+	compressed = (info.format == WAVE_FORMAT_IMA_ADPCM);
+
+	if (compressed)
+	{
+		if (VOICE_BUFFER_SIZE % info.block_align || info.block_align > VOICE_BUFFER_SIZE / 2 ||
+			!adpcm.begin(info.channels, info.block_align, info.samples_per_block))
+		{
+			f_close(&file);
+			return false;
+		}
+
+		unit_bytes = info.block_align;
+		block_frame = 0;
+	} else {
+		unit_bytes = info.channels * (info.bits_per_sample / 8);
+	}
+
+	file_open = true;
+	play_mode = mode;
+	file_remaining = info.data_size - (info.data_size % unit_bytes);
+	rd_pos = 0;
+	wr_pos = 0;
+	eof = false;
+	finished = false;
+
+	// Input frames per output frame at normal speed
+	base_step = RESAMPLER_UNITY_STEP;
+	if (resampler_mode != ResamplerOff && output_rate)
+		base_step = (uint32_t) (((uint64_t) info.sample_rate << RESAMPLER_STEP_SHIFT) / output_rate);
+
+	resampling = false;
+	rate_changed = false;
+	updateStep();
+
+	// Preload enough audio so the mixer doesn't starve before the next
+	// poll() comes. Compressed files need proportionally less data.
+	uint32_t byte_rate = compressed ?
+			(info.sample_rate * info.block_align) / adpcm.getSamplesPerBlock() :
+			info.sample_rate * unit_bytes;
+
+	uint32_t preload = (((uint64_t) byte_rate * rate) >> RESAMPLER_STEP_SHIFT) * VOICE_PRELOAD_MS / 1000;
+	preload = (preload + VOICE_READ_CHUNK - 1) & ~(VOICE_READ_CHUNK - 1);
+	if (preload < unit_bytes)
+		preload = unit_bytes;
+
+	if (preload > VOICE_BUFFER_SIZE / 2)
+		preload = VOICE_BUFFER_SIZE / 2;
+
+	while (!eof && wr_pos < preload)
+	{
+		uint32_t last = wr_pos;
+		fill();
+		if (wr_pos == last)
+			break;
+	}
+
+	if (wr_pos == 0)
+	{
+		stop();
+		return false;
+	}
+
+	gain = target_gain;
+	status = AudioSourcePlaying;
+	return true;
+}
+
+void Voice::stop()
+{
+	status = AudioSourceStopped;
+
+	if (file_open)
+	{
+		f_close(&file);
+		file_open = false;
+	}
+}
+
+void Voice::pause()
+{
+	if (status == AudioSourcePlaying)
+		status = AudioSourcePaused;
+}
+
+void Voice::resume()
+{
+	if (status == AudioSourcePaused)
+		status = AudioSourcePlaying;
+}
+
+void Voice::setVolume(float volume, int16_t ramp_step)
+{
+	this->ramp_step = ramp_step;
+	target_gain = mixerGain(volume);
+}
+
+float Voice::getVolume()
+{
+	return (float) gain / MIXER_UNITY_GAIN;
+}
+
+void Voice::setRate(float value)
+{
+	if (value < VOICE_MIN_RATE)
+		value = VOICE_MIN_RATE;
+	else if (value > VOICE_MAX_RATE)
+		value = VOICE_MAX_RATE;
+
+	rate = (uint32_t) (value * RESAMPLER_UNITY_STEP + 0.5f);
+	rate_changed = true;
+}
+
+float Voice::getRate()
+{
+	return (float) rate / RESAMPLER_UNITY_STEP;
+}
+
+// Applies the playback rate on top of the sample rate conversion. Called
+// by play() and, once the voice is playing, from the audio interrupt.
+void Voice::updateStep()
+{
+	uint32_t step = (uint32_t) (((uint64_t) base_step * rate) >> RESAMPLER_STEP_SHIFT);
+
+	if (resampling)
+	{
+		resampler.setStep(step);
+		return;
+	}
+
+	if (step == RESAMPLER_UNITY_STEP)
+		return;
+
+	// Rate changes always need interpolation, even with SRC disabled
+	resampler.reset((resampler_mode == ResamplerOff) ? ResamplerLinear : resampler_mode, step);
+	resampling = true;
+}
+
+AudioSourceStatus Voice::getStatus()
+{
+	if (finished)
+		return AudioSourceStopped;
+
+	return status;
+}
+
+void Voice::poll()
+{
+	if (status == AudioSourceStopped)
+		return;
+
+	// The mixer has consumed the last sample
+	if (finished)
+	{
+		stop();
+		return;
+	}
+
+	// Read ahead as fast as the voice consumes the file
+	uint32_t reads = (rate + RESAMPLER_UNITY_STEP - 1) >> RESAMPLER_STEP_SHIFT;
+	while (reads--)
+		fill();
+}
+
+void Voice::fill()
+{
+	uint32_t free_space = VOICE_BUFFER_SIZE - (wr_pos - rd_pos);
+	uint32_t offset = wr_pos & VOICE_BUFFER_MASK;
+	uint32_t len;
+	UINT br;
+
+	if (eof || free_space < VOICE_READ_CHUNK)
+		return;
+
+	// Read up to the end of the ring, then keep file reads
+	// sector aligned so FatFs can transfer directly into the buffer
+	len = VOICE_BUFFER_SIZE - offset;
+	if (len > free_space)
+		len = free_space;
+
+	uint32_t misalign = f_tell(&file) % VOICE_READ_CHUNK;
+	if (misalign && len > VOICE_READ_CHUNK - misalign)
+		len = VOICE_READ_CHUNK - misalign;
+
+	if (len > file_remaining)
+		len = file_remaining;
+
+	uint32_t start = micros();
+	FRESULT res = f_read(&file, &buffer[offset], len, &br);
+	uint32_t elapsed = micros() - start;
+
+	uint8_t bucket = 0;
+	while (bucket < VOICE_READ_BUCKETS - 1 && elapsed >= read_bucket_limits[bucket])
+		bucket++;
+
+	read_histogram[bucket]++;
+	if (elapsed > read_max)
+		read_max = elapsed;
+
+	if (elapsed >= VOICE_SLOW_READ_US)
+		debugMsg(DebugWarning, "Slow SD read, %i bytes in %i us", len, elapsed);
+
+	if (res != FR_OK || !br)
+	{
+		eof = true;
+		return;
+	}
+
+	wr_pos += br;
+	file_remaining -= br;
+
+	if (!file_remaining)
+	{
+		if (play_mode == PlayModeLoop &&
+			f_lseek(&file, info.data_offset) == FR_OK)
+		{
+			file_remaining = info.data_size - (info.data_size % unit_bytes);
+		} else {
+			eof = true;
+		}
+	}
+}
+
+int16_t Voice::nextGain()
+{
+	int16_t target = target_gain;
+	int16_t step = ramp_step;
+
+	if (gain < target)
+		gain = (target - gain > step) ? gain + step : target;
+	else if (gain > target)
+		gain = (gain - target > step) ? gain - step : target;
+
+	return gain;
+}
+
+// Renders 'frames' frames of interleaved 16-bit stereo at the output
+// rate. Returns the amount of frames that came from the file.
+uint32_t Voice::render(int16_t* out, uint32_t frames)
+{
+	// Once the file is all read the buffer empties as it should
+	if (!eof)
+	{
+		uint32_t fill = wr_pos - rd_pos;
+		if (fill < min_fill)
+			min_fill = fill;
+	}
+
+	if (rate_changed)
+	{
+		rate_changed = false;
+		updateStep();
+	}
+
+	// The resampler reads in chunks, a block that runs out of data
+	// is counted once however many of them come up short
+	starved = false;
+
+	uint32_t rendered = 0;
+
+	if (!resampling)
+	{
+		rendered = readFrames(out, frames);
+		frames = 0;
+	}
+
+	while (frames)
+	{
+		uint32_t chunk = (frames > RESAMPLER_CHUNK) ? RESAMPLER_CHUNK : frames;
+		int16_t* input;
+		uint32_t needed = resampler.prepare(chunk, &input);
+		uint32_t read = readFrames(input, needed);
+
+		resampler.process(out, chunk);
+		rendered += (read == needed) ? chunk : (chunk * read) / needed;
+
+		out += chunk * 2;
+		frames -= chunk;
+	}
+
+	if (starved)
+		underruns++;
+
+	return rendered;
+}
+
+// Converts up to 'frames' frames from the ring buffer into interleaved
+// 16-bit stereo. The remaining of 'out' is filled with silence if there
+// isn't enough data available. Returns the amount of frames converted.
+uint32_t Voice::readFrames(int16_t* out, uint32_t frames)
+{
+	if (compressed)
+		return readAdpcmFrames(out, frames);
+
+	uint32_t rd = rd_pos;
+	uint32_t available = (wr_pos - rd) / unit_bytes;
+	uint32_t count = (frames < available) ? frames : available;
+	uint32_t remaining = count;
+
+	while (remaining)
+	{
+		// Frames never straddle the end of the ring
+		uint32_t offset = rd & VOICE_BUFFER_MASK;
+		uint32_t segment = (VOICE_BUFFER_SIZE - offset) / unit_bytes;
+		if (segment > remaining)
+			segment = remaining;
+
+		const uint8_t* src = &buffer[offset];
+
+		if (info.bits_per_sample == 16)
+		{
+			if (info.channels == 2)
+			{
+				memcpy(out, src, segment * 4);
+				out += segment * 2;
+			} else {
+				const int16_t* s = (const int16_t*) src;
+				for (uint32_t i = 0; i < segment; i++)
+				{
+					*out++ = s[i];
+					*out++ = s[i];
+				}
+			}
+		} else {
+			if (info.channels == 2)
+			{
+				for (uint32_t i = 0; i < segment * 2; i++)
+					*out++ = (int16_t) ((src[i] - 128) << 8);
+			} else {
+				for (uint32_t i = 0; i < segment; i++)
+				{
+					int16_t s = (int16_t) ((src[i] - 128) << 8);
+					*out++ = s;
+					*out++ = s;
+				}
+			}
+		}
+
+		rd += segment * unit_bytes;
+		remaining -= segment;
+	}
+
+	rd_pos = rd;
+
+	if (count < frames)
+	{
+		memset(out, 0, (frames - count) * 2 * sizeof(int16_t));
+
+		if (eof)
+			finished = true;
+		else
+			starved = true;
+	}
+
+	return count;
+}
+
+// Decodes ADPCM frames straight out of the ring buffer. A block is
+// released to the file side only once all of its frames are decoded.
+uint32_t Voice::readAdpcmFrames(int16_t* out, uint32_t frames)
+{
+	uint32_t samples_per_block = adpcm.getSamplesPerBlock();
+	uint32_t count = 0;
+
+	while (count < frames)
+	{
+		if (block_frame == samples_per_block)
+		{
+			rd_pos += unit_bytes;
+			block_frame = 0;
+		}
+
+		if (wr_pos - rd_pos < unit_bytes)
+			break;
+
+		uint32_t n = samples_per_block - block_frame;
+		if (n > frames - count)
+			n = frames - count;
+
+		adpcm.decode(&buffer[rd_pos & VOICE_BUFFER_MASK], block_frame, out, n);
+		block_frame += n;
+		out += n * 2;
+		count += n;
+	}
+
+	if (count < frames)
+	{
+		memset(out, 0, (frames - count) * 2 * sizeof(int16_t));
+
+		if (eof)
+			finished = true;
+		else
+			starved = true;
+	}
+
+	return count;
+}
@@ -0,0 +1,160 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Voice.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __VOICE_H__
+#define __VOICE_H__
+
+#include <Arduino.h>
+#include <ff.h>
+#include "WavFile.h"
+#include "Resampler.h"
+#include "ImaAdpcm.h"
+
+// Size of the RAM ring every voice streams its file into. Must be a
+// power of two and a multiple of VOICE_READ_CHUNK.
+#define VOICE_BUFFER_SIZE		4096
+#define VOICE_READ_CHUNK		512
+
+// Audio preloaded when a file is opened, in milliseconds
+#define VOICE_PRELOAD_MS		12
+
+// Playback rate limits
+#define VOICE_MIN_RATE			0.25f
+#define VOICE_MAX_RATE			4.0f
+
+// Gain step applied every mixer block when ramping the volume
+#define VOICE_RAMP_STEP			256
+#define VOICE_FAST_RAMP_STEP	1024
+
+// SD read times are counted in buckets up to these many microseconds,
+// the last one takes the slower reads. Reads slower than
+// VOICE_SLOW_READ_US are also reported in the debug log.
+#define VOICE_READ_BUCKETS		8
+#define VOICE_SLOW_READ_US		10000
+
+class Voice
+{
+	/*
+	 * A voice streams a WAV file from the SD card into a RAM ring buffer.
+	 * The file side (play(), stop(), poll()) runs in the main loop,
+	 * while render() and nextGain() are called by the mixer from the
+	 * audio interrupt. The ring buffer indexes are only written by one
+	 * side each, so no locking is needed between the two.
+	 *
+	 * Files whose sample rate doesn't match the output rate go through
+	 * a resampler, selected when the file is opened. The same resampler
+	 * changes the playback rate (speed and pitch) of the voice.
+	 *
+	 * IMA ADPCM files are kept compressed in the ring buffer and decoded
+	 * by the mixer, so the same buffer holds four times more audio. Their
+	 * block size must divide VOICE_BUFFER_SIZE, so blocks never wrap, and
+	 * be at most half of it.
+	 *
+	 * play() can take the header of the file, parsed beforehand with
+	 * wavReadHeader(), so it only has to open the file and seek to the
+	 * audio data.
+	*/
+
+public:
+	Voice();
+
+	static void setOutput(uint32_t sample_rate, ResamplerMode mode);
+
+	bool play(const char* filename, PlayMode mode = PlayModeNormal, const WavInfo* header = NULL);
+	void stop();
+	void pause();
+	void resume();
+	void poll();
+
+	void setVolume(float volume, int16_t ramp_step = VOICE_RAMP_STEP);
+	float getVolume();
+	void setRate(float rate);
+	float getRate();
+	inline void setGroup(uint8_t group) { this->group = group; }
+	inline uint8_t getGroup() { return group; }
+	AudioSourceStatus getStatus();
+
+	// Times the mixer ran out of data before the whole file was read, and
+	// the lowest amount of bytes that were waiting in the buffer for it
+	inline uint32_t getUnderruns() { return underruns; }
+	inline uint32_t getMinFill() { return min_fill; }
+	void resetStats();
+
+	// Shared by every voice
+	static uint32_t getReadBucketLimit(uint8_t bucket);
+	static inline uint32_t getReadCount(uint8_t bucket) { return (bucket < VOICE_READ_BUCKETS) ? read_histogram[bucket] : 0; }
+	static inline uint32_t getReadMax() { return read_max; }
+	static void resetReadStats();
+
+	// Audio context
+	inline bool isMixing() { return status == AudioSourcePlaying && !finished; }
+	int16_t nextGain();
+	uint32_t render(int16_t* out, uint32_t frames);
+
+private:
+	void fill();
+	uint32_t readFrames(int16_t* out, uint32_t frames);
+	uint32_t readAdpcmFrames(int16_t* out, uint32_t frames);
+	void updateStep();
+
+	static uint32_t output_rate;
+	static ResamplerMode resampler_mode;
+	static uint32_t read_histogram[VOICE_READ_BUCKETS];
+	static uint32_t read_max;
+
+	FIL file;
+	bool file_open;
+	WavInfo info;
+	PlayMode play_mode;
+	// Bytes of the smallest decodable unit: a frame for PCM, a block for ADPCM
+	uint32_t unit_bytes;
+	uint32_t file_remaining;
+	volatile bool eof;
+	volatile bool finished;
+	volatile AudioSourceStatus status;
+
+	bool resampling;
+	Resampler resampler;
+	uint32_t base_step;
+	volatile uint32_t rate;
+	volatile bool rate_changed;
+
+	bool compressed;
+	ImaAdpcmDecoder adpcm;
+	uint32_t block_frame;
+
+	volatile int16_t target_gain;
+	volatile int16_t ramp_step;
+	int16_t gain;
+	volatile uint8_t group;
+
+	volatile uint32_t rd_pos;
+	volatile uint32_t wr_pos;
+
+	volatile uint32_t underruns;
+	volatile uint32_t min_fill;
+	// Set by the reads of a render() that ran out of data
+	bool starved;
+	uint8_t buffer[VOICE_BUFFER_SIZE] __attribute__((aligned(4)));
+};
+
+#endif /* __VOICE_H__ */
@@ -0,0 +1,128 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### WavFile.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "WavFile.h"
+
+static inline uint16_t readLE16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t readLE32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// Walks the RIFF chunks of a WAV file, filling 'info' with the format
+// description and the position/size of the 'data' chunk. On success the
+// file pointer is left at the beginning of the audio data.
+bool wavReadHeader(FIL* file, WavInfo* info)
+{
+	uint8_t hdr[40];
+	UINT br;
+	bool fmt_found = false;
+	uint32_t offset;
+
+	if (!file || !info)
+		return false;
+
+	memset(info, 0, sizeof(WavInfo));
+
+	if (f_lseek(file, 0) != FR_OK)
+		return false;
+
+	if (f_read(file, hdr, 12, &br) != FR_OK || br != 12)
+		return false;
+
+	if (memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0)
+		return false;
+
+	offset = 12;
+
+	while (true)
+	{
+		if (f_read(file, hdr, 8, &br) != FR_OK || br != 8)
+			return false;
+
+		uint32_t chunk_size = readLE32(hdr + 4);
+		offset += 8;
+
+		if (memcmp(hdr, "fmt ", 4) == 0)
+		{
+			uint32_t len = chunk_size > sizeof(hdr) ? sizeof(hdr) : chunk_size;
+			if (len < 16)
+				return false;
+
+			if (f_read(file, hdr, len, &br) != FR_OK || br != len)
+				return false;
+
+			info->format = readLE16(hdr);
+			info->channels = readLE16(hdr + 2);
+			info->sample_rate = readLE32(hdr + 4);
+			info->block_align = readLE16(hdr + 12);
+			info->bits_per_sample = readLE16(hdr + 14);
+
+			// Extended format, only meaningful for ADPCM
+			if (len >= 20)
+				info->samples_per_block = readLE16(hdr + 18);
+
+			// WAVE_FORMAT_EXTENSIBLE carries the real format tag
+			// in the first two bytes of the sub-format GUID
+			if (info->format == WAVE_FORMAT_EXTENSIBLE && len >= 26)
+				info->format = readLE16(hdr + 24);
+
+			fmt_found = true;
+		} else if (memcmp(hdr, "data", 4) == 0)
+		{
+			if (!fmt_found)
+				return false;
+
+			info->data_offset = offset;
+			info->data_size = chunk_size;
+
+			// Some writers leave a bogus size on the last chunk
+			if (info->data_offset + info->data_size > f_size(file))
+				info->data_size = f_size(file) - info->data_offset;
+
+			return f_lseek(file, info->data_offset) == FR_OK;
+		}
+
+		// Chunks are word aligned
+		offset += chunk_size + (chunk_size & 1);
+		if (f_lseek(file, offset) != FR_OK || offset >= f_size(file))
+			return false;
+	}
+}
+
+bool wavIsSupported(const WavInfo* info)
+{
+	if (info->channels < 1 || info->channels > 2)
+		return false;
+
+	if (info->format == WAVE_FORMAT_PCM)
+		return info->bits_per_sample == 8 || info->bits_per_sample == 16;
+
+	if (info->format == WAVE_FORMAT_IMA_ADPCM)
+		return info->bits_per_sample == 4 && info->block_align > 4 * info->channels;
+
+	return false;
+}
@@ -0,0 +1,48 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### WavFile.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __WAVFILE_H__
+#define __WAVFILE_H__
+
+#include <Arduino.h>
+#include <ff.h>
+#include "ImaAdpcm.h"
+
+#define WAVE_FORMAT_PCM			0x0001
+#define WAVE_FORMAT_EXTENSIBLE	0xFFFE
+
+typedef struct
+{
+	uint16_t format;
+	uint16_t channels;
+	uint32_t sample_rate;
+	uint16_t block_align;
+	uint16_t bits_per_sample;
+	uint16_t samples_per_block;
+	uint32_t data_offset;
+	uint32_t data_size;
+} WavInfo;
+
+bool wavReadHeader(FIL* file, WavInfo* info);
+bool wavIsSupported(const WavInfo* info);
+
+#endif /* __WAVFILE_H__ */
@@ -0,0 +1,133 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### WavIndex.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#include "WavIndex.h"
+#include "Debug.h"
+#include <ff.h>
+#include <strings.h>
+
+// Accepts names made of a number (no leading zeros, as it would be
+// built with "%i.wav") followed by the .wav extension
+bool WavIndex::parseName(const char* name, uint32_t* num)
+{
+	uint32_t value = 0;
+	const char* p = name;
+
+	if (*p == '0' && p[1] != '.')
+		return false;
+
+	while (*p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p - '0');
+		if (value > WAV_INDEX_MAX_NUM)
+			return false;
+		p++;
+	}
+
+	if (p == name || strcasecmp(p, ".wav") != 0)
+		return false;
+
+	*num = value;
+	return true;
+}
+
+bool WavIndex::build()
+{
+	DIR dir;
+	FILINFO info;
+	uint32_t num;
+	uint32_t found = 0;
+	uint32_t highest = 0;
+	DEBUG_CONTEXT(uint32_t start = GetTickCount());
+
+	clear();
+
+	// First pass: count the files and find the highest number
+	if (f_opendir(&dir, "") != FR_OK)
+		return false;
+
+	while (f_readdir(&dir, &info) == FR_OK && info.fname[0])
+	{
+		if (info.fattrib & AM_DIR || !parseName(info.fname, &num))
+			continue;
+
+		found++;
+		if (num > highest)
+			highest = num;
+	}
+
+	f_closedir(&dir);
+
+	uint32_t words = (highest >> 5) + 1;
+	bitmap = new uint32_t[words];
+
+	if (!bitmap)
+	{
+		clear();
+		debugMsg(DebugError, "WAV index: not enough memory");
+		return false;
+	}
+
+	memset(bitmap, 0, words * sizeof(uint32_t));
+
+	// Second pass: mark the files
+	uint32_t n = 0;
+	if (f_opendir(&dir, "") == FR_OK)
+	{
+		while (n < found && f_readdir(&dir, &info) == FR_OK && info.fname[0])
+		{
+			if (info.fattrib & AM_DIR || !parseName(info.fname, &num) || num > highest)
+				continue;
+
+			bitmap[num >> 5] |= (1UL << (num & 31));
+			n++;
+		}
+
+		f_closedir(&dir);
+	}
+
+	max_num = highest;
+	count = n;
+	built = true;
+
+	debugMsg(DebugInfo, "WAV index: %i files (highest %i.wav), %i bytes, %i ms",
+			 count, max_num, getMemoryUsage(), GetTickCount() - start);
+	return true;
+}
+
+void WavIndex::clear()
+{
+	built = false;
+	delete[] bitmap;
+	bitmap = NULL;
+	max_num = 0;
+	count = 0;
+}
+
+uint32_t WavIndex::getMemoryUsage()
+{
+	if (!built)
+		return 0;
+
+	return ((max_num >> 5) + 1) * sizeof(uint32_t);
+}
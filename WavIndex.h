@@ -0,0 +1,75 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### WavIndex.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+#ifndef __WAVINDEX_H__
+#define __WAVINDEX_H__
+
+#include <Arduino.h>
+
+// Highest number that can be indexed (65535.wav)
+#define WAV_INDEX_MAX_NUM		0xFFFF
+
+// Index of the numbered WAV files (N.wav) in the root directory, built once
+// at boot. A bitmap tells whether a number exists, so lookups don't touch
+// the card.
+class WavIndex
+{
+public:
+	static WavIndex& getInstance()
+	{
+		static WavIndex instance;
+		return instance;
+	}
+
+	bool build();
+	void clear();
+
+	// If the index was not built every number is reported as present,
+	// so the file system has the last word.
+	inline bool exists(uint32_t num)
+	{
+		if (!built)
+			return true;
+
+		if (num > max_num)
+			return false;
+
+		return (bitmap[num >> 5] & (1UL << (num & 31))) != 0;
+	}
+
+	inline bool isBuilt() { return built; }
+	inline uint32_t getCount() { return count; }
+	uint32_t getMemoryUsage();
+
+private:
+	WavIndex() : bitmap(NULL), max_num(0), count(0), built(false) {}
+
+	static bool parseName(const char* name, uint32_t* num);
+
+	uint32_t* bitmap;
+	uint32_t max_num;
+	uint32_t count;
+	bool built;
+};
+
+#endif /* __WAVINDEX_H__ */
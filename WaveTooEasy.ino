@@ -23,45 +23,51 @@
 #include <Arduino.h>
 #include "Debug.h"
 #include "IoPin.h"
-#include "PropConfig.h"
 #include "lm49450.h"
 #include "Led.h"
 #include "SerialProtocol.h"
 #include "Player.h"
+#include "Mixer.h"
+#include "InputScanner.h"
+#include "InputEvents.h"
+#include "LatchedVoices.h"
+#include "WavIndex.h"
+#include "PinSelector.h"
+#include "StringPool.h"
+#include "Arena.h"
+#include "Settings.h"
+#include "BootProfile.h"
+#include "ClockGovernor.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include "version.h"
 #include "TimeCounter.h"
 #include <strings.h>
 #include <ctype.h>
 
-#define IO_PINS_COUNT		16
-#define MODE_IO				1
-#define MODE_LATCHED		2
-#define MODE_SERIAL			3
-
-#define GPIOA_MASK			0x19FF
-#define GPIOB_MASK			0x600
-#define GPIOC_MASK 			0xE000
-
 // Latch
-static volatile bool latched = false;
-static volatile uint32_t latched_num;
 static Player* latch_player = NULL;
+static LatchedVoices latch_voices;
+static bool latch_polyphonic = false;
 static void latchInterrupt();
 
 // Configuration
-static PropConfig config;
-static uint32_t sample_rate;
-static float speakers_volume_db;
-static float headphone_volume_db;
-static uint8_t mode;
-static uint32_t baudrate;
-static bool disable_leds = false;
-static bool latch_in_active_low = false;
-static bool latch_io_active_low = false;
+static Settings settings;
 static uint32_t low_power_timeout;
 
+// Suspend
+static volatile bool wake_pending = false;
+static volatile uint16_t wake_levels;
+static bool wake_sound = false;
+
 // Initialization
 static bool initialized = false;
+static BootProfile& boot = BootProfile::getInstance();
+
+// Upper bound for the codec and amplifier to start, and number of sample
+// requests from the audio driver that tell they are running
+#define AUDIO_READY_TIMEOUT		500
+#define AUDIO_READY_REQUESTS	2
 
 // Serial protocol
 static SerialProtocol serial_protocol = SerialProtocol::getInstance();
@@ -73,169 +79,249 @@ static BoardLed led2(LED2);
 // Channels
 static IoPin* io_pins[IO_PINS_COUNT];
 
+// Pins polled on every loop: the ones holding a player, and the ones just
+// started. The scanner only reports changes, so a level pin that is already
+// asserted when it starts gets its first poll from here.
+static uint16_t io_busy = 0;
+static PinSelector pin_selector;
+
 // Players
 PlayersPool players = PlayersPool::getInstance();
 
 // Timers
 TimeCounter low_power_timer;
 
+// Event trace on the SD card
+static Trace& trace = Trace::getInstance();
+
 bool readConfig()
 {
-	// Set some defaults
-	sample_rate = 44100;
-	speakers_volume_db = 0;
-	headphone_volume_db = 0;
-	mode = MODE_IO;
-	baudrate = 115200;
-	disable_leds = false;
+	DEBUG_CONTEXT(uint32_t start = GetTickCount());
+	bool from_cache;
 
-	// Fixed configuration name
-	if (!config.begin("config.ini", false))
+	// Fixed configuration name. The parsed result is kept in config.bin
+	// and reused until config.ini changes.
+	if (!settingsLoadCached("config.ini", "config.bin", &settings, &from_cache))
 		return false;
 
-	char szMode[32];
-	uint32_t szModeLen = sizeof(szMode);
-	if (config.readValue("settings", "mode", szMode, &szModeLen))
-	{
-		if (strncasecmp("serial", szMode, szModeLen) == 0)
-			mode = MODE_SERIAL;
-		else if (strncasecmp("io", szMode, szModeLen) == 0)
-			mode = MODE_IO;
-		else if (strncasecmp("latch", szMode, szModeLen) == 0)
-			mode = MODE_LATCHED;
-	}
-
-	config.readValue("settings", "sample_rate", &sample_rate);
-	config.readValue("settings", "speakers_volume", &speakers_volume_db);
-	config.readValue("settings", "headphone_volume", &headphone_volume_db);
-	config.readValue("settings", "baudrate", &baudrate);
-	config.readValue("settings", "disable_leds", &disable_leds);
-	config.readValue("settings", "low_power_timeout", &low_power_timeout);
-	low_power_timeout *= 1000;
+	debugMsg(DebugInfo, "Configuration %s in %i ms", from_cache ? "loaded from config.bin" : "parsed",
+			 GetTickCount() - start);
+
+	low_power_timeout = settings.low_power_timeout * 1000;
 	return true;
 }
 
-void cleanupIoMode()
+static void startTrace()
 {
-	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	if (settings.trace)
+		trace.begin(settings.trace_size * 1024);
+	else
+		trace.end();
+}
+
+// Converts a group name (as in [groups]) or number into a group
+// number. Returns 0 (no group) if the group is not recognized.
+static uint8_t groupNumber(const Settings* from, const char* str)
+{
+	uint32_t num;
+	char* end;
+
+	if (!str || !strlen(str))
+		return 0;
+
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
 	{
-		if (io_pins[i])
-		{
-			io_pins[i]->end();
-			delete io_pins[i];
-		}
+		if (strlen(from->group_names[i]) && strcasecmp(from->group_names[i], str) == 0)
+			return i + 1;
 	}
+
+	num = strtoul(str, &end, 10);
+	if (*end || num > MIXER_MAX_GROUPS)
+	{
+		debugMsg(DebugWarning, "Unknown group %s", str);
+		return 0;
+	}
+
+	return num;
 }
 
-static void strtolower(char* str)
+static inline uint8_t parseGroup(const char* str)
 {
-	char *p = str;
+	return groupNumber(&settings, str);
+}
 
-	while (*p)
+// Sets the group of every channel, from [groups] (serial and latched modes)
+static void initializeChannelGroups()
+{
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
 	{
-		*p = tolower(*p);
-		p++;
+		if (settings.channel_groups[i][0])
+			players.get(i)->setGroup(parseGroup(settings.channel_groups[i]));
 	}
 }
 
-bool initializeIoMode()
+static void cleanupIoPin(uint8_t num)
 {
-	char io_name[32];
-	char tmp[256];
-	uint32_t str_len;
-	PinPolarity polarity;
-	PinTriggerType trigger;
-	PlayMode playback;
-	DeassertMode deassert;
-	uint32_t debounce = 20;
-	float volume;
-
-    // Initialize players list
-    players.initialize(true);
+	if (io_pins[num])
+	{
+		io_pins[num]->end();
+		Arena::destroy(io_pins[num]);
+		io_pins[num] = NULL;
+	}
+}
 
-	// Initialize every pin
+void cleanupIoMode()
+{
 	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+		cleanupIoPin(i);
+
+	pin_selector.end();
+	InputScanner::getInstance().end();
+	Arena::getInstance().reset();
+}
+
+// Starts the pins used as a binary selector in IO mode, if any
+static void initializePinSelector()
+{
+	if (!settings.selector_pins)
+		return;
+
+	pin_selector.begin(settings.selector_pins, settings.selector_active_low,
+					   settings.selector_settle, settings.selector_stop,
+					   settings.selector_polyphony, settings.selector_steal,
+					   parseGroup(settings.selector_group), settings.selector_volume);
+}
+
+// Creates and starts pin 'num' as configured. Returns false only
+// if there's no room left in the arena for it or for its files.
+static bool initializeIoPin(uint8_t num)
+{
+	char path[8];
+	PinSettings* pin = &settings.pins[num];
+	StringPool& pool = StringPool::getInstance();
+
+	if (!pin->configured || pin_selector.getMask() & (1 << num))
+		return true;
+
+	// Not the default name, the pin is left out
+	if (pin->file == STRING_POOL_FULL)
 	{
-		// Set some defaults
-		playback = PlayModeNormal;
-		polarity = PinActiveHigh;
-		trigger = LevelTrigger;
-		deassert = DeassertRestart;
-		volume = 1.0f;
-		debounce = 5;
-		memset(tmp, 0, sizeof(tmp));
-
-		sprintf(io_name, "pin%i_mode", i + 1);
-		str_len = sizeof(tmp);
-		if (config.readValue("io", io_name, tmp, &str_len))
-		{
-			strtolower(io_name);
-			if (strstr(tmp, "loop") != NULL)
-				playback = PlayModeLoop;
+		debugMsg(DebugError, "Pin %i - no room for the file name", num);
+		return true;
+	}
 
-			if (strstr(tmp, "low") != NULL)
-				polarity = PinActiveLow;
+	// The file setting can be a list of files, or a pattern
+	uint16_t file = pin->file;
+	if (file == STRING_POOL_INVALID)
+	{
+		sprintf(path, "%i.wav", num + 1);
+		file = pool.add(path);
+	}
 
-			if (strstr(tmp, "edge") != NULL)
-				trigger = EdgeTrigger;
+	if (file == STRING_POOL_INVALID)
+	{
+		debugMsg(DebugError, "Pin %i - no room for the file name", num);
+		return true;
+	}
 
-			if (strstr(tmp, "pause") != NULL)
-				deassert = DeassertPause;
-			else if (strstr(tmp, "stop") != NULL)
-				// This should have sense only when trigger = EdgeTrigger
-				deassert = DeassertStop;
-		} else continue;
+	io_pins[num] = Arena::getInstance().create<IoPin>(num, file, pin->polarity, pin->trigger,
+													  pin->playback, pin->volume, pin->rate,
+													  parseGroup(pin->group), pin->deassert,
+													  pin->debounce, pin->select,
+													  (pin->priority > 255) ? 255 : pin->priority);
+	if (!io_pins[num])
+		return false;
 
-		// Read file name (if any)
-		sprintf(io_name, "pin%i_file", i + 1);
-		str_len = sizeof(tmp);
-		if (!config.readValue("io", io_name, tmp, &str_len) || !strlen(tmp))
-			sprintf(tmp, "%i.wav", i + 1);
+	io_pins[num]->begin();
+	return !Arena::getInstance().exhausted();
+}
 
-		// Read volume
-		sprintf(io_name, "pin%i_volume", i + 1);
-		if (!config.readValue("io", io_name, &volume))
-			volume = 1.0f;
+// Tops up the voices that are playing while the main loop is busy
+// with something long, like opening the files of the pins on a reload
+static void refillPlayers()
+{
+	players.poll();
+}
 
-		// Read debouncer settings
-		sprintf(io_name, "pin%i_debounce", i + 1);
-		config.readValue("io", io_name, &debounce);
+// Starts the selector and every pin, on an empty arena
+static bool initializeIoPins()
+{
+	DEBUG_CONTEXT(uint8_t pins_count = 0);
+	DEBUG_CONTEXT(StringPool& pool = StringPool::getInstance());
+	DEBUG_CONTEXT(Arena& arena = Arena::getInstance());
 
-		io_pins[i] = new IoPin(i, tmp, polarity, trigger, playback, volume, deassert, debounce);
+	// Pins can be grouped into a binary selector
+	initializePinSelector();
 
-		if (!io_pins[i])
-		{
-			cleanupIoMode();
+	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	{
+		if (!initializeIoPin(i))
 			return false;
-		}
 
-		io_pins[i]->begin();
+		refillPlayers();
+		DEBUG_CONTEXT(pins_count += (io_pins[i] != NULL));
 	}
 
+	debugMsg(DebugInfo, "Arena: %i of %i bytes used", arena.getHighWater(), arena.getSize());
+
+	// Every pin used to keep a 256 bytes path
+	debugMsg(DebugInfo, "String pool: %i of %i bytes used, %i bytes saved", pool.getUsed(),
+			 pool.getSize(), (int32_t) (pins_count * 256) - (int32_t) pool.getSize());
+
 	return true;
 }
 
-static bool initializeLatchedMode()
+bool initializeIoMode()
 {
     // Initialize players list
-    players.initialize(false);
+    players.initialize(true);
 
-	latch_player = players.get(0);
+	// Voices that only pins with priority can take
+	players.setReserved(settings.reserved_voices, settings.reserved_priority);
 
-	latch_in_active_low = false;
-	latch_io_active_low = false;
+	if (!initializeIoPins())
+	{
+		cleanupIoMode();
+		return false;
+	}
+
+	// Start sampling the pins
+	InputScanner::getInstance().begin();
+	io_busy = InputScanner::getInstance().getEnabled();
+
+	if (settings.serial_control)
+		serial_protocol.begin(Serial, settings.baudrate);
+
+	return true;
+}
 
-	config.readValue("latch", "latch_polarity", &latch_in_active_low);
-	config.readValue("latch", "input_polarity", &latch_io_active_low);
+static bool initializeLatchedMode()
+{
+	latch_polyphonic = (settings.polyphony > 1);
+	if (latch_polyphonic)
+	{
+		// Voices are taken from the pool on every strobe
+		players.initialize(true);
+		latch_voices.begin(settings.polyphony, settings.steal,
+						   parseGroup(settings.latch_group), settings.latch_volume);
+	} else {
+		players.initialize(false);
+		initializeChannelGroups();
+		latch_player = players.get(0);
+	}
 
 	// Initialize channels pins
 	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
-		pinMode(i, (latch_io_active_low) ? INPUT_PULLUP : INPUT_PULLDOWN);
+		pinMode(i, (settings.input_polarity) ? INPUT_PULLUP : INPUT_PULLDOWN);
 
 	// Initialize latch pin
-	pinMode(LATCH, (latch_in_active_low) ? INPUT_PULLUP : INPUT_PULLDOWN);
+	pinMode(LATCH, (settings.latch_polarity) ? INPUT_PULLUP : INPUT_PULLDOWN);
+
+	attachInterrupt(LATCH, latchInterrupt, (settings.latch_polarity) ? FALLING : RISING);
+
+	if (settings.serial_control)
+		serial_protocol.begin(Serial, settings.baudrate);
 
-	attachInterrupt(LATCH, latchInterrupt, (latch_in_active_low) ? FALLING : RISING);
 	return true;
 }
 
@@ -243,7 +329,241 @@ static bool initializeSerialMode()
 {
     // Initialize players list
     players.initialize(false);
-	serial_protocol.begin(Serial, baudrate);
+	initializeChannelGroups();
+	serial_protocol.begin(Serial, settings.baudrate);
+	return true;
+}
+
+// Starts every pin again after cleanupIoMode()
+static bool restartIoPins()
+{
+	if (!initializeIoPins())
+	{
+		cleanupIoMode();
+		return false;
+	}
+
+	InputScanner::getInstance().begin();
+	io_busy = InputScanner::getInstance().getEnabled();
+	return true;
+}
+
+// True if a file name in 'from' didn't fit in the string pool
+static bool poolFull(const Settings* from)
+{
+	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	{
+		if (from->pins[i].file == STRING_POOL_FULL)
+			return true;
+	}
+
+	return false;
+}
+
+// Rebuilds the pins in 'pins' (and the selector if 'selector' is set)
+// from the current settings. If the arena can't take them, every pin
+// is rebuilt on an empty arena.
+static bool rebuildIoPins(uint16_t pins, bool selector, uint8_t* flags)
+{
+	bool full = false;
+
+	if (selector)
+		pin_selector.end();
+
+	for (uint16_t bits = pins; bits; bits &= bits - 1)
+		cleanupIoPin(__builtin_ctz(bits));
+
+	if (selector)
+		initializePinSelector();
+
+	for (uint16_t bits = pins; bits && !full; bits &= bits - 1)
+	{
+		full = !initializeIoPin(__builtin_ctz(bits));
+		refillPlayers();
+	}
+
+	if (!full)
+	{
+		io_busy |= pins;
+		return true;
+	}
+
+	debugMsg(DebugWarning, "Reload - arena full, rebuilding every pin");
+	*flags |= RELOAD_FULL_REBUILD;
+
+	cleanupIoMode();
+	return restartIoPins();
+}
+
+// Re-reads config.ini and applies what changed without a restart. Only
+// the pins whose settings changed are rebuilt, the other pins and the
+// voices they are playing are left alone, and refilled between the steps. 'pins' receives the rebuilt
+// pins and 'flags' the RELOAD_* bits.
+static bool reloadConfig(uint16_t* pins, uint8_t* flags)
+{
+	static Settings next;
+	uint16_t changed = 0;
+	bool selector;
+	bool limiter;
+	bool tracing;
+	bool pool_rebuilt = false;
+	bool groups[MIXER_MAX_GROUPS];
+
+	*pins = 0;
+	*flags = 0;
+
+	// Names already in the string pool are reused, so a file
+	// setting that didn't change keeps its index
+	if (!settingsLoad("config.ini", &next))
+		return false;
+
+	refillPlayers();
+
+	// The pool is never reclaimed, names that are no longer used stay in
+	// it. When the new ones don't fit, the pins that refer to the pool are
+	// dropped and it's filled again from the new settings alone.
+	if (poolFull(&next))
+	{
+		debugMsg(DebugWarning, "Reload - string pool full, rebuilding it");
+
+		if (settings.mode == MODE_IO)
+			cleanupIoMode();
+
+		StringPool::getInstance().reset();
+		pool_rebuilt = true;
+
+		if (!settingsLoad("config.ini", &next))
+		{
+			*flags |= RELOAD_RESTART_NEEDED;
+			return false;
+		}
+	}
+
+	// Settings that are only used at boot
+	if (next.mode != settings.mode ||
+		next.sample_rate != settings.sample_rate ||
+		next.resampler != settings.resampler ||
+		next.baudrate != settings.baudrate ||
+		next.serial_control != settings.serial_control ||
+		next.wav_index != settings.wav_index ||
+		next.disable_leds != settings.disable_leds)
+		*flags |= RELOAD_RESTART_NEEDED;
+
+	if (settings.mode == MODE_LATCHED &&
+		(next.latch_polarity != settings.latch_polarity ||
+		 next.input_polarity != settings.input_polarity ||
+		 next.polyphony != settings.polyphony ||
+		 next.steal != settings.steal ||
+		 next.latch_volume != settings.latch_volume ||
+		 groupNumber(&next, next.latch_group) != parseGroup(settings.latch_group)))
+		*flags |= RELOAD_RESTART_NEEDED;
+
+	// and they keep their current value until then
+	next.mode = settings.mode;
+	next.sample_rate = settings.sample_rate;
+	next.resampler = settings.resampler;
+	next.baudrate = settings.baudrate;
+	next.serial_control = settings.serial_control;
+	next.wav_index = settings.wav_index;
+	next.disable_leds = settings.disable_leds;
+	if (settings.mode == MODE_LATCHED)
+	{
+		next.latch_polarity = settings.latch_polarity;
+		next.input_polarity = settings.input_polarity;
+		next.polyphony = settings.polyphony;
+		next.steal = settings.steal;
+		next.latch_volume = settings.latch_volume;
+		memcpy(next.latch_group, settings.latch_group, sizeof(next.latch_group));
+	}
+
+	limiter = next.limiter != settings.limiter ||
+			  next.limiter_threshold != settings.limiter_threshold ||
+			  next.limiter_release != settings.limiter_release;
+
+	tracing = next.trace != settings.trace ||
+			  next.trace_size != settings.trace_size;
+
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
+		groups[i] = next.group_volumes[i] != settings.group_volumes[i];
+
+	selector = next.selector_pins != settings.selector_pins ||
+			   next.selector_active_low != settings.selector_active_low ||
+			   next.selector_settle != settings.selector_settle ||
+			   next.selector_stop != settings.selector_stop ||
+			   next.selector_polyphony != settings.selector_polyphony ||
+			   next.selector_steal != settings.selector_steal ||
+			   next.selector_volume != settings.selector_volume ||
+			   groupNumber(&next, next.selector_group) != parseGroup(settings.selector_group);
+
+	// Pins that join or leave the selector are rebuilt too. Both
+	// structures come from settingsDefaults(), so they can be
+	// compared as a whole.
+	if (selector)
+		changed = settings.selector_pins ^ next.selector_pins;
+
+	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	{
+		if (memcmp(&next.pins[i], &settings.pins[i], sizeof(PinSettings)) != 0 ||
+			groupNumber(&next, next.pins[i].group) != parseGroup(settings.pins[i].group))
+			changed |= (1 << i);
+	}
+
+	// From here on everything reads the new settings
+	settings = next;
+
+	Audio.setSpeakersVolume(settings.speakers_volume);
+	Audio.setHeadphoneVolume(settings.headphone_volume);
+
+	if (tracing)
+		startTrace();
+
+	if (limiter)
+		AudioMixer::getInstance().configureLimiter(settings.limiter, settings.limiter_threshold,
+												   settings.limiter_release, settings.sample_rate);
+
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
+	{
+		if (groups[i])
+			AudioMixer::getInstance().setGroupVolume(i + 1, settings.group_volumes[i]);
+	}
+
+	low_power_timeout = settings.low_power_timeout * 1000;
+	if (low_power_timeout)
+		low_power_timer.startTimeoutCounter(low_power_timeout);
+	else
+		low_power_timer.stopCounter();
+
+	switch (settings.mode)
+	{
+		case MODE_IO:
+			players.setReserved(settings.reserved_voices, settings.reserved_priority);
+
+			if (selector)
+				*flags |= RELOAD_SELECTOR;
+
+			if (pool_rebuilt)
+			{
+				*flags |= RELOAD_FULL_REBUILD;
+				if (!restartIoPins())
+					return false;
+			} else if (!rebuildIoPins(changed, selector, flags))
+				return false;
+
+			*pins = (*flags & RELOAD_FULL_REBUILD) ? 0xFFFF : changed;
+			break;
+
+		case MODE_LATCHED:
+			if (!latch_polyphonic)
+				initializeChannelGroups();
+			break;
+
+		case MODE_SERIAL:
+			initializeChannelGroups();
+			break;
+	}
+
+	trace.record(TraceReload, *flags, *pins);
+	debugMsg(DebugInfo, "Configuration reloaded, pins 0x%04x rebuilt, flags 0x%02x", *pins, *flags);
 	return true;
 }
 
@@ -257,9 +577,26 @@ static void pollSerialMode()
 static void pollIoMode()
 {
 	bool activity = false;
+	InputEvent ev;
 
-	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
-		activity |= io_pins[i]->poll();
+	// Every change is handled in order, even if several
+	// arrived since the last loop
+	while (InputEventQueue::getInstance().pop(&ev))
+	{
+		uint16_t selector_mask = pin_selector.getMask();
+
+		trace.record(TraceInput, 0, ev.changed, ev.levels);
+
+		if (ev.changed & selector_mask)
+			pin_selector.update(ev.levels, ev.timestamp);
+
+		activity |= IoPin::pollPins(io_pins, ev.changed & ~selector_mask, ev.levels, ev.changed, &io_busy);
+	}
+
+	activity |= pin_selector.poll();
+
+	// Pins that have a player to release, or that just started
+	activity |= IoPin::pollPins(io_pins, io_busy, 0, 0, &io_busy);
 
 	if (activity && low_power_timer.active())
 		low_power_timer.startTimeoutCounter(low_power_timeout);
@@ -268,46 +605,55 @@ static void pollIoMode()
 static void pollLatchedMode()
 {
 	uint16_t num;
+	InputEvent ev;
 
 	// Max. file name is 65535.wav
 	char file[10];
 
-	if (latched)
+	while (InputEventQueue::getInstance().pop(&ev))
 	{
-		__disable_irq();
-		num = latched_num;
-		latched = false;
-		__enable_irq();
-
-		if (latch_io_active_low)
+		num = ev.levels;
+		if (settings.input_polarity)
 			num = ~num;
 
 		debugMsg(DebugInfo, "Latch detected, num = %i", num);
+		trace.record(TraceLatch, 0, num);
 
-		sprintf(file, "%i.wav", num);
-		if (latch_player->play(file))
-			debugMsg(DebugInfo, "Latched mode - playing %s", file);
-		else
-			debugMsg(DebugError, "Latched mode - error playing %s", file);
+		if (latch_polyphonic)
+		{
+			latch_voices.trigger(num, ev.timestamp);
+		} else if (!WavIndex::getInstance().exists(num))
+		{
+			debugMsg(DebugError, "Latched mode - %i.wav not found", num);
+		} else {
+			sprintf(file, "%i.wav", num);
+			if (latch_player->play(file))
+				debugMsg(DebugInfo, "Latched mode - playing %s (%i ms)", file, GetTickCount() - ev.timestamp);
+			else
+				debugMsg(DebugError, "Latched mode - error playing %s", file);
+		}
 
 		if (low_power_timer.active())
 			low_power_timer.startTimeoutCounter(low_power_timeout);
 	}
+
+	if (latch_polyphonic)
+		latch_voices.poll();
 }
 
 static void pollAudioActivityLED()
 {
 	static bool playing = false;
 
-	if (disable_leds)
+	if (settings.disable_leds)
 		return;
 
-	if (Audio.isPlaying() && !playing)
+	if (players.playing() && !playing)
 	{
 		playing = true;
 		led1.stopBlink();
 		led1.blink(250, 125);
-	} else if (!Audio.isPlaying() && playing)
+	} else if (!players.playing() && playing)
 	{
 		playing = false;
 		led1.stopBlink();
@@ -315,12 +661,52 @@ static void pollAudioActivityLED()
 	}
 }
 
+static void startAudio()
+{
+	Audio.begin(settings.sample_rate);
+	Audio.setSpeakersVolume(settings.speakers_volume);
+	Audio.setHeadphoneVolume(settings.headphone_volume);
+
+	// Voices are mixed by the firmware and fed to the audio driver
+	Voice::setOutput(settings.sample_rate, settings.resampler);
+	AudioMixer::getInstance().configureLimiter(settings.limiter, settings.limiter_threshold,
+											   settings.limiter_release, settings.sample_rate);
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
+		AudioMixer::getInstance().setGroupVolume(i + 1, settings.group_volumes[i]);
+	AudioMixer::getInstance().begin(settings.sample_rate);
+}
+
+// Waits until the audio driver is pulling samples from the mixer, meaning
+// the codec and the amplifier are configured and running. Replaces what
+// used to be a fixed 500 ms delay.
+static bool waitAudioReady()
+{
+	uint32_t start = GetTickCount();
+	AudioMixer& mixer = AudioMixer::getInstance();
+
+	while (mixer.getRequests() < AUDIO_READY_REQUESTS)
+	{
+		if (GetTickCount() - start >= AUDIO_READY_TIMEOUT)
+		{
+			debugMsg(DebugWarning, "Audio not running after %i ms", AUDIO_READY_TIMEOUT);
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static void lowPowerMode()
 {
+	// Waking up goes through setup(), the trace is closed
+	trace.record(TraceLowPower);
+	trace.end();
+
 	// Stop audio
+	AudioMixer::getInstance().end();
 	Audio.end();
 
-	if (!disable_leds)
+	if (!settings.disable_leds)
 	{
 		led1.setOff();
 		led2.setOff();
@@ -328,10 +714,11 @@ static void lowPowerMode()
 		led2.end();
 	}
 
-	if (mode == MODE_SERIAL)
+	if (settings.mode == MODE_SERIAL || settings.serial_control)
 		Serial.end();
 
 	// Deinitialize every pin
+	InputScanner::getInstance().end();
 	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
 	{
 		if (io_pins[i])
@@ -341,17 +728,124 @@ static void lowPowerMode()
 	enterLowPowerMode();
 }
 
+static void wakeInterrupt()
+{
+	// Keep the levels of the first change only
+	if (!wake_pending)
+	{
+		wake_levels = inputReadPins();
+		wake_pending = true;
+	}
+}
+
+// Like lowPowerMode() but the core only sleeps, so everything in RAM is
+// kept and there's no need to go through setup() again. Any IO pin in
+// use, the latch or a byte on the serial port wakes the board, and the
+// input that woke it is then handled as usual.
+static void suspendMode()
+{
+	InputScanner& scanner = InputScanner::getInstance();
+	bool serial = (settings.mode == MODE_SERIAL || settings.serial_control);
+	uint16_t wake_mask = 0;
+	bool wake;
+
+	debugMsg(DebugInfo, "Suspending");
+	trace.record(TraceSuspend);
+	trace.flush();
+
+	// Stop audio
+	AudioMixer::getInstance().end();
+	Audio.end();
+
+	if (!settings.disable_leds)
+	{
+		led1.stopBlink();
+		led1.setOff();
+		led2.setOff();
+	}
+
+	// The scanner remembers the last debounced levels, the ones that
+	// wake the board are compared against them
+	scanner.end();
+	if (settings.mode == MODE_IO)
+		wake_mask = scanner.getEnabled();
+
+	wake_pending = false;
+	for (uint16_t bits = wake_mask; bits; bits &= bits - 1)
+		attachInterrupt(__builtin_ctz(bits), wakeInterrupt, CHANGE);
+
+	// The tick would wake the core every millisecond
+	SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+
+	// The latch interrupt posts its own event and the UART interrupt
+	// keeps the received byte. Interrupts are masked while checking,
+	// and a pending one still ends the WFI.
+	do
+	{
+		__disable_irq();
+		wake = wake_pending || !InputEventQueue::getInstance().empty() ||
+			   (serial && Serial.available());
+		if (!wake)
+			__WFI();
+		__enable_irq();
+	} while (!wake);
+
+	SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+	ClockGovernor::getInstance().boost();
+	boot.mark(BootPhaseWake);
+	trace.record(TraceWake, wake_pending, wake_mask, wake_pending ? wake_levels : 0);
+	wake_sound = true;
+
+	for (uint16_t bits = wake_mask; bits; bits &= bits - 1)
+		detachInterrupt(__builtin_ctz(bits));
+
+	// Audio takes the longest, start it first
+	startAudio();
+
+	// A pin that woke the board is posted as a change
+	if (settings.mode == MODE_IO)
+		scanner.resume(wake_pending ? wake_levels : inputReadPins());
+
+	if (!settings.disable_leds)
+	{
+		led2.setOn();
+		led1.blink(1000, 500);
+	}
+
+	waitAudioReady();
+
+	if (low_power_timeout)
+		low_power_timer.startTimeoutCounter(low_power_timeout);
+
+	debugMsg(DebugInfo, "Resumed in %i us", micros() - boot.get(BootPhaseWake));
+}
+
+// Reports how long it took from waking to the first sound
+static void pollWakeSound()
+{
+	if (!wake_sound || !players.playing())
+		return;
+
+	wake_sound = false;
+	boot.mark(BootPhaseWakeSound);
+	debugMsg(DebugInfo, "Wake to sound in %i us",
+			 boot.get(BootPhaseWakeSound) - boot.get(BootPhaseWake));
+}
+
 void setup()
 {
 #if ENABLE_DEBUG
 	initDebug();
 #endif
 
+	Profiler::getInstance().begin();
+
 	debugMsg(DebugInfo, "Artekit wavetooeasy version %i.%i.%i", VERSION_MAJOR, VERSION_MINOR, VERSION_FIX);
 
 	// Configure LEDs
 	led1.initialize();
 	led2.initialize();
+	boot.mark(BootPhaseLeds);
 
 	if (!readConfig())
 	{
@@ -361,19 +855,30 @@ void setup()
 		while(true);
 	}
 
-	if (!disable_leds)
+	boot.mark(BootPhaseConfig);
+
+	startTrace();
+	trace.record(TraceStart, settings.mode, (VERSION_MAJOR << 8) | VERSION_MINOR, VERSION_FIX);
+
+	if (!settings.disable_leds)
 	{
 		led2.setOn();
 		led1.blink(1000, 500);
 	}
 
-	Audio.begin(sample_rate);
-	Audio.setSpeakersVolume(speakers_volume_db);
-	Audio.setHeadphoneVolume(headphone_volume_db);
+	startAudio();
+	boot.mark(BootPhaseAudio);
+
+	serial_protocol.setReloadHandler(reloadConfig);
+
+	// The codec and the amplifier settle while the mode is initialized
+	// below, there's no need to wait for them here
 
-	delay(500);
+	// Index the numbered files used by the latched and serial modes
+	if (settings.wav_index)
+		WavIndex::getInstance().build();
 
-	switch (mode)
+	switch (settings.mode)
 	{
 		case MODE_IO:
 			initialized = initializeIoMode();
@@ -387,51 +892,125 @@ void setup()
 			initialized = initializeSerialMode();
 	}
 
-	initialized = true;
-	if (initialized && low_power_timeout)
+	if (!initialized)
+	{
+		// Cannot start the selected mode, blink both LEDs quickly and wait for reset
+		debugMsg(DebugError, "Cannot initialize mode %i", settings.mode);
+		led1.stopBlink();
+		led1.blink(200, 100);
+		led2.blink(200, 100);
+		while(true);
+	}
+
+	boot.mark(BootPhaseMode);
+
+	if (waitAudioReady())
+		boot.mark(BootPhaseAudioReady);
+
+	// Scale the core clock with the load from now on
+	if (settings.clock_governor)
+		ClockGovernor::getInstance().begin();
+
+	if (low_power_timeout)
 		low_power_timer.startTimeoutCounter(low_power_timeout);
+
+	boot.mark(BootPhaseReady);
+	boot.report();
 }
 
-void loop()
+// One pass over everything the main loop does, every stage is profiled
+static void pollLoop()
 {
-	if (!initialized)
-		return;
+	{
+		PROFILE_SCOPE(ProfileLeds);
+		pollAudioActivityLED();
+	}
 
-	pollAudioActivityLED();
+	{
+		PROFILE_SCOPE(ProfilePlayers);
+		uint32_t start = ClockGovernor::getInstance().refillStart();
+		players.poll();
+		ClockGovernor::getInstance().refillEnd(start);
+	}
 
-	players.poll();
+	// The trace is written once the voices have topped up their buffers
+	{
+		PROFILE_SCOPE(ProfileTrace);
+		trace.poll(players.playing());
+	}
 
-	switch (mode)
 	{
-		case MODE_IO:
-			pollIoMode();
-			break;
+		PROFILE_SCOPE(ProfileMode);
 
-		case MODE_SERIAL:
-			pollSerialMode();
-			break;
+		switch (settings.mode)
+		{
+			case MODE_IO:
+				pollIoMode();
+				break;
 
-		case MODE_LATCHED:
-			pollLatchedMode();
-			break;
+			case MODE_SERIAL:
+				pollSerialMode();
+				break;
+
+			case MODE_LATCHED:
+				pollLatchedMode();
+				break;
+		}
+	}
+
+	// Serial commands are also accepted in IO and latched modes if enabled
+	if (settings.serial_control && settings.mode != MODE_SERIAL)
+	{
+		PROFILE_SCOPE(ProfileSerial);
+		pollSerialMode();
+	}
+
+	pollWakeSound();
+
+	{
+		PROFILE_SCOPE(ProfileGovernor);
+		ClockGovernor::getInstance().poll(players.playingCount());
+	}
+
+	// Debug messages go out when there's time for them
+	{
+		PROFILE_SCOPE(ProfileDebug);
+		debugDrain(players.playing());
+	}
+}
+
+void loop()
+{
+	PROFILE_LOOP_START();
+
+	if (!initialized)
+		return;
+
+	{
+		PROFILE_SCOPE(ProfileLoop);
+		pollLoop();
 	}
 
 	// Check if it's time to enter low power mode
 	if (low_power_timer.active() && low_power_timer.timeout())
 	{
 		// Check if we have players playing
-		if (!players.playing())
-			lowPowerMode();
-		else
+		if (players.playing())
 			low_power_timer.startTimeoutCounter(low_power_timeout);
+		else if (settings.low_power_suspend)
+			suspendMode();
+		else
+			lowPowerMode();
 	}
+
+	// Everything above is driven by interrupts: the audio driver asking
+	// for samples, the input scanner, the latch, the UART and the tick.
+	// Sleep until one of them fires instead of spinning.
+	__WFI();
 }
 
 void latchInterrupt()
 {
 	// Collect IO pin states into a 16 bit number
-	latched_num = GPIOA->IDR & GPIOA_MASK;
-	latched_num |= GPIOB->IDR & GPIOB_MASK;
-	latched_num |= GPIOC->IDR & GPIOC_MASK;
-	latched = true;
+	InputEventQueue::getInstance().push(InputSourceLatch, inputReadPins(), 0);
 }
@@ -29,7 +29,13 @@ static uint16_t rx_crc;
 static uint16_t rx_calc_crc;
 static uint16_t rx_len;
 
+// Time to wait for a reply, in milliseconds. A reload parses config.ini
+// and rebuilds the pins, opening their files, before replying.
+#define WTE_REPLY_TIMEOUT		250
+#define WTE_RELOAD_TIMEOUT		3000
+
 #define SWAP16(x) (((x & 0xFF) << 8) | ((x >> 8) & 0xFF))
+#define SWAP32(x) ((((x) & 0xFF) << 24) | (((x) & 0xFF00) << 8) | (((x) >> 8) & 0xFF00) | (((x) >> 24) & 0xFF))
 
 static uint16_t wteCRC16(void* data, uint32_t len, uint16_t partial)
 {
@@ -141,11 +147,10 @@ void wteInit(cbMillis cbTicks, cbSerialReceiveChar cbReceive, cbSerialSend cbSen
 // Alternative, internal blocking version that doesn't require allocating
 // a whole packet. If CMD_ERROR is received, return the error code (the one in
 // 'data'). Otherwise return either timeout or ERROR_NONE
-static uint8_t wtePullData(uint8_t* cmd, uint8_t* data, uint16_t* len)
+static uint8_t wtePullDataTimeout(uint8_t* cmd, uint8_t* data, uint16_t* len, uint32_t timeout)
 {
     uint8_t c;
 	uint8_t error;
-    uint32_t timeout = 250;
 
     if (!initialized || !cmd)
         return 0;
@@ -287,6 +292,11 @@ static uint8_t wtePullData(uint8_t* cmd, uint8_t* data, uint16_t* len)
 	return ERROR_RX_TIMEOUT;
 }
 
+static uint8_t wtePullData(uint8_t* cmd, uint8_t* data, uint16_t* len)
+{
+	return wtePullDataTimeout(cmd, data, len, WTE_REPLY_TIMEOUT);
+}
+
 uint8_t wtePullPacket(wtePacket* packet, uint32_t timeout)
 {
     uint8_t c;
@@ -879,3 +889,453 @@ uint8_t wteGetHeadphoneVolume(float* volume)
 	*volume = vol / 10.0f;
 	return ERROR_NONE;
 }
+
+uint8_t wteGetGainReduction(float* current, float* max)
+{
+    uint8_t cmd = CMD_GET_GAIN_REDUCTION;
+	uint8_t res;
+	int16_t gr[2];
+	uint16_t len = 4;
+
+	if (!current || !max)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, NULL, 0);
+
+	res = wtePullData(&cmd, (uint8_t*) gr, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_GAIN_REDUCTION || len != 4)
+		return ERROR_ON_RX;
+
+	if (!little_endian)
+	{
+		gr[0] = SWAP16(gr[0]);
+		gr[1] = SWAP16(gr[1]);
+	}
+
+	*current = gr[0] / 10.0f;
+	*max = gr[1] / 10.0f;
+	return ERROR_NONE;
+}
+
+uint8_t wteGetChannelRate(uint8_t channel, float* rate)
+{
+	uint8_t cmd = CMD_GET_CHANNEL_RATE;
+	uint16_t len = 2;
+	uint8_t res;
+    uint16_t value;
+
+	if (channel == 0 || channel > WTE_MAX_CHANNELS || !rate)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, &channel, 1);
+
+	res = wtePullData(&cmd, (uint8_t*) &value, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_CHANNEL_RATE || len != 2)
+		return ERROR_ON_RX;
+
+    if (!little_endian)
+        value = SWAP16(value);
+
+    *rate = value / 100.0f;
+
+	return ERROR_NONE;
+}
+
+uint8_t wteSetChannelRate(uint8_t channel, float rate)
+{
+	uint8_t cmd = CMD_SET_CHANNEL_RATE;
+	uint8_t res;
+    uint8_t data[3];
+    uint16_t value;
+
+	if (channel == 0 || channel > WTE_MAX_CHANNELS)
+		return ERROR_PARAM;
+
+	if (rate > 4 || rate < 0.25f)
+		return ERROR_PARAM;
+
+    value = (uint16_t) (rate * 100.0f);
+
+    if (!little_endian)
+        value = SWAP16(value);
+
+    data[0] = channel;
+    memcpy(&data[1], (uint8_t*) &value, 2);
+
+    wteSendCommand(cmd, data, 3);
+
+	res = wtePullData(&cmd, NULL, NULL);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_SET_CHANNEL_RATE)
+		return ERROR_ON_RX;
+
+	return ERROR_NONE;
+}
+
+uint8_t wteGetChannelGroup(uint8_t channel, uint8_t* group)
+{
+	uint8_t cmd = CMD_GET_CHANNEL_GROUP;
+	uint16_t len = 1;
+	uint8_t res;
+
+	if (channel == 0 || channel > WTE_MAX_CHANNELS || !group)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, &channel, 1);
+
+	res = wtePullData(&cmd, group, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_CHANNEL_GROUP || len != 1)
+		return ERROR_ON_RX;
+
+	return ERROR_NONE;
+}
+
+uint8_t wteSetChannelGroup(uint8_t channel, uint8_t group)
+{
+	uint8_t cmd = CMD_SET_CHANNEL_GROUP;
+	uint8_t data[2];
+	uint8_t res;
+
+	if (channel == 0 || channel > WTE_MAX_CHANNELS || group > WTE_MAX_GROUPS)
+		return ERROR_PARAM;
+
+	data[0] = channel;
+	data[1] = group;
+
+	wteSendCommand(cmd, data, 2);
+
+	res = wtePullData(&cmd, NULL, NULL);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_SET_CHANNEL_GROUP)
+		return ERROR_ON_RX;
+
+	return ERROR_NONE;
+}
+
+static uint8_t wteGroupCommand(uint8_t cmd, uint8_t group)
+{
+	uint8_t sent = cmd;
+	uint16_t len = 1;
+	uint8_t data;
+	uint8_t res;
+
+	if (group == 0 || group > WTE_MAX_GROUPS)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, &group, 1);
+
+	res = wtePullData(&cmd, &data, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != sent || len != 1 || data != group)
+		return ERROR_ON_RX;
+
+	return ERROR_NONE;
+}
+
+uint8_t wteStopGroup(uint8_t group)
+{
+	return wteGroupCommand(CMD_STOP_GROUP, group);
+}
+
+uint8_t wtePauseGroup(uint8_t group)
+{
+	return wteGroupCommand(CMD_PAUSE_GROUP, group);
+}
+
+uint8_t wteResumeGroup(uint8_t group)
+{
+	return wteGroupCommand(CMD_RESUME_GROUP, group);
+}
+
+uint8_t wteGetGroupVolume(uint8_t group, float* volume)
+{
+	uint8_t cmd = CMD_GET_GROUP_VOL;
+	uint16_t len = 2;
+	uint8_t res;
+    uint16_t vol;
+
+	if (group == 0 || group > WTE_MAX_GROUPS || !volume)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, &group, 1);
+
+	res = wtePullData(&cmd, (uint8_t*) &vol, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_GROUP_VOL || len != 2)
+		return ERROR_ON_RX;
+
+    if (!little_endian)
+        vol = SWAP16(vol);
+
+    *volume = vol / 100.0f;
+
+	return ERROR_NONE;
+}
+
+uint8_t wteSetGroupVolume(uint8_t group, float volume, uint16_t fade_ms)
+{
+	uint8_t cmd = CMD_SET_GROUP_VOL;
+	uint8_t res;
+    uint8_t data[5];
+    uint16_t vol;
+
+	if (group == 0 || group > WTE_MAX_GROUPS)
+		return ERROR_PARAM;
+
+	if (volume > 5 || volume < 0)
+		return ERROR_PARAM;
+
+    vol = (uint16_t) (volume * 100.0f);
+
+    if (!little_endian)
+    {
+        vol = SWAP16(vol);
+        fade_ms = SWAP16(fade_ms);
+    }
+
+    data[0] = group;
+    memcpy(&data[1], (uint8_t*) &vol, 2);
+    memcpy(&data[3], (uint8_t*) &fade_ms, 2);
+
+    wteSendCommand(cmd, data, 5);
+
+	res = wtePullData(&cmd, NULL, NULL);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_SET_GROUP_VOL)
+		return ERROR_ON_RX;
+
+	return ERROR_NONE;
+}
+
+uint8_t wteGetInputStats(uint32_t* overflows, uint32_t* high_water, uint8_t clear)
+{
+    uint8_t cmd = CMD_GET_INPUT_STATS;
+	uint8_t res;
+	uint32_t stats[2];
+	uint16_t len = 8;
+
+	if (!overflows || !high_water)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, &clear, 1);
+
+	res = wtePullData(&cmd, (uint8_t*) stats, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_INPUT_STATS || len != 8)
+		return ERROR_ON_RX;
+
+	if (!little_endian)
+	{
+		stats[0] = SWAP32(stats[0]);
+		stats[1] = SWAP32(stats[1]);
+	}
+
+	*overflows = stats[0];
+	*high_water = stats[1];
+	return ERROR_NONE;
+}
+
+// 'count' holds how many timestamps fit in 'timestamps' and
+// receives how many boot phases the board reported
+uint8_t wteGetBootProfile(uint32_t* timestamps, uint8_t* count)
+{
+    uint8_t cmd = CMD_GET_BOOT_PROFILE;
+	uint8_t res;
+	uint8_t i;
+	uint16_t len;
+
+	if (!timestamps || !count || !*count)
+		return ERROR_PARAM;
+
+	len = *count * 4;
+	wteSendCommand(cmd, NULL, 0);
+
+	res = wtePullData(&cmd, (uint8_t*) timestamps, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_BOOT_PROFILE || (len % 4) != 0)
+		return ERROR_ON_RX;
+
+	*count = len / 4;
+	if (!little_endian)
+	{
+		for (i = 0; i < *count; i++)
+			timestamps[i] = SWAP32(timestamps[i]);
+	}
+
+	return ERROR_NONE;
+}
+
+// Makes the board re-read config.ini. 'pins' receives the pins that were
+// rebuilt, 'flags' the RELOAD_* bits. Any of them can be NULL.
+uint8_t wteReloadConfig(uint16_t* pins, uint8_t* flags)
+{
+    uint8_t cmd = CMD_RELOAD_CONFIG;
+	uint8_t res;
+	uint8_t data[3];
+	uint16_t len = 3;
+	uint16_t rebuilt;
+
+	wteSendCommand(cmd, NULL, 0);
+
+	// The board answers once config.ini is parsed and the pins rebuilt
+	res = wtePullDataTimeout(&cmd, data, &len, WTE_RELOAD_TIMEOUT);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_RELOAD_CONFIG || len != 3)
+		return ERROR_ON_RX;
+
+	memcpy(&rebuilt, data, 2);
+	if (!little_endian)
+		rebuilt = SWAP16(rebuilt);
+
+	if (pins)
+		*pins = rebuilt;
+
+	if (flags)
+		*flags = data[2];
+
+	return ERROR_NONE;
+}
+
+// Reads the statistics of a profiled stage, times are in nanoseconds.
+// A non-zero 'clear' resets the statistics of every stage after reading.
+uint8_t wteGetProfile(uint8_t stage, uint8_t clear, uint32_t* count, uint32_t* min_ns,
+					  uint32_t* avg_ns, uint32_t* max_ns)
+{
+    uint8_t cmd = CMD_GET_PROFILE;
+	uint8_t res;
+	uint8_t i;
+	uint8_t data[2];
+	uint32_t stats[4];
+	uint16_t len = sizeof(stats);
+
+	if (!count || !min_ns || !avg_ns || !max_ns)
+		return ERROR_PARAM;
+
+	data[0] = stage;
+	data[1] = clear;
+	wteSendCommand(cmd, data, 2);
+
+	res = wtePullData(&cmd, (uint8_t*) stats, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_PROFILE || len != sizeof(stats))
+		return ERROR_ON_RX;
+
+	if (!little_endian)
+	{
+		for (i = 0; i < 4; i++)
+			stats[i] = SWAP32(stats[i]);
+	}
+
+	*count = stats[0];
+	*min_ns = stats[1];
+	*avg_ns = stats[2];
+	*max_ns = stats[3];
+	return ERROR_NONE;
+}
+
+// Reads the underrun count of a channel and the lowest fill its buffer
+// reached while streaming, in bytes out of 'buffer_size'. A non-zero
+// 'clear' resets both after reading.
+uint8_t wteGetChannelStats(uint8_t channel, uint8_t clear, uint32_t* underruns, uint32_t* min_fill,
+						   uint32_t* buffer_size)
+{
+    uint8_t cmd = CMD_GET_CHANNEL_STATS;
+	uint8_t res;
+	uint8_t i;
+	uint8_t data[2];
+	uint32_t stats[3];
+	uint16_t len = sizeof(stats);
+
+	if (!underruns || !min_fill || !buffer_size)
+		return ERROR_PARAM;
+
+	data[0] = channel;
+	data[1] = clear;
+	wteSendCommand(cmd, data, 2);
+
+	res = wtePullData(&cmd, (uint8_t*) stats, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_CHANNEL_STATS || len != sizeof(stats))
+		return ERROR_ON_RX;
+
+	if (!little_endian)
+	{
+		for (i = 0; i < 3; i++)
+			stats[i] = SWAP32(stats[i]);
+	}
+
+	*underruns = stats[0];
+	*min_fill = stats[1];
+	*buffer_size = stats[2];
+	return ERROR_NONE;
+}
+
+// Reads the SD read-latency histogram shared by all channels. 'histogram'
+// and 'limits' take WTE_SD_READ_BUCKETS values each; a read lands in the
+// first bucket whose limit (in microseconds) is above its duration, the
+// last limit is 0xFFFFFFFF. 'max_us' is the slowest read seen. A non-zero
+// 'clear' resets the histogram after reading.
+uint8_t wteGetSdStats(uint8_t clear, uint32_t* histogram, uint32_t* limits, uint32_t* max_us)
+{
+    uint8_t cmd = CMD_GET_SD_STATS;
+	uint8_t res;
+	uint8_t i;
+	uint32_t stats[WTE_SD_READ_BUCKETS * 2 + 1];
+	uint16_t len = sizeof(stats);
+
+	if (!histogram || !limits || !max_us)
+		return ERROR_PARAM;
+
+	wteSendCommand(cmd, &clear, 1);
+
+	res = wtePullData(&cmd, (uint8_t*) stats, &len);
+	if (res != ERROR_NONE)
+		return res;
+
+	if (cmd != CMD_GET_SD_STATS || len != sizeof(stats))
+		return ERROR_ON_RX;
+
+	for (i = 0; i < WTE_SD_READ_BUCKETS * 2 + 1; i++)
+	{
+		if (!little_endian)
+			stats[i] = SWAP32(stats[i]);
+	}
+
+	for (i = 0; i < WTE_SD_READ_BUCKETS; i++)
+	{
+		histogram[i] = stats[i];
+		limits[i] = stats[WTE_SD_READ_BUCKETS + i];
+	}
+
+	*max_us = stats[WTE_SD_READ_BUCKETS * 2];
+	return ERROR_NONE;
+}
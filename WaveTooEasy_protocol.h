@@ -22,6 +22,8 @@ extern "C"
 
 #define WTE_MAX_PACKET_DATA_SIZE	512
 #define WTE_MAX_CHANNELS			10
+#define WTE_MAX_GROUPS				8
+#define WTE_SD_READ_BUCKETS			8
 
 #define SERIAL_HDR1	                0x7F
 #define SERIAL_HDR2	                0xAA
@@ -44,6 +46,22 @@ extern "C"
 #define CMD_SET_HEADPHONE_VOL	    0x10
 #define CMD_GET_SPEAKERS_VOL	    0x11
 #define CMD_GET_HEADPHONE_VOL	    0x12
+#define CMD_GET_GAIN_REDUCTION	    0x13
+#define CMD_GET_CHANNEL_RATE	    0x14
+#define CMD_SET_CHANNEL_RATE	    0x15
+#define CMD_GET_CHANNEL_GROUP	    0x16
+#define CMD_SET_CHANNEL_GROUP	    0x17
+#define CMD_STOP_GROUP			    0x18
+#define CMD_PAUSE_GROUP			    0x19
+#define CMD_RESUME_GROUP		    0x1A
+#define CMD_GET_GROUP_VOL		    0x1B
+#define CMD_SET_GROUP_VOL		    0x1C
+#define CMD_GET_INPUT_STATS		    0x1D
+#define CMD_GET_BOOT_PROFILE	    0x1E
+#define CMD_RELOAD_CONFIG		    0x1F
+#define CMD_GET_PROFILE			    0x20
+#define CMD_GET_CHANNEL_STATS	    0x21
+#define CMD_GET_SD_STATS		    0x22
 #define CMD_ERROR				    0xFF
 
 #define ERROR_NONE					0x00
@@ -55,6 +73,8 @@ extern "C"
 #define ERROR_INTERNAL				0x06
 #define ERROR_PLAYING				0x07
 #define ERROR_CRC16_MISMATCH        0x08
+#define ERROR_INVALID_GROUP			0x09
+#define ERROR_INVALID_STAGE			0x0A
 
 #define ERROR_NOT_PAUSED			0xFB
 #define ERROR_NOT_PLAYING			0xFC
@@ -69,6 +89,10 @@ extern "C"
 #define STATUS_PLAYING              1
 #define STATUS_PAUSED               2
 
+#define RELOAD_RESTART_NEEDED		0x01	// Some changes only apply after a restart
+#define RELOAD_SELECTOR				0x02	// The pin selector was rebuilt
+#define RELOAD_FULL_REBUILD			0x04	// Every pin was rebuilt
+
 typedef uint32_t (*cbMillis)();
 typedef uint8_t (*cbSerialReceiveChar)(uint8_t*, void*);
 typedef void (*cbSerialSend)(uint8_t*, size_t, void*);
@@ -116,6 +140,24 @@ uint8_t wteSetSpeakersVolume(float volume);
 uint8_t wteSetHeadphoneVolume(float volume);
 uint8_t wteGetSpeakersVolume(float* volume);
 uint8_t wteGetHeadphoneVolume(float* volume);
+uint8_t wteGetGainReduction(float* current, float* max);
+uint8_t wteGetChannelRate(uint8_t channel, float* rate);
+uint8_t wteSetChannelRate(uint8_t channel, float rate);
+uint8_t wteGetChannelGroup(uint8_t channel, uint8_t* group);
+uint8_t wteSetChannelGroup(uint8_t channel, uint8_t group);
+uint8_t wteStopGroup(uint8_t group);
+uint8_t wtePauseGroup(uint8_t group);
+uint8_t wteResumeGroup(uint8_t group);
+uint8_t wteGetGroupVolume(uint8_t group, float* volume);
+uint8_t wteSetGroupVolume(uint8_t group, float volume, uint16_t fade_ms);
+uint8_t wteGetInputStats(uint32_t* overflows, uint32_t* high_water, uint8_t clear);
+uint8_t wteGetBootProfile(uint32_t* timestamps, uint8_t* count);
+uint8_t wteReloadConfig(uint16_t* pins, uint8_t* flags);
+uint8_t wteGetProfile(uint8_t stage, uint8_t clear, uint32_t* count, uint32_t* min_ns,
+					  uint32_t* avg_ns, uint32_t* max_ns);
+uint8_t wteGetChannelStats(uint8_t channel, uint8_t clear, uint32_t* underruns, uint32_t* min_fill,
+						   uint32_t* buffer_size);
+uint8_t wteGetSdStats(uint8_t clear, uint32_t* histogram, uint32_t* limits, uint32_t* max_us);
 
 // Generic read/write
 uint8_t wtePullPacket(wtePacket* packet, uint32_t timeout);
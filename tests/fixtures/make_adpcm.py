@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+#
+# Generates the IMA ADPCM fixtures of test_adpcm: a WAV file per channel
+# count and, for each one, the PCM it has to decode to, as raw interleaved
+# 16-bit stereo (mono is copied to both channels, like the firmware does).
+#
+# Encoding and the reference decoding are done with the IMA/DVI codec of
+# Python's audioop module, which was removed in Python 3.13: run it with
+# an older version. The outputs are committed, so this is only needed to
+# change them.
+
+import audioop
+import math
+import random
+import struct
+
+RATE = 44100
+
+
+def signal(frames, channel):
+	# A sweep, noise bursts, clipped square waves and silence, so the step
+	# index visits both ends and the predictor saturates
+	rnd = random.Random(1234 + channel)
+	out = []
+	phase = 0.0
+	for n in range(frames):
+		part = (n * 6) // frames
+		if part == 0:
+			phase += 2 * math.pi * (50 + 15000 * n / frames) / RATE
+			v = 20000 * math.sin(phase)
+		elif part == 1:
+			v = rnd.randint(-32768, 32767)
+		elif part == 2:
+			v = 32767 if (n // (37 + channel * 11)) & 1 else -32768
+		elif part == 3:
+			v = 0
+		elif part == 4:
+			v = rnd.randint(-300, 300)
+		else:
+			phase += 2 * math.pi * 440 / RATE
+			v = 32767 * math.sin(phase) * (1 + channel)
+		out.append(max(-32768, min(32767, int(v))))
+	return out
+
+
+def nibbles(adpcm, count):
+	# audioop puts the first sample in the high nibble
+	result = []
+	for byte in adpcm:
+		result.append(byte >> 4)
+		result.append(byte & 0x0F)
+	return result[:count]
+
+
+def pack(values):
+	return struct.pack('<%dh' % len(values), *values)
+
+
+def make(name, channels, block_align, blocks):
+	per_block = (block_align - 4 * channels) * 2 // channels + 1
+	frames = per_block * blocks
+	pcm = [signal(frames, c) for c in range(channels)]
+	index = [0] * channels
+	data = bytearray()
+	decoded = [[] for c in range(channels)]
+
+	for b in range(blocks):
+		start = b * per_block
+		codes = []
+
+		for c in range(channels):
+			first = pcm[c][start]
+			data += struct.pack('<hBB', first, index[c], 0)
+			body = pack(pcm[c][start + 1:start + per_block])
+			adpcm, (_, next_index) = audioop.lin2adpcm(body, 2, (first, index[c]))
+			codes.append(nibbles(adpcm, per_block - 1))
+
+			# Reference decoding, from the header like a decoder would
+			lin, _ = audioop.adpcm2lin(adpcm, 2, (first, index[c]))
+			decoded[c].append(first)
+			decoded[c] += struct.unpack('<%dh' % (per_block - 1), lin[:(per_block - 1) * 2])
+			index[c] = next_index
+
+		# Groups of 8 samples per channel, low nibble first
+		for g in range(0, per_block - 1, 8):
+			for c in range(channels):
+				group = codes[c][g:g + 8]
+				for i in range(0, 8, 2):
+					data.append(group[i] | (group[i + 1] << 4))
+
+	fmt = struct.pack('<HHIIHHHH', 0x11, channels, RATE, RATE * block_align // per_block,
+					  block_align, 4, 2, per_block)
+	fact = struct.pack('<I', frames)
+	junk = b'fixture\0'
+	body = (b'WAVE' + b'fmt ' + struct.pack('<I', len(fmt)) + fmt +
+			b'fact' + struct.pack('<I', len(fact)) + fact +
+			b'LIST' + struct.pack('<I', len(junk)) + junk +
+			b'data' + struct.pack('<I', len(data)) + bytes(data))
+
+	with open(name + '.wav', 'wb') as f:
+		f.write(b'RIFF' + struct.pack('<I', len(body)) + body)
+
+	with open(name + '.pcm', 'wb') as f:
+		for n in range(frames):
+			f.write(struct.pack('<hh', decoded[0][n], decoded[channels - 1][n]))
+
+
+make('ima_mono', 1, 256, 12)
+make('ima_stereo', 2, 512, 12)
@@ -0,0 +1,205 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### Arduino.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+// Minimal stand-in for the Wavetooeasy core, so the firmware sources can be
+// built and exercised on a PC. Only what the tested modules use is here.
+// Time, pin levels and the cycle counter are plain variables the tests set.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define INPUT				0
+#define OUTPUT				1
+#define INPUT_PULLUP		2
+#define INPUT_PULLDOWN		3
+#define HIGH				1
+#define LOW					0
+#define CHANGE				1
+#define FALLING				2
+#define RISING				3
+#define LATCH				40
+#define LED1				41
+#define LED2				42
+
+// Time, in milliseconds and microseconds, as set by the test
+extern volatile uint32_t host_ticks;
+extern volatile uint32_t host_micros;
+
+uint32_t GetTickCount();
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+void pinMode(uint32_t pin, uint32_t mode);
+int digitalRead(uint32_t pin);
+void digitalWrite(uint32_t pin, uint32_t value);
+
+typedef void (*voidFuncPtr)(void);
+typedef void (*voidFuncPtrParam)(void*);
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
+void attachInterruptWithParam(uint32_t pin, voidFuncPtrParam callback, uint32_t mode, void* param);
+void detachInterrupt(uint32_t pin);
+
+// There are no interrupts on the host: the tests call the interrupt
+// handlers themselves, so masking them does nothing.
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+static inline void __WFI() {}
+static inline void __DSB() {}
+static inline void __ISB() {}
+
+// Used between threads by the SPSC tests, so it has to be a real barrier
+static inline void __DMB() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+// Cortex-M4 DSP instructions used by the mixer and the resampler, emulated
+// so the __ARM_FEATURE_DSP code paths can be checked against the portable
+// ones. They follow the ARM Architecture Reference Manual.
+static inline uint32_t __PKHBT(uint32_t a, uint32_t b, uint32_t shift)
+{
+	return (a & 0x0000FFFF) | ((b << shift) & 0xFFFF0000);
+}
+
+static inline uint32_t __PKHTB(uint32_t a, uint32_t b, uint32_t shift)
+{
+	return (a & 0xFFFF0000) | ((uint32_t) ((int32_t) b >> shift) & 0x0000FFFF);
+}
+
+static inline uint64_t __SMLALD(uint32_t x, uint32_t y, uint64_t acc)
+{
+	int64_t lo = (int32_t) (int16_t) x * (int32_t) (int16_t) y;
+	int64_t hi = (int32_t) (int16_t) (x >> 16) * (int32_t) (int16_t) (y >> 16);
+	return acc + (uint64_t) (lo + hi);
+}
+
+static inline int32_t __SSAT(int32_t value, uint32_t bits)
+{
+	int32_t max = (1 << (bits - 1)) - 1;
+	int32_t min = -max - 1;
+	return (value > max) ? max : ((value < min) ? min : value);
+}
+
+typedef struct { volatile uint32_t IDR; volatile uint32_t ODR; } GPIO_TypeDef;
+extern GPIO_TypeDef* GPIOA;
+extern GPIO_TypeDef* GPIOB;
+extern GPIO_TypeDef* GPIOC;
+
+typedef struct { volatile uint32_t CTRL; volatile uint32_t CYCCNT; } DWT_Type;
+extern DWT_Type* DWT;
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+extern CoreDebug_Type* CoreDebug;
+#define CoreDebug_DEMCR_TRCENA_Msk	(1u << 24)
+#define DWT_CTRL_CYCCNTENA_Msk		1u
+
+typedef struct { volatile uint32_t SCR; } SCB_Type;
+extern SCB_Type* SCB;
+#define SCB_SCR_SLEEPDEEP_Msk		4u
+
+typedef struct { volatile uint32_t CR; volatile uint32_t CSR; } PWR_TypeDef;
+extern PWR_TypeDef* PWR;
+#define PWR_CR_LPDS					1u
+#define PWR_CR_CWUF					4u
+
+typedef struct { volatile uint32_t CR; volatile uint32_t PLLCFGR; volatile uint32_t CFGR; } RCC_TypeDef;
+extern RCC_TypeDef* RCC;
+#define RCC_CFGR_HPRE				(0xFu << 4)
+#define RCC_CFGR_HPRE_DIV1			0
+#define RCC_CFGR_HPRE_DIV2			(8u << 4)
+#define RCC_CFGR_PPRE1				(7u << 10)
+#define RCC_CFGR_PPRE2				(7u << 13)
+#define RCC_CFGR_PPRE1_DIV1			0
+#define RCC_CFGR_PPRE1_DIV2			(4u << 10)
+#define RCC_CFGR_PPRE2_DIV1			0
+#define RCC_CFGR_PPRE2_DIV2			(4u << 13)
+
+typedef struct { volatile uint32_t CTRL; volatile uint32_t LOAD; volatile uint32_t VAL; } SysTick_Type;
+extern SysTick_Type* SysTick;
+#define SysTick_CTRL_TICKINT_Msk	2u
+
+extern uint32_t SystemCoreClock;
+void SystemCoreClockUpdate();
+uint32_t SysTick_Config(uint32_t ticks);
+void enterLowPowerMode();
+
+typedef enum
+{
+	PlayModeNormal,
+	PlayModeLoop
+} PlayMode;
+
+typedef enum
+{
+	AudioSourceStopped,
+	AudioSourcePlaying,
+	AudioSourcePaused
+} AudioSourceStatus;
+
+class AudioSource
+{
+public:
+	virtual ~AudioSource() {}
+
+	// Does what the audio driver does on every interrupt: asks the sources
+	// in the playlist for 'count' frames. Returns false if there are none.
+	static bool hostRender(int16_t* buffer, uint32_t count);
+
+protected:
+	virtual bool getSamples(int16_t* buffer, uint32_t count) = 0;
+	bool addToPlaylist();
+	void removeFromPlaylist();
+};
+
+class PropAudio
+{
+public:
+	bool begin(uint32_t) { return true; }
+	void end() {}
+	bool isPlaying() { return false; }
+	bool setSpeakersVolume(float) { return true; }
+	bool setHeadphoneVolume(float) { return true; }
+	float getSpeakersVolume() { return 0; }
+	float getHeadphoneVolume() { return 0; }
+};
+
+extern PropAudio Audio;
+
+class UARTClass
+{
+public:
+	void begin(uint32_t) {}
+	void end() {}
+	int available() { return 0; }
+	int read() { return -1; }
+	size_t write(const uint8_t*, size_t len) { return len; }
+	void print(const char*) {}
+	void println(const char*) {}
+};
+
+extern UARTClass Serial;
+
+#endif /* __HOST_ARDUINO_H__ */
@@ -0,0 +1,43 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ServiceTimer.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __HOST_SERVICETIMER_H__
+#define __HOST_SERVICETIMER_H__
+
+// The service timer of the core. On the host nothing calls poll() on its
+// own: the tests do, as many times as they want to simulate.
+class STObject
+{
+public:
+	virtual ~STObject() {}
+	virtual void poll() = 0;
+
+	void add() { added = true; }
+	void remove() { added = false; }
+	uint32_t getFrequency() { return 1000; }
+	bool isAdded() { return added; }
+
+private:
+	bool added = false;
+};
+
+#endif /* __HOST_SERVICETIMER_H__ */
@@ -0,0 +1,195 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ff.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "ff.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// In hostdir.cpp, as <dirent.h> has its own DIR
+void* hostOpenDir(const char* path);
+bool hostReadDir(void* handle, char* name, size_t size, bool* is_dir);
+void hostCloseDir(void* handle);
+
+const char* host_ff_root = ".";
+bool host_ff_read_error = false;
+
+static void hostPath(char* out, size_t size, const TCHAR* path)
+{
+	while (*path == '/')
+		path++;
+
+	snprintf(out, size, "%s/%s", host_ff_root, path);
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode)
+{
+	char name[512];
+	const char* how;
+
+	hostPath(name, sizeof(name), path);
+
+	if (!(mode & FA_WRITE))
+		how = "rb";
+	else if ((mode & FA_CREATE_ALWAYS) == FA_CREATE_ALWAYS)
+		how = "w+b";
+	else
+	{
+		// Open or create, without truncating
+		FILE* f = fopen(name, "ab");
+		if (!f)
+			return FR_NO_PATH;
+		fclose(f);
+		how = "r+b";
+	}
+
+	fp->fp = fopen(name, how);
+	if (!fp->fp)
+		return FR_NO_FILE;
+
+	fseek(fp->fp, 0, SEEK_END);
+	fp->obj_size = (FSIZE_t) ftell(fp->fp);
+	fp->fptr = 0;
+
+	if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND)
+		fp->fptr = fp->obj_size;
+
+	fseek(fp->fp, fp->fptr, SEEK_SET);
+	return FR_OK;
+}
+
+FRESULT f_close(FIL* fp)
+{
+	if (!fp->fp)
+		return FR_INT_ERR;
+
+	fclose(fp->fp);
+	fp->fp = NULL;
+	return FR_OK;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br)
+{
+	*br = 0;
+	if (host_ff_read_error)
+		return FR_DISK_ERR;
+
+	*br = (UINT) fread(buff, 1, btr, fp->fp);
+	fp->fptr += *br;
+	return FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+	*bw = (UINT) fwrite(buff, 1, btw, fp->fp);
+	fp->fptr += *bw;
+	if (fp->fptr > fp->obj_size)
+		fp->obj_size = fp->fptr;
+
+	return (*bw == btw) ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs)
+{
+	if (fseek(fp->fp, ofs, SEEK_SET) != 0)
+		return FR_DISK_ERR;
+
+	fp->fptr = ofs;
+	return FR_OK;
+}
+
+FRESULT f_sync(FIL* fp)
+{
+	fflush(fp->fp);
+	return FR_OK;
+}
+
+FRESULT f_opendir(DIR* dp, const TCHAR* path)
+{
+	char name[512];
+
+	hostPath(name, sizeof(name), path);
+	dp->handle = hostOpenDir(name);
+	return dp->handle ? FR_OK : FR_NO_PATH;
+}
+
+FRESULT f_closedir(DIR* dp)
+{
+	if (dp->handle)
+		hostCloseDir(dp->handle);
+
+	dp->handle = NULL;
+	return FR_OK;
+}
+
+// Like FatFs, an empty name marks the end of the directory
+FRESULT f_readdir(DIR* dp, FILINFO* fno)
+{
+	bool is_dir;
+
+	memset(fno, 0, sizeof(FILINFO));
+	if (hostReadDir(dp->handle, fno->fname, sizeof(fno->fname), &is_dir) && is_dir)
+		fno->fattrib = AM_DIR;
+
+	return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR* path)
+{
+	char name[512];
+
+	hostPath(name, sizeof(name), path);
+	return (remove(name) == 0) ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_rename(const TCHAR* old_name, const TCHAR* new_name)
+{
+	char from[512];
+	char to[512];
+
+	hostPath(from, sizeof(from), old_name);
+	hostPath(to, sizeof(to), new_name);
+	return (rename(from, to) == 0) ? FR_OK : FR_DISK_ERR;
+}
+
+// The modification time is packed like FatFs does, two seconds resolution
+FRESULT f_stat(const TCHAR* path, FILINFO* fno)
+{
+	char name[512];
+	struct stat st;
+	struct tm tm;
+
+	hostPath(name, sizeof(name), path);
+	if (stat(name, &st) != 0)
+		return FR_NO_FILE;
+
+	localtime_r(&st.st_mtime, &tm);
+	memset(fno, 0, sizeof(FILINFO));
+	fno->fsize = st.st_size;
+	fno->fdate = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+	fno->ftime = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+	fno->fattrib = S_ISDIR(st.st_mode) ? AM_DIR : 0;
+
+	const char* base = strrchr(path, '/');
+	snprintf(fno->fname, sizeof(fno->fname), "%s", base ? base + 1 : path);
+	return FR_OK;
+}
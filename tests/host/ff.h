@@ -0,0 +1,102 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### ff.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __HOST_FF_H__
+#define __HOST_FF_H__
+
+// FatFs API on top of stdio, for the host tests. Paths are relative to
+// host_ff_root. The subset and the result codes are the ones used by the
+// firmware.
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t FSIZE_t;
+typedef char TCHAR;
+
+typedef enum
+{
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_INT_ERR,
+	FR_NOT_READY,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_INVALID_NAME,
+	FR_DENIED
+} FRESULT;
+
+typedef struct
+{
+	FILE* fp;
+	FSIZE_t fptr;
+	FSIZE_t obj_size;
+} FIL;
+
+typedef struct
+{
+	void* handle;
+} DIR;
+
+typedef struct
+{
+	FSIZE_t fsize;
+	WORD fdate;
+	WORD ftime;
+	BYTE fattrib;
+	TCHAR fname[256];
+} FILINFO;
+
+#define FA_READ				0x01
+#define FA_WRITE			0x02
+#define FA_CREATE_ALWAYS	0x08
+#define FA_OPEN_ALWAYS		0x10
+#define FA_OPEN_APPEND		0x30
+#define AM_DIR				0x10
+
+// Directory the paths are relative to
+extern const char* host_ff_root;
+
+// When set, f_read() fails as if the card stopped answering
+extern bool host_ff_read_error;
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_sync(FIL* fp);
+FRESULT f_opendir(DIR* dp, const TCHAR* path);
+FRESULT f_closedir(DIR* dp);
+FRESULT f_readdir(DIR* dp, FILINFO* fno);
+FRESULT f_unlink(const TCHAR* path);
+FRESULT f_rename(const TCHAR* old_name, const TCHAR* new_name);
+FRESULT f_stat(const TCHAR* path, FILINFO* fno);
+
+#define f_size(fp)		((fp)->obj_size)
+#define f_tell(fp)		((fp)->fptr)
+
+#endif /* __HOST_FF_H__ */
@@ -0,0 +1,142 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### host.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include <Arduino.h>
+
+#include "../test.h"
+
+int test_failures = 0;
+
+volatile uint32_t host_ticks = 0;
+volatile uint32_t host_micros = 0;
+
+static GPIO_TypeDef gpioa;
+static GPIO_TypeDef gpiob;
+static GPIO_TypeDef gpioc;
+GPIO_TypeDef* GPIOA = &gpioa;
+GPIO_TypeDef* GPIOB = &gpiob;
+GPIO_TypeDef* GPIOC = &gpioc;
+
+static DWT_Type dwt;
+static CoreDebug_Type core_debug;
+static SCB_Type scb;
+static PWR_TypeDef pwr;
+static RCC_TypeDef rcc;
+static SysTick_Type systick;
+DWT_Type* DWT = &dwt;
+CoreDebug_Type* CoreDebug = &core_debug;
+SCB_Type* SCB = &scb;
+PWR_TypeDef* PWR = &pwr;
+RCC_TypeDef* RCC = &rcc;
+SysTick_Type* SysTick = &systick;
+
+uint32_t SystemCoreClock = 168000000;
+
+PropAudio Audio;
+UARTClass Serial;
+
+uint32_t GetTickCount()
+{
+	return host_ticks;
+}
+
+uint32_t millis()
+{
+	return host_ticks;
+}
+
+uint32_t micros()
+{
+	return host_micros;
+}
+
+void delay(uint32_t ms)
+{
+	host_ticks += ms;
+	host_micros += ms * 1000;
+}
+
+void pinMode(uint32_t, uint32_t) {}
+// The IO pins read the input registers, like the input scanner does
+int digitalRead(uint32_t pin)
+{
+	uint16_t levels = (GPIOA->IDR & 0x19FF) | (GPIOB->IDR & 0x600) | (GPIOC->IDR & 0xE000);
+	return (pin < 16 && (levels & (1 << pin))) ? HIGH : LOW;
+}
+
+void digitalWrite(uint32_t, uint32_t) {}
+void attachInterrupt(uint32_t, voidFuncPtr, uint32_t) {}
+void attachInterruptWithParam(uint32_t, voidFuncPtrParam, uint32_t, void*) {}
+void detachInterrupt(uint32_t) {}
+
+#define HOST_PLAYLIST_SIZE	4
+
+static AudioSource* playlist[HOST_PLAYLIST_SIZE];
+
+bool AudioSource::addToPlaylist()
+{
+	for (uint32_t i = 0; i < HOST_PLAYLIST_SIZE; i++)
+	{
+		if (playlist[i] == this)
+			return true;
+	}
+
+	for (uint32_t i = 0; i < HOST_PLAYLIST_SIZE; i++)
+	{
+		if (!playlist[i])
+		{
+			playlist[i] = this;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void AudioSource::removeFromPlaylist()
+{
+	for (uint32_t i = 0; i < HOST_PLAYLIST_SIZE; i++)
+	{
+		if (playlist[i] == this)
+			playlist[i] = NULL;
+	}
+}
+
+bool AudioSource::hostRender(int16_t* buffer, uint32_t count)
+{
+	bool rendered = false;
+
+	for (uint32_t i = 0; i < HOST_PLAYLIST_SIZE; i++)
+	{
+		if (playlist[i])
+		{
+			playlist[i]->getSamples(buffer, count);
+			rendered = true;
+		}
+	}
+
+	return rendered;
+}
+
+void SystemCoreClockUpdate() {}
+uint32_t SysTick_Config(uint32_t) { return 0; }
+void enterLowPowerMode() {}
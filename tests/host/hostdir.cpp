@@ -0,0 +1,55 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### hostdir.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include <dirent.h>
+#include <string.h>
+
+// Directory listing for f_opendir()/f_readdir() in ff.cpp
+
+void* hostOpenDir(const char* path)
+{
+	return opendir(path);
+}
+
+// Skips the hidden entries, '.' and '..'
+bool hostReadDir(void* handle, char* name, size_t size, bool* is_dir)
+{
+	struct dirent* entry;
+
+	do
+	{
+		entry = readdir((DIR*) handle);
+	} while (entry && entry->d_name[0] == '.');
+
+	if (!entry)
+		return false;
+
+	strncpy(name, entry->d_name, size - 1);
+	name[size - 1] = 0;
+	*is_dir = (entry->d_type == DT_DIR);
+	return true;
+}
+
+void hostCloseDir(void* handle)
+{
+	closedir((DIR*) handle);
+}
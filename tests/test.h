@@ -0,0 +1,83 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test.h
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+// Checks for the host tests. A failed check is reported and counted, and
+// the test carries on; main() returns testResult() as the exit code.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+extern int test_failures;
+
+#define CHECK(cond)															\
+	do																		\
+	{																		\
+		if (!(cond))														\
+		{																	\
+			printf("%s:%i: check failed: %s\n", __FILE__, __LINE__, #cond);	\
+			test_failures++;												\
+		}																	\
+	} while (0)
+
+#define CHECK_EQ(a, b)														\
+	do																		\
+	{																		\
+		long long _a = (long long) (a);										\
+		long long _b = (long long) (b);										\
+		if (_a != _b)														\
+		{																	\
+			printf("%s:%i: check failed: %s == %s (%lli != %lli)\n",		\
+				   __FILE__, __LINE__, #a, #b, _a, _b);						\
+			test_failures++;												\
+		}																	\
+	} while (0)
+
+static inline int testResult(const char* name)
+{
+	printf("%s: %s\n", name, test_failures ? "FAILED" : "passed");
+	return test_failures ? 1 : 0;
+}
+
+// Monotonic time in nanoseconds, for the benchmarks
+static inline uint64_t testNanoseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Deterministic pseudo-random numbers (xorshift32), so a failure
+// can be reproduced
+static inline uint32_t testRandom()
+{
+	static uint32_t state = 2463534242u;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+#endif /* __TEST_H__ */
@@ -0,0 +1,218 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_adpcm.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "WavFile.h"
+#include "ImaAdpcm.h"
+
+// Decodes the IMA ADPCM files in fixtures/ and compares them with the PCM
+// produced by an independent decoder (see fixtures/make_adpcm.py). Blocks
+// are decoded whole and in random pieces, as the voices do when a render
+// ends in the middle of a group. With --bench it also measures the decoder
+// throughput.
+
+#define MAX_BLOCK_ALIGN		2048
+
+struct Fixture
+{
+	const char* name;
+	WavInfo info;
+	uint8_t* data;
+	int16_t* expected;
+	uint32_t frames;
+	uint32_t blocks;
+};
+
+static uint8_t* load(const char* name, uint32_t* size)
+{
+	FIL file;
+	UINT br;
+
+	if (f_open(&file, name, FA_READ) != FR_OK)
+		return NULL;
+
+	*size = f_size(&file);
+	uint8_t* data = (uint8_t*) malloc(*size);
+	f_read(&file, data, *size, &br);
+	f_close(&file);
+	return data;
+}
+
+static bool openFixture(Fixture* fx, const char* name)
+{
+	char path[64];
+	uint32_t size;
+	FIL file;
+
+	fx->name = name;
+	snprintf(path, sizeof(path), "%s.wav", name);
+	if (f_open(&file, path, FA_READ) != FR_OK)
+	{
+		printf("%s: can't open\n", path);
+		return false;
+	}
+
+	memset(&fx->info, 0, sizeof(fx->info));
+	bool ok = wavReadHeader(&file, &fx->info);
+	f_close(&file);
+
+	CHECK(ok);
+	CHECK(wavIsSupported(&fx->info));
+	CHECK_EQ(fx->info.format, WAVE_FORMAT_IMA_ADPCM);
+	CHECK_EQ(fx->info.data_size % fx->info.block_align, 0);
+
+	uint8_t* wav = load(path, &size);
+	fx->data = wav + fx->info.data_offset;
+	fx->blocks = fx->info.data_size / fx->info.block_align;
+
+	snprintf(path, sizeof(path), "%s.pcm", name);
+	fx->expected = (int16_t*) load(path, &size);
+	fx->frames = size / (2 * sizeof(int16_t));
+
+	return ok && wav && fx->expected;
+}
+
+// Decodes the whole file. 'max_call' limits the frames per decode() call,
+// 0 decodes a block at once, and the calls are of random size otherwise.
+static bool decodeAll(Fixture* fx, uint32_t max_call)
+{
+	ImaAdpcmDecoder decoder;
+	uint32_t frame = 0;
+
+	if (!decoder.begin(fx->info.channels, fx->info.block_align, fx->info.samples_per_block))
+		return false;
+
+	uint32_t per_block = decoder.getSamplesPerBlock();
+	int16_t* out = (int16_t*) malloc(per_block * 2 * sizeof(int16_t));
+	bool ok = true;
+
+	CHECK_EQ(per_block * fx->blocks, fx->frames);
+
+	for (uint32_t b = 0; b < fx->blocks && ok; b++)
+	{
+		const uint8_t* block = fx->data + b * fx->info.block_align;
+		uint32_t done = 0;
+
+		while (done < per_block)
+		{
+			uint32_t count = max_call ? testRandom() % max_call + 1 : per_block;
+			if (count > per_block - done)
+				count = per_block - done;
+
+			decoder.decode(block, done, &out[done * 2], count);
+			done += count;
+		}
+
+		for (uint32_t i = 0; i < per_block * 2 && ok; i++)
+		{
+			if (out[i] != fx->expected[frame * 2 + i])
+			{
+				printf("%s: frame %u, channel %u: %i, expected %i (calls of up to %u frames)\n",
+					   fx->name, frame + i / 2, i & 1, out[i], fx->expected[frame * 2 + i], max_call);
+				ok = false;
+			}
+		}
+
+		frame += per_block;
+	}
+
+	free(out);
+	return ok;
+}
+
+static void testDecode(Fixture* fx)
+{
+	CHECK(decodeAll(fx, 0));
+
+	// Odd sizes split the 8-frame groups, so both paths are used
+	CHECK(decodeAll(fx, 1));
+	CHECK(decodeAll(fx, 7));
+	CHECK(decodeAll(fx, 64));
+}
+
+// The block size alone is enough when the extended format is missing
+static void testBegin()
+{
+	ImaAdpcmDecoder decoder;
+
+	CHECK(decoder.begin(1, 256, 0));
+	CHECK_EQ(decoder.getSamplesPerBlock(), 505);
+	CHECK(decoder.begin(2, 2048, 0));
+	CHECK_EQ(decoder.getSamplesPerBlock(), 2041);
+
+	// Too many samples for the block
+	CHECK(decoder.begin(2, 512, 1000));
+	CHECK_EQ(decoder.getSamplesPerBlock(), 505);
+
+	CHECK(!decoder.begin(0, 256, 0));
+	CHECK(!decoder.begin(3, 256, 0));
+	CHECK(!decoder.begin(2, 8, 0));
+}
+
+static void benchmark(Fixture* fx)
+{
+	const uint32_t rounds = 2000;
+	ImaAdpcmDecoder decoder;
+	uint32_t per_block;
+	int16_t* out;
+
+	decoder.begin(fx->info.channels, fx->info.block_align, fx->info.samples_per_block);
+	per_block = decoder.getSamplesPerBlock();
+	out = (int16_t*) malloc(per_block * 2 * sizeof(int16_t));
+
+	uint64_t start = testNanoseconds();
+	for (uint32_t r = 0; r < rounds; r++)
+	{
+		for (uint32_t b = 0; b < fx->blocks; b++)
+			decoder.decode(fx->data + b * fx->info.block_align, 0, out, per_block);
+	}
+
+	double seconds = (testNanoseconds() - start) / 1e9;
+	double frames = (double) rounds * fx->blocks * per_block;
+
+	printf("adpcm: %s: %.1f Mframes/s, %.0fx real time at %u Hz\n", fx->name,
+		   frames / seconds / 1e6, frames / seconds / fx->info.sample_rate, fx->info.sample_rate);
+	free(out);
+}
+
+int main(int argc, char** argv)
+{
+	Fixture fixtures[2];
+	bool bench = (argc > 1 && strcmp(argv[1], "--bench") == 0);
+
+	host_ff_root = "fixtures";
+
+	testBegin();
+
+	if (!openFixture(&fixtures[0], "ima_mono") || !openFixture(&fixtures[1], "ima_stereo"))
+		return testResult("adpcm");
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		testDecode(&fixtures[i]);
+
+		if (bench)
+			benchmark(&fixtures[i]);
+	}
+
+	return testResult("adpcm");
+}
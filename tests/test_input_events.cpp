@@ -0,0 +1,191 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_input_events.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "InputEvents.h"
+#include <thread>
+#include <atomic>
+
+// Runs the input event ring with the producer and the consumer on two
+// threads, standing in for the interrupt and the main loop. Every event
+// carries a sequence number that only advances when the push succeeds,
+// so the consumer must see an unbroken, untorn sequence, and every failed
+// push must show up as an overflow.
+
+#define EVENTS		200000
+
+static InputEventQueue& queue = InputEventQueue::getInstance();
+static std::atomic<bool> producing;
+static uint32_t pushed;
+static uint32_t dropped;
+
+// The random numbers of test.h aren't for two threads
+static inline uint32_t xorshift(uint32_t* state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static void spin(uint32_t loops)
+{
+	for (volatile uint32_t i = 0; i < loops; i++);
+}
+
+static void producer()
+{
+	uint32_t state = 0x12345678;
+	uint32_t seq = 0;
+	uint32_t burst = 0;
+
+	while (seq < EVENTS)
+	{
+		// The timestamp comes from GetTickCount()
+		host_ticks = seq;
+
+		if (queue.push(seq & 1 ? InputSourceLatch : InputSourcePins, seq, ~seq))
+			seq++;
+		else
+		{
+			// Let the consumer run, with a single core it may be the only way
+			dropped++;
+			std::this_thread::yield();
+		}
+
+		// Now and then a burst faster than the consumer can take
+		if (burst)
+			burst--;
+		else if (xorshift(&state) % 1024 == 0)
+			burst = 64;
+		else
+			spin(xorshift(&state) % 32);
+	}
+
+	pushed = seq;
+	producing = false;
+}
+
+static void testThreads()
+{
+	uint32_t state = 0x9ABCDEF0;
+	uint32_t expected = 0;
+	uint32_t errors = 0;
+	InputEvent ev;
+
+	queue.clear();
+	queue.resetCounters();
+	producing = true;
+
+	std::thread thread(producer);
+
+	for (;;)
+	{
+		// Read the flag first: once it is down, whatever is left is in the ring
+		bool more = producing;
+
+		while (queue.pop(&ev))
+		{
+			if (ev.timestamp != expected ||
+				ev.levels != (uint16_t) expected ||
+				ev.changed != (uint16_t) ~expected ||
+				ev.source != (expected & 1 ? InputSourceLatch : InputSourcePins))
+			{
+				if (errors++ < 10)
+					printf("event %u: got %u %04X %04X %u\n", expected,
+						   ev.timestamp, ev.levels, ev.changed, ev.source);
+			}
+
+			expected = ev.timestamp + 1;
+
+			// And now and then the consumer is late
+			if (xorshift(&state) % 1024 == 0)
+				spin(5000);
+			else
+				spin(xorshift(&state) % 24);
+		}
+
+		if (!more)
+			break;
+
+		std::this_thread::yield();
+	}
+
+	thread.join();
+
+	CHECK_EQ(errors, 0);
+	CHECK_EQ(pushed, EVENTS);
+	CHECK_EQ(expected, pushed);
+	CHECK_EQ(queue.getOverflows(), dropped);
+	CHECK(queue.empty());
+
+	// Both sides must have had their turn at a full and an empty ring
+	CHECK(dropped > 0);
+	CHECK_EQ(queue.getHighWater(), INPUT_EVENTS_SIZE);
+
+	printf("%u events, %u dropped\n", pushed, dropped);
+}
+
+// Single thread: the ring holds exactly INPUT_EVENTS_SIZE events, keeps
+// them in order across the wrap and clear() empties it
+static void testFull()
+{
+	InputEvent ev;
+
+	queue.clear();
+	queue.resetCounters();
+
+	for (uint32_t round = 0; round < 3; round++)
+	{
+		for (uint32_t n = 0; n < INPUT_EVENTS_SIZE; n++)
+			CHECK(queue.push(InputSourcePins, n, round));
+
+		CHECK(!queue.push(InputSourcePins, 0, 0));
+		CHECK_EQ(queue.getOverflows(), round + 1);
+
+		for (uint32_t n = 0; n < INPUT_EVENTS_SIZE / 2; n++)
+		{
+			if (!queue.pop(&ev))
+			{
+				CHECK(!"ring empty too early");
+				break;
+			}
+
+			CHECK_EQ(ev.levels, n);
+			CHECK_EQ(ev.changed, round);
+		}
+
+		queue.clear();
+		CHECK(queue.empty());
+		CHECK(!queue.pop(&ev));
+	}
+
+	CHECK_EQ(queue.getHighWater(), INPUT_EVENTS_SIZE);
+}
+
+int main()
+{
+	testFull();
+	testThreads();
+
+	return testResult("input events");
+}
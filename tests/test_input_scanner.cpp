@@ -0,0 +1,268 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_input_scanner.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "InputScanner.h"
+#include "InputEvents.h"
+
+// Feeds bouncing pin levels to the input scanner, one scan at a time, and
+// checks its events against a plain per-pin debouncer: a pin changes when
+// its new level has been read on four scans in a row, and then it ignores
+// changes for its lock-out time. Glitches shorter than four scans must
+// never get through.
+
+#define SCANS		200000
+
+static InputScanner& scanner = InputScanner::getInstance();
+static InputEventQueue& queue = InputEventQueue::getInstance();
+
+static void setPins(uint16_t levels)
+{
+	GPIOA->IDR = levels & GPIOA_MASK;
+	GPIOB->IDR = levels & GPIOB_MASK;
+	GPIOC->IDR = levels & GPIOC_MASK;
+}
+
+// The reference: one counter per pin
+struct Debouncer
+{
+	bool level;
+	uint32_t count;
+	uint32_t lock_ticks;
+	uint32_t lock;
+
+	bool scan(bool input)
+	{
+		bool changed = false;
+
+		if (input == level)
+			count = 0;
+		else if (++count >= 4)
+		{
+			// The 2-bit counter wraps: a locked pin tries again four scans later
+			count = 0;
+			if (!lock)
+			{
+				level = input;
+				changed = true;
+			}
+		}
+
+		if (changed)
+			lock = lock_ticks;
+		else if (lock)
+			lock--;
+
+		return changed;
+	}
+};
+
+static Debouncer reference[INPUT_PINS_COUNT];
+
+static void begin(uint16_t levels, uint16_t enabled, const uint32_t* debounce_ms)
+{
+	InputEvent ev;
+
+	scanner.end();
+	setPins(levels);
+	scanner.begin();
+
+	for (uint8_t pin = 0; pin < INPUT_PINS_COUNT; pin++)
+	{
+		scanner.disable(pin);
+		reference[pin].level = (levels >> pin) & 1;
+		reference[pin].count = 0;
+		reference[pin].lock = 0;
+		reference[pin].lock_ticks = debounce_ms ? debounce_ms[pin] : 0;
+
+		if (enabled & (1 << pin))
+			scanner.enable(pin, debounce_ms ? debounce_ms[pin] : 0);
+	}
+
+	while (queue.pop(&ev));
+	queue.resetCounters();
+}
+
+// One scan. Returns the pins the scanner reported, checking them and the
+// levels against the reference.
+static uint16_t scan(uint16_t levels, uint16_t enabled, uint32_t n)
+{
+	uint16_t expected = 0;
+	uint16_t reported = 0;
+	InputEvent ev;
+
+	setPins(levels);
+	host_ticks = n;
+	scanner.poll();
+
+	for (uint8_t pin = 0; pin < INPUT_PINS_COUNT; pin++)
+	{
+		if ((enabled & (1 << pin)) && reference[pin].scan((levels >> pin) & 1))
+			expected |= (1 << pin);
+	}
+
+	while (queue.pop(&ev))
+	{
+		CHECK_EQ(ev.source, InputSourcePins);
+		CHECK_EQ(ev.timestamp, n);
+		reported |= ev.changed;
+
+		for (uint8_t pin = 0; pin < INPUT_PINS_COUNT; pin++)
+		{
+			if (ev.changed & (1 << pin))
+				CHECK_EQ((ev.levels >> pin) & 1, reference[pin].level);
+		}
+	}
+
+	if (reported != expected)
+	{
+		printf("scan %u: reported %04X, expected %04X\n", n, reported, expected);
+		test_failures++;
+	}
+
+	return reported;
+}
+
+// A single pin: the change comes on the fourth scan, and a bounce that
+// never lasts four scans is ignored
+static void testTrace()
+{
+	// Switch closing with contact bounce, then opening
+	static const char trace[] =
+		"0000" "1011" "0110" "1" "111" "1111" "0100" "1101" "0" "000" "0000";
+	static const uint32_t changes_at[] = { 15, 31 };
+	uint32_t found = 0;
+
+	begin(0, 1, NULL);
+
+	for (uint32_t n = 0; trace[n]; n++)
+	{
+		if (scan(trace[n] == '1', 1, n))
+		{
+			CHECK(found < 2);
+			if (found < 2)
+				CHECK_EQ(n, changes_at[found]);
+
+			found++;
+		}
+	}
+
+	CHECK_EQ(found, 2);
+}
+
+// Bouncing pins at random: after every change, a burst of glitches of up
+// to three scans. Some pins have a lock-out time, the disabled pins bounce
+// too but must stay silent.
+static void testBounces()
+{
+	static const uint16_t enabled = 0xF7EF;
+	uint32_t debounce_ms[INPUT_PINS_COUNT];
+	uint16_t stable = 0;
+	uint16_t glitch = 0;
+	uint32_t next_change[INPUT_PINS_COUNT];
+	uint32_t last_change[INPUT_PINS_COUNT];
+	uint8_t glitch_length[INPUT_PINS_COUNT];
+	uint32_t events = 0;
+	uint32_t glitches = 0;
+
+	for (uint8_t pin = 0; pin < INPUT_PINS_COUNT; pin++)
+	{
+		debounce_ms[pin] = (pin & 3) ? 0 : 5 + pin * 2;
+		next_change[pin] = 1 + testRandom() % 100;
+		last_change[pin] = 0;
+		glitch_length[pin] = 0;
+	}
+
+	begin(stable, enabled, debounce_ms);
+
+	for (uint32_t n = 1; n <= SCANS; n++)
+	{
+		for (uint8_t pin = 0; pin < INPUT_PINS_COUNT; pin++)
+		{
+			uint16_t bit = 1 << pin;
+
+			if (n == next_change[pin])
+			{
+				stable ^= bit;
+				last_change[pin] = n;
+				next_change[pin] = n + 10 + testRandom() % 200;
+			}
+
+			// Glitches right after a change, and now and then at any time.
+			// A glitch never lasts four scans.
+			if (glitch & bit)
+			{
+				if (glitch_length[pin] == 3 || testRandom() % 2 == 0)
+				{
+					glitch &= ~bit;
+					glitch_length[pin] = 0;
+				} else
+					glitch_length[pin]++;
+			} else if (testRandom() % ((n - last_change[pin] < 30) ? 3 : 500) == 0)
+			{
+				glitch |= bit;
+				glitch_length[pin] = 1;
+				glitches++;
+			}
+		}
+
+		uint16_t reported = scan(stable ^ glitch, enabled, n);
+		events += __builtin_popcount(reported);
+		CHECK_EQ(reported & ~enabled, 0);
+
+		if (test_failures > 20)
+			return;
+	}
+
+	CHECK(events > 10000);
+	CHECK(glitches > 10000);
+	CHECK_EQ(queue.getOverflows(), 0);
+}
+
+// Resuming reports what changed while the scanner was stopped
+static void testResume()
+{
+	InputEvent ev;
+
+	begin(0x0001, 0x0003, NULL);
+	scanner.end();
+	scanner.resume(0x0002);
+
+	if (!queue.pop(&ev))
+	{
+		CHECK(!"no event after resume");
+		return;
+	}
+
+	CHECK_EQ(ev.changed, 0x0003);
+	CHECK_EQ(ev.levels, 0x0002);
+	CHECK(!queue.pop(&ev));
+}
+
+int main()
+{
+	testTrace();
+	testBounces();
+	testResume();
+
+	return testResult("input scanner");
+}
@@ -0,0 +1,233 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_io_pin.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Arena.h"
+#include <sys/stat.h>
+
+// The checks below look at the files a pin resolved
+#define private public
+#include "IoPin.h"
+#undef private
+#include "InputScanner.h"
+#include "InputEvents.h"
+#include "StringPool.h"
+#include "Mixer.h"
+
+// Starts IO pins the way the main loop does and checks that a level pin
+// already asserted when it starts plays without waiting for a change. The
+// input scanner starts from the current levels and reports nothing for it,
+// so the first poll has to come from the pins the loop polls on every pass.
+// Also resolves file settings with lists and patterns.
+
+#define SAMPLE_RATE		44100
+
+PlayersPool players = PlayersPool::getInstance();
+
+static IoPin* pins[INPUT_PINS_COUNT];
+static uint16_t busy;
+
+static void writeWav(const char* name, uint32_t frames)
+{
+	uint8_t header[44];
+	FIL file;
+	UINT bw;
+
+	memcpy(header, "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0", 24);
+	uint32_t values[] = { SAMPLE_RATE, SAMPLE_RATE * 2 };
+	memcpy(header + 24, values, 8);
+	memcpy(header + 32, "\x02\0\x10\0data", 8);
+	uint32_t size = frames * 2;
+	memcpy(header + 40, &size, 4);
+
+	f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS);
+	f_write(&file, header, sizeof(header), &bw);
+
+	int16_t s = 1000;
+	for (uint32_t i = 0; i < frames; i++)
+		f_write(&file, &s, 2, &bw);
+
+	f_close(&file);
+}
+
+static void setPins(uint16_t levels)
+{
+	GPIOA->IDR = levels & GPIOA_MASK;
+	GPIOB->IDR = levels & GPIOB_MASK;
+	GPIOC->IDR = levels & GPIOC_MASK;
+}
+
+// One pass of the main loop in IO mode, with a scan and a block of audio.
+// Returns true if the block isn't silent.
+static bool loop()
+{
+	int16_t block[MIXER_BLOCK_SAMPLES];
+	InputEvent ev;
+	bool sound = false;
+
+	host_ticks++;
+	InputScanner::getInstance().poll();
+
+	while (InputEventQueue::getInstance().pop(&ev))
+		IoPin::pollPins(pins, ev.changed, ev.levels, ev.changed, &busy);
+
+	IoPin::pollPins(pins, busy, 0, 0, &busy);
+
+	memset(block, 0, sizeof(block));
+	AudioSource::hostRender(block, MIXER_BLOCK_FRAMES);
+	players.poll();
+
+	for (uint32_t i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+		sound |= (block[i] != 0);
+
+	return sound;
+}
+
+// Pin 0 plays while it is high, pin 1 is triggered by its rising edge.
+// Both are high when they start.
+static void begin(bool seed)
+{
+	StringPool& pool = StringPool::getInstance();
+
+	setPins(0x0003);
+	pins[0] = new IoPin(0, pool.add("1.wav"), PinActiveHigh, LevelTrigger, PlayModeLoop,
+						1.0f, 1.0f, 0, DeassertStop, 0);
+	pins[1] = new IoPin(1, pool.add("1.wav"), PinActiveHigh, EdgeTrigger, PlayModeNormal,
+						1.0f, 1.0f, 0, DeassertStop, 0);
+
+	for (uint8_t i = 0; i < 2; i++)
+		CHECK(pins[i]->begin());
+
+	InputScanner::getInstance().begin();
+	busy = seed ? InputScanner::getInstance().getEnabled() : 0;
+}
+
+static void end()
+{
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		pins[i]->end();
+		delete pins[i];
+		pins[i] = NULL;
+	}
+
+	InputScanner::getInstance().end();
+	busy = 0;
+}
+
+static void testAssertedAtBegin()
+{
+	// Without the first poll nothing ever tells the level pin to play
+	begin(false);
+	for (uint32_t n = 0; n < 20; n++)
+		CHECK(!loop());
+
+	CHECK(InputEventQueue::getInstance().empty());
+	CHECK(!pins[0]->busy());
+	end();
+
+	// As the main loop starts them
+	begin(true);
+	loop();
+
+	CHECK(pins[0]->busy());
+	CHECK(loop());
+
+	// An edge pin waits for an edge
+	CHECK(!pins[1]->busy());
+	CHECK_EQ(busy, 0x0001);
+
+	// Released, the level pin stops and lets go of its player
+	setPins(0x0002);
+	for (uint32_t n = 0; n < 100 && pins[0]->busy(); n++)
+		loop();
+
+	CHECK(!pins[0]->busy());
+	CHECK_EQ(busy, 0);
+
+	// and asserted again it plays, from the scanner event this time
+	setPins(0x0003);
+	for (uint32_t n = 0; n < 10; n++)
+		loop();
+
+	CHECK(pins[0]->busy());
+	CHECK(!pins[1]->busy());
+	end();
+}
+
+// The file setting is read in place from the string pool
+static void testFileSpec()
+{
+	static const char* const expected[] = { "a1.wav", "A2.wav", "b.wav", "sub/hat.wav", "sub/hit1.wav" };
+	StringPool& pool = StringPool::getInstance();
+
+	mkdir("build/sub", 0755);
+	writeWav("a1.wav", 100);
+	writeWav("A2.wav", 100);
+	writeWav("b.wav", 100);
+	writeWav("sub/hit1.wav", 100);
+	writeWav("sub/hat.wav", 100);
+
+	// Matches the last pattern, but it's not a WAV file
+	FILE* f = fopen("build/sub/hot.txt", "w");
+	if (f)
+	{
+		fputs("not a sound", f);
+		fclose(f);
+	}
+
+	Arena::getInstance().reset();
+	IoPin pin(2, pool.add(" a?.wav,b.wav , ,\tsub/h*.wav,missing.wav,sub/*t"), PinActiveHigh,
+			  EdgeTrigger, PlayModeNormal, 1.0f, 1.0f, 0, DeassertStop, 0);
+
+	CHECK(pin.resolveFiles());
+	CHECK_EQ(pin.files_count, 5);
+
+	for (uint8_t i = 0; i < pin.files_count && i < 5; i++)
+	{
+		if (strcmp(pool.get(pin.files[i].path), expected[i]) != 0)
+		{
+			printf("file %u: %s, expected %s\n", i, pool.get(pin.files[i].path), expected[i]);
+			test_failures++;
+		}
+	}
+
+	// Wildcards match whole names, without case
+	CHECK(IoPin::match("H?T*", "H?T*" + 4, "hit1.wav"));
+	CHECK(!IoPin::match("h?t", "h?t" + 3, "hit1.wav"));
+	CHECK(IoPin::match("*.WAV,x", "*.WAV,x" + 5, "b.wav"));
+}
+
+int main()
+{
+	host_ff_root = "build";
+	writeWav("1.wav", SAMPLE_RATE);
+
+	Voice::setOutput(SAMPLE_RATE, ResamplerLinear);
+	AudioMixer::getInstance().begin(SAMPLE_RATE);
+	players.initialize(true);
+
+	testAssertedAtBegin();
+	testFileSpec();
+
+	return testResult("io pin");
+}
@@ -0,0 +1,209 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_limiter.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Mixer.h"
+#include "Limiter.h"
+
+// Runs the master bus limiter on the output of the mixer, with up to ten
+// full-scale voices at the maximum gain, and checks that no output sample
+// goes past the threshold, including the first samples of a block that
+// follows a quiet one. Below the threshold the limiter must only delay the
+// signal. With --bench it also times process() on a full block.
+
+#define SAMPLE_RATE		44100
+#define BLOCKS			4000
+
+static int16_t buffers[MIXER_MAX_VOICES][MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+static const int16_t* sources[MIXER_MAX_VOICES];
+static int16_t gains[MIXER_MAX_VOICES];
+
+static int32_t thresholdOf(float threshold_db)
+{
+	return (int32_t) (INT16_MAX * powf(10.0f, threshold_db / 20.0f));
+}
+
+// A mixed block. Loud blocks are random full-scale voices at random gains,
+// up to 5.0; quiet ones are a single voice well below the threshold.
+static void mixBlock(int32_t* out, bool loud)
+{
+	uint32_t voices = loud ? testRandom() % MIXER_MAX_VOICES + 1 : 1;
+
+	for (uint32_t v = 0; v < voices; v++)
+	{
+		for (uint32_t i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+		{
+			int16_t s = (int16_t) testRandom();
+			buffers[v][i] = loud ? ((testRandom() & 1) ? INT16_MAX : s) : s / 64;
+		}
+
+		gains[v] = loud ? (int16_t) (testRandom() % (mixerGain(5.0f) + 1)) : MIXER_UNITY_GAIN;
+	}
+
+	mixerMix(out, sources, gains, voices, MIXER_BLOCK_SAMPLES);
+}
+
+static void testPeakBound(float threshold_db, uint32_t release_ms)
+{
+	Limiter limiter;
+	int32_t block[MIXER_BLOCK_SAMPLES];
+	int32_t threshold = thresholdOf(threshold_db);
+	int32_t peak = 0;
+	uint32_t over = 0;
+
+	limiter.configure(threshold_db, release_ms, SAMPLE_RATE, MIXER_BLOCK_FRAMES);
+
+	for (uint32_t b = 0; b < BLOCKS; b++)
+	{
+		// Bursts of loud blocks after quiet ones, so the gain is often
+		// released when a full-scale block comes in
+		mixBlock(block, (testRandom() % 4) == 0);
+		limiter.process(block, MIXER_BLOCK_SAMPLES);
+
+		for (uint32_t i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+		{
+			int32_t s = (block[i] < 0) ? -block[i] : block[i];
+
+			if (s > peak)
+				peak = s;
+
+			if (s > threshold)
+				over++;
+		}
+	}
+
+	if (over)
+	{
+		printf("threshold %.1f dB, release %u ms: %u samples over %i, peak %i\n",
+			   threshold_db, release_ms, over, threshold, peak);
+		test_failures++;
+	}
+
+	// It limited, and not too much
+	CHECK(limiter.getMaxGainReduction() > 6.0f);
+	CHECK(peak > threshold / 2);
+}
+
+// A quiet signal comes out one block later, unchanged
+static void testTransparent()
+{
+	Limiter limiter;
+	int32_t input[2][MIXER_BLOCK_SAMPLES];
+	int32_t block[MIXER_BLOCK_SAMPLES];
+
+	limiter.configure(LIMITER_DEFAULT_THRESHOLD, LIMITER_DEFAULT_RELEASE, SAMPLE_RATE, MIXER_BLOCK_FRAMES);
+	memset(input[1], 0, sizeof(input[1]));
+
+	for (uint32_t b = 0; b < 100; b++)
+	{
+		mixBlock(input[b & 1], false);
+		memcpy(block, input[b & 1], sizeof(block));
+		limiter.process(block, MIXER_BLOCK_SAMPLES);
+
+		if (memcmp(block, input[(b & 1) ^ 1], sizeof(block)) != 0)
+		{
+			printf("block %u was changed\n", b);
+			test_failures++;
+			break;
+		}
+	}
+
+	CHECK(limiter.getMaxGainReduction() == 0);
+}
+
+// After a loud block the gain goes back to unity at the release rate
+static void testRelease()
+{
+	Limiter limiter;
+	int32_t block[MIXER_BLOCK_SAMPLES];
+	uint32_t release_blocks = (LIMITER_DEFAULT_RELEASE * SAMPLE_RATE) / (1000 * MIXER_BLOCK_FRAMES);
+
+	limiter.configure(LIMITER_DEFAULT_THRESHOLD, LIMITER_DEFAULT_RELEASE, SAMPLE_RATE, MIXER_BLOCK_FRAMES);
+
+	for (uint32_t i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+		block[i] = INT16_MAX * 4;
+
+	limiter.process(block, MIXER_BLOCK_SAMPLES);
+	CHECK(limiter.getGainReduction() > 12.0f - LIMITER_DEFAULT_THRESHOLD - 0.1f);
+
+	// After three time constants the gain is 1 - 0.78 * e^-3, or -0.34 dB
+	for (uint32_t b = 0; b < release_blocks * 3; b++)
+	{
+		memset(block, 0, sizeof(block));
+		limiter.process(block, MIXER_BLOCK_SAMPLES);
+	}
+
+	CHECK(limiter.getGainReduction() > 0.25f);
+	CHECK(limiter.getGainReduction() < 0.45f);
+
+	for (uint32_t b = 0; b < release_blocks * 10; b++)
+	{
+		memset(block, 0, sizeof(block));
+		limiter.process(block, MIXER_BLOCK_SAMPLES);
+	}
+
+	CHECK(limiter.getGainReduction() < 0.01f);
+}
+
+static void benchmark()
+{
+	const uint32_t blocks = 500000;
+	static int32_t input[16][MIXER_BLOCK_SAMPLES];
+	int32_t block[MIXER_BLOCK_SAMPLES];
+	Limiter limiter;
+	uint64_t elapsed = 0;
+
+	limiter.configure(LIMITER_DEFAULT_THRESHOLD, LIMITER_DEFAULT_RELEASE, SAMPLE_RATE, MIXER_BLOCK_FRAMES);
+
+	for (uint32_t b = 0; b < 16; b++)
+		mixBlock(input[b], b & 1);
+
+	for (uint32_t b = 0; b < blocks; b++)
+	{
+		memcpy(block, input[b & 15], sizeof(block));
+
+		uint64_t start = testNanoseconds();
+		limiter.process(block, MIXER_BLOCK_SAMPLES);
+		elapsed += testNanoseconds() - start;
+	}
+
+	printf("limiter: %.1f ns per %u-frame block\n", (double) elapsed / blocks, MIXER_BLOCK_FRAMES);
+}
+
+int main(int argc, char** argv)
+{
+	for (uint32_t v = 0; v < MIXER_MAX_VOICES; v++)
+		sources[v] = buffers[v];
+
+	testTransparent();
+	testPeakBound(-1.0f, 0);
+	testPeakBound(-1.0f, 10);
+	testPeakBound(-1.0f, 100);
+	testPeakBound(-6.0f, 50);
+	testPeakBound(-20.0f, 1000);
+	testRelease();
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+		benchmark();
+
+	return testResult("limiter");
+}
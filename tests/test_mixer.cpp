@@ -0,0 +1,159 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_mixer.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Mixer.h"
+
+// Checks that mixerMix(), the dual-MAC kernel, gives exactly the same
+// result as mixerMixReference() for any number of voices, gains and
+// samples, including the extremes that overflow 32 bits. With --bench it
+// also times both kernels on a full mixer block.
+
+#define ROUNDS		2000
+
+static int16_t buffers[MIXER_MAX_VOICES][MIXER_BLOCK_SAMPLES] __attribute__((aligned(4)));
+static const int16_t* sources[MIXER_MAX_VOICES];
+static int16_t gains[MIXER_MAX_VOICES];
+static int32_t expected[MIXER_BLOCK_SAMPLES];
+static int32_t result[MIXER_BLOCK_SAMPLES];
+
+static int16_t randomSample()
+{
+	// Mostly random, with a fair share of full-scale values
+	switch (testRandom() & 7)
+	{
+		case 0: return INT16_MAX;
+		case 1: return INT16_MIN;
+		default: return (int16_t) testRandom();
+	}
+}
+
+static int16_t randomGain()
+{
+	// Gains go from 0 to 5.0 (20480), and negative ones are valid too
+	switch (testRandom() & 7)
+	{
+		case 0: return mixerGain(5.0f);
+		case 1: return 0;
+		case 2: return INT16_MIN;
+		case 3: return INT16_MAX;
+		default: return (int16_t) testRandom();
+	}
+}
+
+static void fill(uint32_t voices)
+{
+	for (uint32_t v = 0; v < voices; v++)
+	{
+		for (uint32_t i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+			buffers[v][i] = randomSample();
+
+		gains[v] = randomGain();
+	}
+}
+
+static void testBitExact()
+{
+	for (uint32_t voices = 1; voices <= MIXER_MAX_VOICES; voices++)
+	{
+		for (uint32_t round = 0; round < ROUNDS; round++)
+		{
+			// Any even length, not just whole blocks
+			uint32_t samples = (round % (MIXER_BLOCK_SAMPLES / 2) + 1) * 2;
+
+			fill(voices);
+			mixerMixReference(expected, sources, gains, voices, samples);
+			mixerMix(result, sources, gains, voices, samples);
+
+			if (memcmp(expected, result, samples * sizeof(int32_t)) != 0)
+			{
+				printf("mismatch: %u voices, %u samples, round %u\n", voices, samples, round);
+				test_failures++;
+				break;
+			}
+		}
+	}
+}
+
+// The worst case: every voice at full scale and maximum gain
+static void testFullScale()
+{
+	int16_t out[MIXER_BLOCK_SAMPLES];
+
+	for (uint32_t v = 0; v < MIXER_MAX_VOICES; v++)
+	{
+		for (uint32_t i = 0; i < MIXER_BLOCK_SAMPLES; i++)
+			buffers[v][i] = (i & 1) ? INT16_MIN : INT16_MAX;
+
+		gains[v] = mixerGain(5.0f);
+	}
+
+	mixerMixReference(expected, sources, gains, MIXER_MAX_VOICES, MIXER_BLOCK_SAMPLES);
+	mixerMix(result, sources, gains, MIXER_MAX_VOICES, MIXER_BLOCK_SAMPLES);
+	CHECK(memcmp(expected, result, sizeof(result)) == 0);
+	CHECK_EQ(result[0], (int64_t) INT16_MAX * 5 * MIXER_MAX_VOICES);
+	CHECK_EQ(result[1], (int64_t) INT16_MIN * 5 * MIXER_MAX_VOICES);
+
+	mixerSaturate(out, result, MIXER_BLOCK_SAMPLES);
+	CHECK_EQ(out[0], INT16_MAX);
+	CHECK_EQ(out[1], INT16_MIN);
+}
+
+static void benchmark()
+{
+	const uint32_t blocks = 200000;
+	uint64_t start;
+	uint64_t reference;
+	uint64_t dual;
+
+	fill(MIXER_MAX_VOICES);
+
+	start = testNanoseconds();
+	for (uint32_t i = 0; i < blocks; i++)
+		mixerMixReference(result, sources, gains, MIXER_MAX_VOICES, MIXER_BLOCK_SAMPLES);
+	reference = testNanoseconds() - start;
+
+	start = testNanoseconds();
+	for (uint32_t i = 0; i < blocks; i++)
+		mixerMix(result, sources, gains, MIXER_MAX_VOICES, MIXER_BLOCK_SAMPLES);
+	dual = testNanoseconds() - start;
+
+	// The DSP instructions are emulated here, so this compares the
+	// structure of the kernels, not the timing on the board
+	printf("mixer: %u voices, %u samples per block: reference %.1f ns, dual-MAC %.1f ns\n",
+		   MIXER_MAX_VOICES, MIXER_BLOCK_SAMPLES,
+		   (double) reference / blocks, (double) dual / blocks);
+}
+
+int main(int argc, char** argv)
+{
+	for (uint32_t v = 0; v < MIXER_MAX_VOICES; v++)
+		sources[v] = buffers[v];
+
+	testBitExact();
+	testFullScale();
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+		benchmark();
+
+	return testResult("mixer");
+}
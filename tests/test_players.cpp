@@ -0,0 +1,359 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_players.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Voice.h"
+#include "Mixer.h"
+#include "ClockGovernor.h"
+#include "Trace.h"
+#include "Debug.h"
+
+// The checks below look at the state of the players (busy, pending...)
+#define protected public
+#define private public
+#include "Player.h"
+#undef protected
+#undef private
+
+// Simulates sixteen pins of four priorities sharing the ten players, firing
+// in bursts, with the audio rendered and the pool polled in between like
+// the firmware does. Every acquire() is checked against the pool rules:
+//
+// - the first free player is given, unless the free ones are within the
+//   'reserved' and the priority is below the reserved priority;
+// - otherwise the lowest priority player below the requested one is
+//   preempted, the oldest among equals, but never one that is already
+//   waiting to start a sound after a preemption;
+// - a preempted player fades out and starts the new owner's sound.
+
+#define SAMPLE_RATE			44100
+#define PINS				16
+#define RESERVED			2
+#define RESERVED_PRIORITY	5
+#define STEPS				200000
+
+// Longest preemption fade, in mixer blocks, plus one for poll()
+#define FADE_BLOCKS			((MIXER_UNITY_GAIN + VOICE_FAST_RAMP_STEP - 1) / VOICE_FAST_RAMP_STEP + 2)
+
+struct Pin
+{
+	uint8_t priority;
+	Player* player;
+	uint32_t started;		// Step of the last play() after a preemption
+	bool waiting;			// Preempted a player and waits for it to start
+};
+
+static PlayersPool& pool = PlayersPool::getInstance();
+static Pin pins[PINS];
+static uint32_t step;
+
+static uint32_t preemptions;
+static uint32_t denied;
+static uint32_t reserved_denied;
+
+static void writeWav(const char* name, uint32_t frames)
+{
+	uint8_t header[44];
+	FIL file;
+	UINT bw;
+
+	memcpy(header, "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0", 24);
+	uint32_t values[] = { SAMPLE_RATE, SAMPLE_RATE * 2 };
+	memcpy(header + 24, values, 8);
+	memcpy(header + 32, "\x02\0\x10\0data", 8);
+	uint32_t size = frames * 2;
+	memcpy(header + 40, &size, 4);
+
+	f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS);
+	f_write(&file, header, sizeof(header), &bw);
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		int16_t s = (int16_t) (8000 * sin(2 * M_PI * 440 * i / SAMPLE_RATE));
+		f_write(&file, &s, 2, &bw);
+	}
+
+	f_close(&file);
+}
+
+// What acquire() has to return, from the state of the players
+static Player* expected(uint8_t priority)
+{
+	Player* free_player = NULL;
+	Player* victim = NULL;
+	uint32_t free_count = 0;
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		Player* p = pool.at(i);
+
+		if (!p->busy)
+		{
+			if (!free_player)
+				free_player = p;
+
+			free_count++;
+			continue;
+		}
+
+		if (p->priority >= priority || p->pending)
+			continue;
+
+		if (!victim || p->priority < victim->priority ||
+			(p->priority == victim->priority && p->acquired < victim->acquired))
+			victim = p;
+	}
+
+	if (free_player && (free_count > RESERVED || priority >= RESERVED_PRIORITY))
+		return free_player;
+
+	if (free_player)
+		reserved_denied++;
+
+	return victim;
+}
+
+static void fire(Pin* pin)
+{
+	// Still ours, restart it
+	if (pin->player && pin->player->getOwner() == pin)
+	{
+		pin->player->play("sound.wav");
+		return;
+	}
+
+	Player* want = expected(pin->priority);
+	bool was_busy = want && want->busy;
+	Player* got = pool.acquire(pin->priority, pin);
+
+	if (got != want)
+	{
+		printf("step %u: priority %u got player %i, expected %i\n", step, pin->priority,
+			   got ? got->number : -1, want ? want->number : -1);
+		test_failures++;
+	}
+
+	pin->player = got;
+	if (!got)
+	{
+		denied++;
+		return;
+	}
+
+	CHECK(got->getOwner() == pin);
+	CHECK_EQ(got->getPriority(), pin->priority);
+	CHECK(got->play("sound.wav"));
+
+	if (was_busy)
+	{
+		preemptions++;
+		pin->waiting = true;
+		pin->started = step;
+	}
+}
+
+static void release(Pin* pin)
+{
+	if (pin->player && pin->player->getOwner() == pin)
+		pool.release(pin->player);
+
+	pin->player = NULL;
+	pin->waiting = false;
+}
+
+// A preempted player must start the new sound once it has faded out
+static void checkWaiting(Pin* pin)
+{
+	if (!pin->waiting)
+		return;
+
+	if (!pin->player->pending)
+	{
+		CHECK(pin->player->status == playerPlaying || pin->player->idle());
+		pin->waiting = false;
+	} else if (step - pin->started > FADE_BLOCKS)
+	{
+		printf("step %u: player %u still waiting after %u blocks\n", step,
+			   pin->player->number, step - pin->started);
+		test_failures++;
+		pin->waiting = false;
+	}
+}
+
+// Every busy player belongs to exactly one pin, which knows it
+static void checkOwners()
+{
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		Player* p = pool.at(i);
+		uint32_t holders = 0;
+
+		for (uint8_t n = 0; n < PINS; n++)
+		{
+			if (pins[n].player == p && p->getOwner() == &pins[n])
+				holders++;
+		}
+
+		CHECK_EQ(holders, p->busy ? 1 : 0);
+	}
+}
+
+static void render()
+{
+	int16_t block[MIXER_BLOCK_SAMPLES];
+
+	AudioSource::hostRender(block, MIXER_BLOCK_FRAMES);
+	host_ticks++;
+	pool.poll();
+}
+
+static void testBursts()
+{
+	for (step = 0; step < STEPS; step++)
+	{
+		// Now and then a burst of pins fires at once
+		if (testRandom() % 8 == 0)
+		{
+			uint32_t count = testRandom() % PINS + 1;
+
+			for (uint32_t i = 0; i < count; i++)
+				fire(&pins[testRandom() % PINS]);
+		}
+
+		// Pins let go, or find out they lost their player
+		for (uint8_t n = 0; n < PINS; n++)
+		{
+			Pin* pin = &pins[n];
+
+			if (!pin->player)
+				continue;
+
+			if (pin->player->getOwner() != pin)
+			{
+				pin->player = NULL;
+				pin->waiting = false;
+			}
+			else if (testRandom() % 200 == 0 || (pin->player->idle() && !pin->player->pending))
+				release(pin);
+		}
+
+		render();
+
+		for (uint8_t n = 0; n < PINS; n++)
+			checkWaiting(&pins[n]);
+
+		checkOwners();
+		if (test_failures > 20)
+			return;
+	}
+
+	// The rules were all exercised
+	CHECK(preemptions > 500);
+	CHECK(denied > 1000);
+	CHECK(reserved_denied > 1000);
+}
+
+static void releaseAll()
+{
+	for (uint8_t n = 0; n < PINS; n++)
+		release(&pins[n]);
+
+	for (uint32_t i = 0; i < FADE_BLOCKS; i++)
+		render();
+}
+
+// The same rules, step by step
+static void testRules()
+{
+	Pin low[MAX_PLAYERS];
+	Pin mid[2];
+	Pin high;
+
+	releaseAll();
+
+	// The reserved players are kept for the higher priorities
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		low[i].priority = 0;
+		low[i].player = pool.acquire(0, &low[i]);
+		CHECK((i < MAX_PLAYERS - RESERVED) == (low[i].player != NULL));
+		if (low[i].player)
+			low[i].player->play("sound.wav");
+
+		render();
+	}
+
+	high.priority = RESERVED_PRIORITY;
+	high.player = pool.acquire(high.priority, &high);
+	CHECK(high.player == pool.at(MAX_PLAYERS - RESERVED));
+	if (!high.player)
+		return;
+
+	high.player->play("sound.wav");
+
+	// The oldest of the lowest priority is preempted first, and a player
+	// waiting to start a sound is not taken again
+	mid[0].priority = mid[1].priority = RESERVED_PRIORITY + 1;
+	mid[0].player = pool.acquire(mid[0].priority, &mid[0]);
+	CHECK(mid[0].player == pool.at(MAX_PLAYERS - 1));
+	mid[1].player = pool.acquire(mid[1].priority, &mid[1]);
+	CHECK(mid[1].player == pool.at(0));
+	if (!mid[1].player)
+		return;
+
+	mid[1].player->play("sound.wav");
+	CHECK(mid[1].player->pending);
+	CHECK(pool.acquire(RESERVED_PRIORITY + 2, &high) == pool.at(1));
+	CHECK(pool.at(0)->getOwner() != &low[0]);
+
+	// Equal priorities don't preempt each other
+	CHECK(pool.acquire(0, &low[0]) == NULL);
+
+	for (uint32_t i = 0; i < FADE_BLOCKS; i++)
+		render();
+
+	CHECK(!mid[1].player->pending);
+	CHECK_EQ(mid[1].player->getStatus(), playerPlaying);
+	CHECK(mid[1].player->voice.isMixing());
+}
+
+int main()
+{
+	host_ff_root = "build";
+	writeWav("sound.wav", SAMPLE_RATE / 4);
+
+	Voice::setOutput(SAMPLE_RATE, ResamplerLinear);
+	AudioMixer::getInstance().begin(SAMPLE_RATE);
+	pool.initialize(true);
+	pool.setReserved(RESERVED, RESERVED_PRIORITY);
+
+	for (uint8_t n = 0; n < PINS; n++)
+	{
+		static const uint8_t priorities[4] = { 0, 2, RESERVED_PRIORITY, 9 };
+		pins[n].priority = priorities[n / 4];
+	}
+
+	testBursts();
+	testRules();
+
+	return testResult("players");
+}
@@ -0,0 +1,107 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_profiler.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Profiler.h"
+
+// Stages are timed with the cycle counter and kept in nanoseconds at the
+// clock they ran at: stages shorter than a microsecond must not read as
+// zero, and a clock change must not change the time of the same work.
+
+static Profiler& profiler = Profiler::getInstance();
+
+// A stage that takes 'cycles' core cycles
+static void run(ProfileStage stage, uint32_t cycles)
+{
+	PROFILE_SCOPE(stage);
+	DWT->CYCCNT += cycles;
+}
+
+static ProfileStats stats(ProfileStage stage)
+{
+	ProfileStats s;
+	profiler.get(stage, &s);
+	return s;
+}
+
+static void testShortStages()
+{
+	SystemCoreClock = 168000000;
+	profiler.reset();
+
+	// 1, 100 and 1000 cycles: 5.95 ns, 595 ns and 5.95 us
+	run(ProfileLeds, 1);
+	run(ProfileLeds, 100);
+	run(ProfileLeds, 1000);
+
+	ProfileStats s = stats(ProfileLeds);
+	CHECK_EQ(s.count, 3);
+	CHECK_EQ(s.min, 5);
+	CHECK_EQ(s.max, 5952);
+
+	// The total isn't rounded per sample
+	uint64_t exact = 1101ull * 1000000000ull / SystemCoreClock;
+	CHECK(s.total >= exact - 2 && s.total <= exact);
+
+	// A thousand runs of 84 cycles: half a microsecond each
+	profiler.reset();
+	for (uint32_t n = 0; n < 1000; n++)
+		run(ProfileMix, 84);
+
+	s = stats(ProfileMix);
+	CHECK_EQ(s.total / s.count, 499);
+}
+
+// The same work at half the clock takes twice the time
+static void testClockChange()
+{
+	profiler.reset();
+
+	SystemCoreClock = 168000000;
+	run(ProfileMode, 16800);
+	SystemCoreClock = 84000000;
+	run(ProfileMode, 16800);
+	SystemCoreClock = 16000000;
+	run(ProfileMode, 1600);
+
+	ProfileStats s = stats(ProfileMode);
+	CHECK_EQ(s.min, 99999);
+	CHECK_EQ(s.max, 199999);
+	CHECK_EQ(s.count, 3);
+
+	// Long periods saturate instead of wrapping
+	SystemCoreClock = 1000000;
+	run(ProfileLoopPeriod, 0xFFFFFFFF);
+	CHECK_EQ(stats(ProfileLoopPeriod).max, UINT32_MAX);
+
+	SystemCoreClock = 168000000;
+}
+
+int main()
+{
+	profiler.begin();
+
+	testShortStages();
+	testClockChange();
+
+	return testResult("profiler");
+}
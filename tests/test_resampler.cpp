@@ -0,0 +1,239 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_resampler.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Resampler.h"
+
+// Sweeps the resampler across steps (input frames per output frame). For
+// every step a tone in the passband has to come out at the right level and
+// clean, and with the polyphase filter a tone the output rate can't carry
+// has to be filtered instead of folding back. With --bench it prints the
+// measurements and the time per output frame of both modes.
+
+#define AMPLITUDE		16000.0
+#define SETTLE_FRAMES	256
+#define MEASURE_FRAMES	8192
+
+struct Measure
+{
+	double gain_db;			// Level of the tone at the output
+	double residual_db;		// Everything else, relative to the input tone
+	double total_db;		// Whole output, relative to the input tone
+};
+
+static Resampler resampler;
+static int16_t output[(SETTLE_FRAMES + MEASURE_FRAMES) * 2];
+
+static double toDb(double ratio)
+{
+	return (ratio > 1e-9) ? 20.0 * log10(ratio) : -180.0;
+}
+
+// Resamples a sine of 'frequency' cycles per input frame and measures the
+// output at the frequency it should have, in cycles per output frame
+static Measure run(ResamplerMode mode, uint32_t step, double frequency)
+{
+	double phase = 0;
+	uint32_t done = 0;
+
+	resampler.reset(mode, step);
+
+	while (done < SETTLE_FRAMES + MEASURE_FRAMES)
+	{
+		int16_t* input;
+		uint32_t frames = resampler.prepare(RESAMPLER_CHUNK, &input);
+
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			int16_t s = (int16_t) lrint(AMPLITUDE * sin(phase));
+			input[i * 2] = s;
+			input[i * 2 + 1] = s;
+			phase += 2 * M_PI * frequency;
+		}
+
+		resampler.process(&output[done * 2], RESAMPLER_CHUNK);
+		done += RESAMPLER_CHUNK;
+	}
+
+	double out_frequency = frequency * step / RESAMPLER_UNITY_STEP;
+	double in_phase = 0;
+	double quadrature = 0;
+	double power = 0;
+
+	for (uint32_t k = SETTLE_FRAMES; k < SETTLE_FRAMES + MEASURE_FRAMES; k++)
+	{
+		double s = output[k * 2];
+
+		CHECK_EQ(output[k * 2], output[k * 2 + 1]);
+		in_phase += s * sin(2 * M_PI * out_frequency * k);
+		quadrature += s * cos(2 * M_PI * out_frequency * k);
+		power += s * s;
+	}
+
+	double amplitude = 2 * sqrt(in_phase * in_phase + quadrature * quadrature) / MEASURE_FRAMES;
+	double residual = power / MEASURE_FRAMES - amplitude * amplitude / 2;
+	Measure m;
+
+	m.gain_db = toDb(amplitude / AMPLITUDE);
+	m.residual_db = toDb(sqrt(2 * (residual > 0 ? residual : 0)) / AMPLITUDE);
+	m.total_db = toDb(sqrt(2 * power / MEASURE_FRAMES) / AMPLITUDE);
+	return m;
+}
+
+static uint32_t toStep(double ratio)
+{
+	return (uint32_t) lround(ratio * RESAMPLER_UNITY_STEP);
+}
+
+// Highest frequency the output can carry, in cycles per input frame
+static double outputNyquist(double ratio)
+{
+	return (ratio > 1) ? 0.5 / ratio : 0.5;
+}
+
+struct SweepPoint
+{
+	double ratio;
+	double min_rejection_db;	// Of a tone past the output Nyquist, 0 to skip
+};
+
+// 44.1 kHz files on 48 kHz and the other way around, and pitch shifts down
+// to three octaves. Sixteen taps can't make a steep filter at the lowest
+// cutoffs, so less is expected there.
+static const SweepPoint sweep[] =
+{
+	{ 0.5, 0 },
+	{ 0.91875, 0 },
+	{ 1.0, 0 },
+	{ 1.08844, 0 },
+	{ 1.5, 60 },
+	{ 2.0, 60 },
+	{ 3.0, 40 },
+	{ 4.0, 30 },
+	{ 6.0, 15 },
+	{ 8.0, 10 },
+};
+
+#define SWEEP_POINTS	(sizeof(sweep) / sizeof(sweep[0]))
+
+static double stopbandFrequency(double ratio)
+{
+	double f = outputNyquist(ratio) * 1.8;
+	return (f > 0.49) ? 0.49 : f;
+}
+
+static void testSweep()
+{
+	for (uint32_t i = 0; i < SWEEP_POINTS; i++)
+	{
+		double ratio = sweep[i].ratio;
+		Measure pass = run(ResamplerPolyphase, toStep(ratio), outputNyquist(ratio) * 0.4);
+
+		if (pass.gain_db < -1.0 || pass.gain_db > 0.1 || pass.residual_db > -40)
+		{
+			printf("step %.3f: passband gain %.2f dB, residual %.1f dB\n",
+				   ratio, pass.gain_db, pass.residual_db);
+			test_failures++;
+		}
+
+		if (!sweep[i].min_rejection_db)
+			continue;
+
+		Measure stop = run(ResamplerPolyphase, toStep(ratio), stopbandFrequency(ratio));
+		if (-stop.total_db < sweep[i].min_rejection_db)
+		{
+			printf("step %.3f: tone at %.3f only %.1f dB down\n",
+				   ratio, stopbandFrequency(ratio), -stop.total_db);
+			test_failures++;
+		}
+	}
+}
+
+// The linear interpolator has no filter, only check it follows the step
+static void testLinear()
+{
+	for (uint32_t i = 0; i < SWEEP_POINTS; i++)
+	{
+		double ratio = sweep[i].ratio;
+		Measure pass = run(ResamplerLinear, toStep(ratio), outputNyquist(ratio) * 0.1);
+
+		CHECK(pass.gain_db > -0.2 && pass.gain_db < 0.1);
+		CHECK(pass.residual_db < -30);
+	}
+}
+
+static double nanosecondsPerFrame(ResamplerMode mode, uint32_t step)
+{
+	const uint32_t chunks = 200000;
+	uint64_t elapsed = 0;
+
+	resampler.reset(mode, step);
+
+	for (uint32_t i = 0; i < chunks; i++)
+	{
+		int16_t* input;
+		uint32_t frames = resampler.prepare(RESAMPLER_CHUNK, &input);
+
+		for (uint32_t f = 0; f < frames * 2; f++)
+			input[f] = (int16_t) testRandom();
+
+		uint64_t start = testNanoseconds();
+		resampler.process(output, RESAMPLER_CHUNK);
+		elapsed += testNanoseconds() - start;
+	}
+
+	return (double) elapsed / (chunks * RESAMPLER_CHUNK);
+}
+
+static void benchmark()
+{
+	printf("resampler:  step   passband  residual  rejection  linear ns  polyphase ns\n");
+
+	for (uint32_t i = 0; i < SWEEP_POINTS; i++)
+	{
+		double ratio = sweep[i].ratio;
+		Measure pass = run(ResamplerPolyphase, toStep(ratio), outputNyquist(ratio) * 0.4);
+		Measure stop = run(ResamplerPolyphase, toStep(ratio), stopbandFrequency(ratio));
+
+		// Without downsampling, the stopband tone is still in the passband
+		if (ratio <= 1)
+			stop.total_db = 0;
+
+		printf("resampler: %6.3f %7.2f dB %6.1f dB %7.1f dB %9.1f %13.1f\n",
+			   ratio, pass.gain_db, pass.residual_db, -stop.total_db,
+			   nanosecondsPerFrame(ResamplerLinear, toStep(ratio)),
+			   nanosecondsPerFrame(ResamplerPolyphase, toStep(ratio)));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Resampler::initialize();
+
+	testSweep();
+	testLinear();
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+		benchmark();
+
+	return testResult("resampler");
+}
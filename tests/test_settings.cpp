@@ -0,0 +1,658 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_settings.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Settings.h"
+#include "StringPool.h"
+#include <strings.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+// Checks settingsLoad() against the way config.ini was read before it:
+// one PropConfig::readValue() per key, each one scanning the file again,
+// with the values interpreted by the code that was in WaveTooEasy.ino.
+// Both are run on fixtures/config.ini and must give the same settings,
+// apart from the differences listed in testDifferences(). The config.bin
+// image must give back the same settings and string pool, and must be
+// dropped when config.ini changes. With --bench it also times the three.
+
+// Model of PropConfig::readValue(): section and key names are compared
+// without case, values are trimmed and may be quoted. String lengths are
+// in and out: the room available, and then the length of the value.
+class LegacyConfig
+{
+public:
+	bool begin(const char* path)
+	{
+		FIL file;
+
+		this->path = path;
+		if (f_open(&file, path, FA_READ) != FR_OK)
+			return false;
+
+		f_close(&file);
+		return true;
+	}
+
+	bool readValue(const char* section, const char* key, char* value, uint32_t* len)
+	{
+		char line[SETTINGS_MAX_LINE];
+		char current[32] = "";
+		bool found = false;
+		FIL file;
+
+		scans++;
+		if (f_open(&file, path, FA_READ) != FR_OK)
+			return false;
+
+		while (!found && readLine(&file, line, sizeof(line)))
+		{
+			char* p = trim(line);
+
+			if (*p == '[')
+			{
+				char* end = strchr(p, ']');
+				if (end)
+				{
+					*end = 0;
+					snprintf(current, sizeof(current), "%s", trim(p + 1));
+				}
+				continue;
+			}
+
+			char* equal = strchr(p, '=');
+			if (*p == ';' || *p == '#' || !equal || strcasecmp(current, section) != 0)
+				continue;
+
+			*equal = 0;
+			if (strcasecmp(trim(p), key) != 0)
+				continue;
+
+			char* v = trim(equal + 1);
+			uint32_t v_len = strlen(v);
+			if (v_len >= 2 && v[0] == '"' && v[v_len - 1] == '"')
+			{
+				v[v_len - 1] = 0;
+				v++;
+			}
+
+			snprintf(value, *len, "%s", v);
+			*len = strlen(value);
+			found = true;
+		}
+
+		f_close(&file);
+		return found;
+	}
+
+	bool readValue(const char* section, const char* key, uint32_t* value)
+	{
+		char tmp[32];
+		uint32_t len = sizeof(tmp);
+
+		if (!readValue(section, key, tmp, &len))
+			return false;
+
+		*value = strtoul(tmp, NULL, 10);
+		return true;
+	}
+
+	bool readValue(const char* section, const char* key, float* value)
+	{
+		char tmp[32];
+		uint32_t len = sizeof(tmp);
+
+		if (!readValue(section, key, tmp, &len))
+			return false;
+
+		*value = strtof(tmp, NULL);
+		return true;
+	}
+
+	bool readValue(const char* section, const char* key, bool* value)
+	{
+		char tmp[32];
+		uint32_t len = sizeof(tmp);
+
+		if (!readValue(section, key, tmp, &len))
+			return false;
+
+		*value = strcmp(tmp, "1") == 0 || strcasecmp(tmp, "true") == 0 ||
+				 strcasecmp(tmp, "yes") == 0 || strcasecmp(tmp, "on") == 0;
+		return true;
+	}
+
+	uint32_t scans = 0;
+
+private:
+	static bool readLine(FIL* file, char* line, uint32_t size)
+	{
+		uint32_t len = 0;
+		char c;
+		UINT br;
+
+		while (f_read(file, &c, 1, &br) == FR_OK && br == 1)
+		{
+			if (c == '\n')
+				break;
+
+			if (len < size - 1)
+				line[len++] = c;
+		}
+
+		line[len] = 0;
+		return len || br;
+	}
+
+	static char* trim(char* str)
+	{
+		while (*str == ' ' || *str == '\t')
+			str++;
+
+		char* end = str + strlen(str);
+		while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+			*--end = 0;
+
+		return str;
+	}
+
+	const char* path;
+};
+
+// File names are compared as the IO pins see them, defaults applied
+struct LegacyPin
+{
+	char file[64];
+};
+
+// The reads of the old readConfig(), initializeSelector(), initializeIoMode()
+// and initializeLatchedMode(), into a Settings
+static void legacyLoad(LegacyConfig& config, Settings* s, LegacyPin* pins)
+{
+	char tmp[64];
+	char key[32];
+	uint32_t len;
+
+	settingsDefaults(s);
+
+	len = sizeof(tmp);
+	if (config.readValue("settings", "mode", tmp, &len))
+	{
+		if (strncasecmp("serial", tmp, len) == 0)
+			s->mode = MODE_SERIAL;
+		else if (strncasecmp("io", tmp, len) == 0)
+			s->mode = MODE_IO;
+		else if (strncasecmp("latch", tmp, len) == 0)
+			s->mode = MODE_LATCHED;
+	}
+
+	config.readValue("settings", "sample_rate", &s->sample_rate);
+	config.readValue("settings", "speakers_volume", &s->speakers_volume);
+	config.readValue("settings", "headphone_volume", &s->headphone_volume);
+	config.readValue("settings", "baudrate", &s->baudrate);
+	config.readValue("settings", "disable_leds", &s->disable_leds);
+	config.readValue("settings", "serial_control", &s->serial_control);
+	config.readValue("settings", "wav_index", &s->wav_index);
+	config.readValue("settings", "low_power_timeout", &s->low_power_timeout);
+	config.readValue("settings", "limiter", &s->limiter);
+	config.readValue("settings", "limiter_threshold", &s->limiter_threshold);
+	config.readValue("settings", "limiter_release", &s->limiter_release);
+
+	len = sizeof(tmp);
+	if (config.readValue("settings", "resampler", tmp, &len))
+	{
+		if (strncasecmp("off", tmp, len) == 0)
+			s->resampler = ResamplerOff;
+		else if (strncasecmp("linear", tmp, len) == 0)
+			s->resampler = ResamplerLinear;
+		else if (strncasecmp("polyphase", tmp, len) == 0)
+			s->resampler = ResamplerPolyphase;
+	}
+
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
+	{
+		sprintf(key, "group%i_name", i + 1);
+		len = SETTINGS_NAME_LEN;
+		config.readValue("groups", key, s->group_names[i], &len);
+
+		sprintf(key, "group%i_volume", i + 1);
+		config.readValue("groups", key, &s->group_volumes[i]);
+	}
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+	{
+		sprintf(key, "channel%i_group", i + 1);
+		len = SETTINGS_NAME_LEN;
+		config.readValue("groups", key, s->channel_groups[i], &len);
+	}
+
+	len = sizeof(tmp);
+	if (config.readValue("io", "selector_pins", tmp, &len))
+	{
+		uint16_t mask = 0;
+
+		// parsePinList() of the old code
+		for (char* p = tmp; *p;)
+		{
+			char* end;
+			uint32_t first = strtoul(p, &end, 10);
+			uint32_t last = first;
+
+			if (end == p)
+			{
+				p++;
+				continue;
+			}
+
+			for (p = end; *p == ' '; p++);
+
+			if (*p == '-')
+			{
+				last = strtoul(p + 1, &end, 10);
+				p = end;
+			}
+
+			for (uint32_t n = first; n <= last && n <= IO_PINS_COUNT; n++)
+				if (n)
+					mask |= (1 << (n - 1));
+		}
+
+		s->selector_pins = mask;
+		config.readValue("io", "selector_active_low", &s->selector_active_low);
+		config.readValue("io", "selector_settle", &s->selector_settle);
+		config.readValue("io", "selector_stop", &s->selector_stop);
+		config.readValue("io", "selector_polyphony", &s->selector_polyphony);
+		config.readValue("io", "selector_volume", &s->selector_volume);
+
+		len = sizeof(tmp);
+		if (config.readValue("io", "selector_steal", tmp, &len) && strncasecmp("none", tmp, len) == 0)
+			s->selector_steal = LatchStealNone;
+
+		len = SETTINGS_NAME_LEN;
+		config.readValue("io", "selector_group", s->selector_group, &len);
+	}
+
+	config.readValue("io", "reserved_voices", &s->reserved_voices);
+	config.readValue("io", "reserved_priority", &s->reserved_priority);
+
+	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	{
+		PinSettings* pin = &s->pins[i];
+
+		sprintf(key, "pin%i_mode", i + 1);
+		len = sizeof(tmp);
+		if (!config.readValue("io", key, tmp, &len))
+			continue;
+
+		// The old code lowercased the key instead of the value, so
+		// the words were case sensitive
+		pin->configured = true;
+		if (strstr(tmp, "loop") != NULL)
+			pin->playback = PlayModeLoop;
+
+		if (strstr(tmp, "low") != NULL)
+			pin->polarity = PinActiveLow;
+
+		if (strstr(tmp, "edge") != NULL)
+			pin->trigger = EdgeTrigger;
+
+		if (strstr(tmp, "pause") != NULL)
+			pin->deassert = DeassertPause;
+		else if (strstr(tmp, "stop") != NULL)
+			pin->deassert = DeassertStop;
+
+		sprintf(key, "pin%i_group", i + 1);
+		len = SETTINGS_NAME_LEN;
+		config.readValue("io", key, pin->group, &len);
+
+		sprintf(key, "pin%i_select", i + 1);
+		len = sizeof(tmp);
+		if (config.readValue("io", key, tmp, &len))
+		{
+			if (strncasecmp("random", tmp, len) == 0)
+				pin->select = SelectRandom;
+			else if (strncasecmp("sequence", tmp, len) == 0)
+				pin->select = SelectSequence;
+		}
+
+		sprintf(key, "pin%i_file", i + 1);
+		len = sizeof(pins[i].file);
+		if (!config.readValue("io", key, pins[i].file, &len) || !strlen(pins[i].file))
+			snprintf(pins[i].file, sizeof(pins[i].file), "%i.wav", i + 1);
+
+		sprintf(key, "pin%i_volume", i + 1);
+		config.readValue("io", key, &pin->volume);
+		sprintf(key, "pin%i_rate", i + 1);
+		config.readValue("io", key, &pin->rate);
+		sprintf(key, "pin%i_priority", i + 1);
+		config.readValue("io", key, &pin->priority);
+		sprintf(key, "pin%i_debounce", i + 1);
+		config.readValue("io", key, &pin->debounce);
+	}
+
+	config.readValue("latch", "latch_polarity", &s->latch_polarity);
+	config.readValue("latch", "input_polarity", &s->input_polarity);
+	config.readValue("latch", "polyphony", &s->polyphony);
+	config.readValue("latch", "volume", &s->latch_volume);
+
+	len = sizeof(tmp);
+	if (config.readValue("latch", "steal", tmp, &len) && strncasecmp("none", tmp, len) == 0)
+		s->steal = LatchStealNone;
+
+	len = SETTINGS_NAME_LEN;
+	config.readValue("latch", "group", s->latch_group, &len);
+}
+
+static const char* pinFile(const PinSettings* pin, uint8_t num, char* buffer)
+{
+	if (pin->file != STRING_POOL_INVALID)
+		return StringPool::getInstance().get(pin->file);
+
+	sprintf(buffer, "%i.wav", num + 1);
+	return buffer;
+}
+
+#define CHECK_FIELD(field)		CHECK(memcmp(&legacy.field, &current.field, sizeof(legacy.field)) == 0)
+#define CHECK_STRING(field)		CHECK(strcmp(legacy.field, current.field) == 0)
+
+// Pins whose mode has capital letters, read differently on purpose
+#define PINS_WITH_CASE			(1 << 5)
+
+static void testCompatibility(Settings& legacy, LegacyPin* legacy_pins, Settings& current)
+{
+	CHECK_FIELD(mode);
+	CHECK_FIELD(sample_rate);
+	CHECK_FIELD(speakers_volume);
+	CHECK_FIELD(headphone_volume);
+	CHECK_FIELD(baudrate);
+	CHECK_FIELD(disable_leds);
+	CHECK_FIELD(serial_control);
+	CHECK_FIELD(wav_index);
+	CHECK_FIELD(low_power_timeout);
+	CHECK_FIELD(limiter);
+	CHECK_FIELD(limiter_threshold);
+	CHECK_FIELD(limiter_release);
+	CHECK_FIELD(resampler);
+	CHECK_FIELD(group_volumes);
+	CHECK_FIELD(reserved_voices);
+	CHECK_FIELD(reserved_priority);
+	CHECK_FIELD(selector_pins);
+	CHECK_FIELD(selector_active_low);
+	CHECK_FIELD(selector_settle);
+	CHECK_FIELD(selector_stop);
+	CHECK_FIELD(selector_polyphony);
+	CHECK_FIELD(selector_steal);
+	CHECK_FIELD(selector_volume);
+	CHECK_STRING(selector_group);
+	CHECK_FIELD(latch_polarity);
+	CHECK_FIELD(input_polarity);
+	CHECK_FIELD(polyphony);
+	CHECK_FIELD(steal);
+	CHECK_FIELD(latch_volume);
+	CHECK_STRING(latch_group);
+
+	for (uint8_t i = 0; i < MIXER_MAX_GROUPS; i++)
+		CHECK_STRING(group_names[i]);
+
+	for (uint8_t i = 0; i < MAX_PLAYERS; i++)
+		CHECK_STRING(channel_groups[i]);
+
+	for (uint8_t i = 0; i < IO_PINS_COUNT; i++)
+	{
+		PinSettings* a = &legacy.pins[i];
+		PinSettings* b = &current.pins[i];
+		char buffer[16];
+
+		CHECK_EQ(a->configured, b->configured);
+		if (!a->configured)
+			continue;
+
+		if (PINS_WITH_CASE & (1 << i))
+		{
+			CHECK_EQ(a->playback, PlayModeNormal);
+			CHECK_EQ(a->trigger, LevelTrigger);
+		} else {
+			CHECK_EQ(a->playback, b->playback);
+			CHECK_EQ(a->polarity, b->polarity);
+			CHECK_EQ(a->trigger, b->trigger);
+			CHECK_EQ(a->deassert, b->deassert);
+		}
+
+		CHECK_EQ(a->select, b->select);
+		CHECK_EQ(a->volume, b->volume);
+		CHECK_EQ(a->rate, b->rate);
+		CHECK_EQ(a->debounce, b->debounce);
+		CHECK_EQ(a->priority, b->priority);
+		CHECK(strcmp(a->group, b->group) == 0);
+		CHECK(strcmp(legacy_pins[i].file, pinFile(b, i, buffer)) == 0);
+	}
+}
+
+// What the fixture holds, spelled out, and what changed on purpose
+static void testValues(Settings& s)
+{
+	char buffer[16];
+
+	CHECK_EQ(s.mode, MODE_IO);
+	CHECK_EQ(s.sample_rate, 48000);
+	CHECK_EQ(s.speakers_volume, -6.5f);
+	CHECK_EQ(s.headphone_volume, 3);
+	CHECK_EQ(s.baudrate, 57600);
+	CHECK(s.disable_leds);
+	CHECK(s.serial_control);
+	CHECK(!s.wav_index);
+	CHECK(s.limiter);
+	CHECK_EQ(s.resampler, ResamplerLinear);
+	CHECK(strcmp(s.group_names[1], "sfx") == 0);
+	CHECK_EQ(s.group_volumes[1], 0.8f);
+	CHECK(strcmp(s.channel_groups[9], "sfx") == 0);
+	CHECK_EQ(s.selector_pins, 0xF000);
+
+	CHECK(s.pins[1].configured);
+	CHECK_EQ(s.pins[1].playback, PlayModeLoop);
+	CHECK_EQ(s.pins[1].trigger, EdgeTrigger);
+	CHECK(strcmp(pinFile(&s.pins[1], 1, buffer), "drums/*.wav") == 0);
+	CHECK_EQ(s.pins[2].deassert, DeassertStop);
+	CHECK_EQ(s.pins[2].polarity, PinActiveLow);
+	CHECK_EQ(s.pins[3].deassert, DeassertPause);
+	CHECK_EQ(s.pins[3].select, SelectSequence);
+	CHECK(strcmp(pinFile(&s.pins[3], 3, buffer), "a.wav, b.wav") == 0);
+	CHECK_EQ(s.pins[4].playback, PlayModeLoop);
+
+	// An empty pinN_mode still enables the pin, an empty file is the default
+	CHECK(s.pins[8].configured);
+	CHECK(strcmp(pinFile(&s.pins[7], 7, buffer), "8.wav") == 0);
+
+	// A file without pinN_mode doesn't enable the pin
+	CHECK(!s.pins[6].configured);
+	CHECK(!s.pins[9].configured);
+
+	// The old code ignored the mode words with capital letters
+	CHECK_EQ(s.pins[5].playback, PlayModeLoop);
+	CHECK_EQ(s.pins[5].trigger, EdgeTrigger);
+	CHECK_EQ(s.pins[5].polarity, PinActiveLow);
+}
+
+// A copy of the fixture in build/, where the image is written
+static void copyConfig(const char* extra, time_t mtime)
+{
+	char line[SETTINGS_MAX_LINE];
+	FILE* in = fopen("fixtures/config.ini", "rb");
+	FILE* out = fopen("build/config.ini", "wb");
+	struct utimbuf times;
+
+	while (in && out && fgets(line, sizeof(line), in))
+		fputs(line, out);
+
+	if (out && extra)
+		fputs(extra, out);
+
+	if (in)
+		fclose(in);
+	if (out)
+		fclose(out);
+
+	times.actime = mtime;
+	times.modtime = mtime;
+	utime("build/config.ini", &times);
+}
+
+// Loads through the image and checks the result against a plain parse
+static bool loadCached(const Settings& parsed, const char* parsed_pool, uint32_t parsed_used)
+{
+	static Settings cached;
+	StringPool& pool = StringPool::getInstance();
+	bool from_cache = false;
+
+	pool.reset();
+	CHECK(settingsLoadCached("config.ini", "config.bin", &cached, &from_cache));
+	CHECK(memcmp(&cached, &parsed, sizeof(Settings)) == 0);
+	CHECK_EQ(pool.getUsed(), parsed_used);
+	CHECK(memcmp(pool.getData(), parsed_pool, parsed_used) == 0);
+	return from_cache;
+}
+
+static void testCache()
+{
+	static Settings parsed;
+	static char parsed_pool[STRING_POOL_SIZE];
+	StringPool& pool = StringPool::getInstance();
+	time_t mtime = 1600000000;
+	uint32_t used;
+	bool from_cache;
+
+	host_ff_root = "build";
+	f_unlink("config.bin");
+	copyConfig(NULL, mtime);
+
+	pool.reset();
+	CHECK(settingsLoad("config.ini", &parsed));
+	used = pool.getUsed();
+	memcpy(parsed_pool, pool.getData(), used);
+
+	// Parsed and written the first time, read back after
+	CHECK(!loadCached(parsed, parsed_pool, used));
+	CHECK(loadCached(parsed, parsed_pool, used));
+	CHECK(loadCached(parsed, parsed_pool, used));
+
+	// Touched: a new time drops the image
+	copyConfig(NULL, mtime + 10);
+	CHECK(!loadCached(parsed, parsed_pool, used));
+	CHECK(loadCached(parsed, parsed_pool, used));
+
+	// Changed at the same time: the size drops it
+	copyConfig("\r\n; a comment\r\n", mtime + 10);
+	CHECK(!loadCached(parsed, parsed_pool, used));
+	CHECK(loadCached(parsed, parsed_pool, used));
+
+	// A damaged image is parsed again, and rewritten
+	FILE* f = fopen("build/config.bin", "r+b");
+	if (f)
+	{
+		fseek(f, sizeof(SettingsCacheHeader) + 8, SEEK_SET);
+		fputc(0x55, f);
+		fclose(f);
+	}
+
+	CHECK(!loadCached(parsed, parsed_pool, used));
+	CHECK(loadCached(parsed, parsed_pool, used));
+
+	// No config.ini, no settings
+	remove("build/config.ini");
+	pool.reset();
+	CHECK(!settingsLoadCached("config.ini", "config.bin", &parsed, &from_cache));
+
+	host_ff_root = "fixtures";
+}
+
+static void benchmark(LegacyConfig& config, Settings* settings, LegacyPin* pins)
+{
+	const uint32_t rounds = 2000;
+	StringPool& pool = StringPool::getInstance();
+	uint64_t start;
+	uint64_t current;
+	uint64_t legacy;
+
+	start = testNanoseconds();
+	for (uint32_t i = 0; i < rounds; i++)
+	{
+		pool.reset();
+		settingsLoad("config.ini", settings);
+	}
+	current = testNanoseconds() - start;
+
+	config.scans = 0;
+	start = testNanoseconds();
+	for (uint32_t i = 0; i < rounds; i++)
+		legacyLoad(config, settings, pins);
+	legacy = testNanoseconds() - start;
+
+	printf("settings: one pass %.1f us, one scan per key %.1f us (%u scans)\n",
+		   current / 1000.0 / rounds, legacy / 1000.0 / rounds, config.scans / rounds);
+
+	// What the boot does, from the image
+	bool from_cache;
+	host_ff_root = "build";
+	copyConfig(NULL, 1600000000);
+	f_unlink("config.bin");
+	pool.reset();
+	settingsLoadCached("config.ini", "config.bin", settings, &from_cache);
+
+	start = testNanoseconds();
+	for (uint32_t i = 0; i < rounds; i++)
+	{
+		pool.reset();
+		settingsLoadCached("config.ini", "config.bin", settings, &from_cache);
+	}
+	current = testNanoseconds() - start;
+	host_ff_root = "fixtures";
+
+	printf("settings: from config.bin %.1f us\n", current / 1000.0 / rounds);
+}
+
+int main(int argc, char** argv)
+{
+	static Settings legacy;
+	static Settings current;
+	static LegacyPin legacy_pins[IO_PINS_COUNT];
+	LegacyConfig config;
+
+	host_ff_root = "fixtures";
+
+	if (!config.begin("config.ini"))
+	{
+		printf("fixtures/config.ini not found\n");
+		return 1;
+	}
+
+	legacyLoad(config, &legacy, legacy_pins);
+	CHECK(settingsLoad("config.ini", &current));
+
+	testCompatibility(legacy, legacy_pins, current);
+	testValues(current);
+	testCache();
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+		benchmark(config, &current, legacy_pins);
+
+	return testResult("settings");
+}
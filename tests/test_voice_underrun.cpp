@@ -0,0 +1,219 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### test_voice_underrun.cpp
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+#include "test.h"
+#include "Voice.h"
+#include "Mixer.h"
+
+// Starves a voice on purpose: the audio keeps rendering while poll() isn't
+// called, so the ring buffer runs empty. Every short render must count as
+// one underrun, the lowest fill must go down to zero, and once poll() is
+// back the audio must carry on from where it stopped. Running out of data
+// at the end of the file isn't an underrun. A block counts once, also
+// when the resampler reads it in several chunks.
+
+#define SAMPLE_RATE		44100
+#define FRAMES			SAMPLE_RATE
+#define BLOCK			MIXER_BLOCK_FRAMES
+
+static Voice voice;
+static int16_t out[BLOCK * 2];
+
+// A ramp, so every frame says where it came from
+static void writeWav(const char* name, uint32_t frames)
+{
+	uint8_t header[44];
+	FIL file;
+	UINT bw;
+
+	memcpy(header, "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0", 24);
+	uint32_t values[] = { SAMPLE_RATE, SAMPLE_RATE * 2 };
+	memcpy(header + 24, values, 8);
+	memcpy(header + 32, "\x02\0\x10\0data", 8);
+	uint32_t size = frames * 2;
+	memcpy(header + 40, &size, 4);
+
+	f_open(&file, name, FA_WRITE | FA_CREATE_ALWAYS);
+	f_write(&file, header, sizeof(header), &bw);
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		int16_t s = (int16_t) i;
+		f_write(&file, &s, 2, &bw);
+	}
+
+	f_close(&file);
+}
+
+// Renders a block and checks it continues the ramp from 'next'.
+// Returns the frames that came from the file.
+static uint32_t render(uint32_t* next)
+{
+	uint32_t rendered = voice.render(out, BLOCK);
+
+	for (uint32_t i = 0; i < BLOCK; i++)
+	{
+		int16_t expected = (i < rendered) ? (int16_t) (*next + i) : 0;
+
+		if (out[i * 2] != expected || out[i * 2 + 1] != expected)
+		{
+			printf("frame %u: %i %i, expected %i\n", *next + i, out[i * 2], out[i * 2 + 1], expected);
+			test_failures++;
+			break;
+		}
+	}
+
+	*next += rendered;
+	return rendered;
+}
+
+static void testUnderruns()
+{
+	uint32_t next = 0;
+	uint32_t short_renders = 0;
+
+	CHECK(voice.play("ramp.wav"));
+	voice.resetStats();
+
+	// Polled like the main loop does, the buffer never runs dry
+	for (uint32_t n = 0; n < 100; n++)
+	{
+		CHECK_EQ(render(&next), BLOCK);
+		voice.poll();
+	}
+
+	CHECK_EQ(voice.getUnderruns(), 0);
+	CHECK(voice.getMinFill() > 0);
+	CHECK(voice.getMinFill() < VOICE_BUFFER_SIZE);
+
+	// No poll(): what is in the buffer plays, then silence
+	uint32_t buffered = next;
+	for (uint32_t n = 0; n < 100; n++)
+	{
+		if (render(&next) < BLOCK)
+			short_renders++;
+	}
+
+	buffered = next - buffered;
+	CHECK(buffered > 0);
+	CHECK(buffered <= VOICE_BUFFER_SIZE / 2);
+	CHECK(short_renders > 1);
+	CHECK_EQ(voice.getUnderruns(), short_renders);
+	CHECK_EQ(voice.getMinFill(), 0);
+	CHECK(voice.isMixing());
+
+	// Back to polling, the ramp goes on without a gap
+	uint32_t underruns = voice.getUnderruns();
+	voice.poll();
+	voice.resetStats();
+	CHECK_EQ(voice.getUnderruns(), 0);
+	CHECK_EQ(voice.getMinFill(), VOICE_BUFFER_SIZE);
+
+	while (voice.isMixing())
+	{
+		uint32_t before = next;
+		if (render(&next) < BLOCK)
+			CHECK_EQ(next, FRAMES);
+
+		voice.poll();
+
+		if (next == before)
+			break;
+	}
+
+	CHECK_EQ(next, FRAMES);
+	CHECK_EQ(voice.getUnderruns(), 0);
+	CHECK(voice.getMinFill() > 0);
+	CHECK(underruns > 0);
+
+	voice.poll();
+	CHECK_EQ(voice.getStatus(), AudioSourceStopped);
+}
+
+// With a playback rate the resampler reads every block in chunks, several
+// of which come up short when the buffer runs dry
+static void testResampled()
+{
+	uint32_t rendered = 0;
+	uint32_t short_renders = 0;
+
+	CHECK(voice.play("ramp.wav"));
+	voice.setRate(1.5f);
+	voice.resetStats();
+
+	for (uint32_t n = 0; n < 200; n++)
+	{
+		uint32_t count = voice.render(out, BLOCK);
+		rendered += count;
+		if (count < BLOCK)
+			short_renders++;
+	}
+
+	CHECK(rendered > 0);
+	CHECK(short_renders > 100);
+	CHECK_EQ(voice.getUnderruns(), short_renders);
+	CHECK_EQ(voice.getMinFill(), 0);
+
+	voice.stop();
+	voice.setRate(1.0f);
+}
+
+// Same with a compressed file, looped so it never reaches the end: blocks
+// are only released once decoded
+static void testAdpcm()
+{
+	uint32_t rendered = 0;
+	uint32_t short_renders = 0;
+
+	host_ff_root = "fixtures";
+	CHECK(voice.play("ima_mono.wav", PlayModeLoop));
+	host_ff_root = "build";
+	voice.resetStats();
+
+	for (uint32_t n = 0; n < 200; n++)
+	{
+		uint32_t count = voice.render(out, BLOCK);
+		rendered += count;
+		if (count < BLOCK)
+			short_renders++;
+	}
+
+	CHECK(rendered > 0);
+	CHECK_EQ(voice.getUnderruns(), short_renders);
+	CHECK(short_renders > 1);
+	CHECK_EQ(voice.getMinFill(), 0);
+
+	voice.stop();
+}
+
+int main()
+{
+	host_ff_root = "build";
+	writeWav("ramp.wav", FRAMES);
+	Voice::setOutput(SAMPLE_RATE, ResamplerLinear);
+
+	testUnderruns();
+	testResampled();
+	testAdpcm();
+
+	return testResult("voice");
+}
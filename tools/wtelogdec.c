@@ -0,0 +1,300 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### wtelogdec.c
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+/*
+ * Decoder for the binary debug log (see DebugLog.h).
+ *
+ * Usage: wtelogdec firmware.elf [capture.bin]
+ *
+ * The capture is the raw output of the debug serial port, read from stdin
+ * if not given. Format strings are looked up by address in the allocated
+ * sections of the ELF file the board is running.
+ *
+ * Build: cc -O2 -o wtelogdec wtelogdec.c
+ */
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_SYNC			0x5AA5
+#define LOG_MAX_RECORD		96
+#define LOG_DROPPED			0
+
+typedef struct
+{
+	uint32_t addr;
+	uint32_t size;
+	uint8_t* data;
+} Section;
+
+static Section* sections = NULL;
+static uint32_t sections_count = 0;
+
+static uint16_t get16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// Loads the allocated sections with contents of a 32-bit little endian ELF
+static int loadElf(const char* path)
+{
+	FILE* f = fopen(path, "rb");
+	Elf32_Ehdr eh;
+	Elf32_Shdr sh;
+
+	if (!f)
+		return 0;
+
+	if (fread(&eh, sizeof(eh), 1, f) != 1 || memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 ||
+		eh.e_ident[EI_CLASS] != ELFCLASS32 || eh.e_ident[EI_DATA] != ELFDATA2LSB)
+	{
+		fclose(f);
+		return 0;
+	}
+
+	sections = calloc(eh.e_shnum, sizeof(Section));
+	for (uint32_t i = 0; i < eh.e_shnum; i++)
+	{
+		if (fseek(f, eh.e_shoff + i * eh.e_shentsize, SEEK_SET) != 0 ||
+			fread(&sh, sizeof(sh), 1, f) != 1)
+			break;
+
+		if (!(sh.sh_flags & SHF_ALLOC) || sh.sh_type != SHT_PROGBITS || !sh.sh_size)
+			continue;
+
+		Section* s = &sections[sections_count];
+		s->addr = sh.sh_addr;
+		s->size = sh.sh_size;
+		s->data = malloc(sh.sh_size);
+
+		if (fseek(f, sh.sh_offset, SEEK_SET) != 0 || fread(s->data, sh.sh_size, 1, f) != 1)
+		{
+			free(s->data);
+			continue;
+		}
+
+		sections_count++;
+	}
+
+	fclose(f);
+	return sections_count != 0;
+}
+
+// Returns the string at 'addr' in the firmware, NULL if there's none
+static const char* lookup(uint32_t addr)
+{
+	for (uint32_t i = 0; i < sections_count; i++)
+	{
+		Section* s = &sections[i];
+		if (addr >= s->addr && addr < s->addr + s->size &&
+			memchr(&s->data[addr - s->addr], 0, s->addr + s->size - addr))
+			return (const char*) &s->data[addr - s->addr];
+	}
+
+	return NULL;
+}
+
+// Formats 'fmt' taking the arguments from the record
+static void format(const char* fmt, const uint8_t* args, const uint8_t* end)
+{
+	char spec[32];
+	char text[LOG_MAX_RECORD + 1];
+
+	while (*fmt)
+	{
+		if (*fmt != '%')
+		{
+			putchar(*fmt++);
+			continue;
+		}
+
+		if (fmt[1] == '%')
+		{
+			putchar('%');
+			fmt += 2;
+			continue;
+		}
+
+		// Copy the conversion without the length modifiers
+		size_t n = 0;
+		spec[n++] = *fmt++;
+		while (*fmt && strchr("-+ #0123456789.", *fmt) && n < sizeof(spec) - 2)
+			spec[n++] = *fmt++;
+		while (*fmt && strchr("hlzjt", *fmt))
+			fmt++;
+
+		char conv = *fmt ? *fmt++ : 0;
+		spec[n++] = conv;
+		spec[n] = 0;
+
+		if (args >= end)
+		{
+			printf("<?>");
+			continue;
+		}
+
+		uint8_t tag = *args++;
+		if (tag == 's')
+		{
+			uint8_t len = (args < end) ? *args++ : 0;
+			if (args + len > end)
+				len = end - args;
+
+			memcpy(text, args, len);
+			text[len] = 0;
+			args += len;
+			printf(conv == 's' ? spec : "%s", text);
+			continue;
+		}
+
+		if (args + 4 > end)
+		{
+			printf("<?>");
+			args = end;
+			continue;
+		}
+
+		uint32_t value = get32(args);
+		args += 4;
+
+		if (conv == 's')
+		{
+			// A string that lives in the firmware, or a pointer
+			const char* str = lookup(value);
+			if (str)
+				printf(spec, str);
+			else
+				printf("<0x%08x>", value);
+		} else if (tag == 'f' || strchr("feEgGaA", conv))
+		{
+			float f;
+			memcpy(&f, &value, 4);
+			printf(strchr("feEgGaA", conv) ? spec : "%f", (double) f);
+		} else if (tag == 'i' && strchr("di", conv))
+		{
+			printf(spec, (int32_t) value);
+		} else if (conv == 'p')
+		{
+			printf("0x%08x", value);
+		} else {
+			printf(strchr("uxXoc", conv) ? spec : "%u", value);
+		}
+	}
+}
+
+static void decode(const uint8_t* rec, uint32_t len)
+{
+	uint8_t level = rec[2];
+	uint32_t timestamp = get32(&rec[4]);
+	uint32_t fmt_addr = get32(&rec[8]);
+	const char* fmt;
+
+	printf("[ %010u ] ", timestamp);
+
+	if (level & 0x01)
+		printf("(ERROR) ");
+	else if (level & 0x02)
+		printf("(WARNING) ");
+	else
+		printf("(INFO) ");
+
+	if (fmt_addr == LOG_DROPPED)
+		format("%u records dropped", &rec[12], rec + len);
+	else if ((fmt = lookup(fmt_addr)) != NULL)
+		format(fmt, &rec[12], rec + len);
+	else
+		printf("<unknown format 0x%08x>", fmt_addr);
+
+	putchar('\n');
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t buf[2 + LOG_MAX_RECORD];
+	uint32_t fill = 0;
+	FILE* in = stdin;
+	size_t n;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s firmware.elf [capture.bin]\n", argv[0]);
+		return 1;
+	}
+
+	if (!loadElf(argv[1]))
+	{
+		fprintf(stderr, "%s: cannot read ELF file %s\n", argv[0], argv[1]);
+		return 1;
+	}
+
+	if (argc > 2 && !(in = fopen(argv[2], "rb")))
+	{
+		fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[2]);
+		return 1;
+	}
+
+	// Find the sync word, then take the whole record. If the header
+	// doesn't make sense skip a byte and look for the next sync word.
+	while ((n = fread(&buf[fill], 1, sizeof(buf) - fill, in)) > 0 || fill)
+	{
+		fill += n;
+
+		if (fill < 2 + 12)
+		{
+			if (!n)
+				break;
+			continue;
+		}
+
+		uint32_t len = get16(&buf[2]);
+		if (get16(buf) != LOG_SYNC || len < 12 || len > LOG_MAX_RECORD)
+		{
+			memmove(buf, &buf[1], --fill);
+			continue;
+		}
+
+		if (fill < 2 + len)
+		{
+			if (!n)
+				break;
+			continue;
+		}
+
+		decode(&buf[2], len);
+		fill -= 2 + len;
+		memmove(buf, &buf[2 + len], fill);
+	}
+
+	if (in != stdin)
+		fclose(in);
+
+	return 0;
+}
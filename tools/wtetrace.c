@@ -0,0 +1,322 @@
+/***************************************************************************
+ * Artekit Wavetooeasy
+ * https://www.artekit.eu/products/devboards/wavetooeasy
+ *
+   Written by Ivan Meleca
+ * Copyright (c) 2021 Artekit Labs
+ * https://www.artekit.eu
+
+### wtetrace.c
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+
+***************************************************************************/
+
+
+
+/*
+ * Converts the event trace recorded on the SD card (see Trace.h) to a
+ * timeline.
+ *
+ * Usage: wtetrace trace.bin [...]
+ *
+ * Several files are printed one after the other, pass trace.old before
+ * trace.bin to get the whole history. Times are seconds since the board
+ * started, a "start" line marks every boot.
+ *
+ * Build: cc -O2 -o wtetrace wtetrace.c
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../WaveTooEasy_protocol.h"
+
+#define TRACE_MAGIC			0x54455457
+#define TRACE_VERSION		1
+#define TRACE_HEADER_SIZE	16
+#define TRACE_RECORD_SIZE	12
+
+enum
+{
+	TracePadding,
+	TraceStart,
+	TraceInput,
+	TraceLatch,
+	TracePlay,
+	TracePlayError,
+	TracePlayer,
+	TraceUnderrun,
+	TraceCommand,
+	TraceError,
+	TraceReload,
+	TraceLowPower,
+	TraceSuspend,
+	TraceWake,
+	TraceDropped,
+};
+
+typedef struct
+{
+	uint8_t code;
+	const char* name;
+} CodeName;
+
+static const CodeName commands[] =
+{
+	{ CMD_HELLO, "hello" },
+	{ CMD_VERSION, "version" },
+	{ CMD_PLAY_FILE, "play file" },
+	{ CMD_PLAY_CHANNEL, "play channel" },
+	{ CMD_STOP_ALL, "stop all" },
+	{ CMD_STOP, "stop" },
+	{ CMD_PAUSE, "pause" },
+	{ CMD_PAUSE_ALL, "pause all" },
+	{ CMD_RESUME, "resume" },
+	{ CMD_RESUME_ALL, "resume all" },
+	{ CMD_CHANNELS_STATUS, "channels status" },
+	{ CMD_CHANNEL_STATUS, "channel status" },
+	{ CMD_GET_CHANNEL_VOL, "get channel volume" },
+	{ CMD_SET_CHANNEL_VOL, "set channel volume" },
+	{ CMD_SET_SPEAKERS_VOL, "set speakers volume" },
+	{ CMD_SET_HEADPHONE_VOL, "set headphone volume" },
+	{ CMD_GET_SPEAKERS_VOL, "get speakers volume" },
+	{ CMD_GET_HEADPHONE_VOL, "get headphone volume" },
+	{ CMD_GET_GAIN_REDUCTION, "get gain reduction" },
+	{ CMD_GET_CHANNEL_RATE, "get channel rate" },
+	{ CMD_SET_CHANNEL_RATE, "set channel rate" },
+	{ CMD_GET_CHANNEL_GROUP, "get channel group" },
+	{ CMD_SET_CHANNEL_GROUP, "set channel group" },
+	{ CMD_STOP_GROUP, "stop group" },
+	{ CMD_PAUSE_GROUP, "pause group" },
+	{ CMD_RESUME_GROUP, "resume group" },
+	{ CMD_GET_GROUP_VOL, "get group volume" },
+	{ CMD_SET_GROUP_VOL, "set group volume" },
+	{ CMD_GET_INPUT_STATS, "get input stats" },
+	{ CMD_GET_BOOT_PROFILE, "get boot profile" },
+	{ CMD_RELOAD_CONFIG, "reload config" },
+	{ CMD_GET_PROFILE, "get profile" },
+	{ CMD_GET_CHANNEL_STATS, "get channel stats" },
+	{ CMD_GET_SD_STATS, "get SD stats" },
+};
+
+static const CodeName errors[] =
+{
+	{ ERROR_NOT_ENOUGH_BUFFER, "not enough buffer" },
+	{ ERROR_INVALID_LENGTH, "invalid length" },
+	{ ERROR_INVALID_FILE_LENGTH, "invalid file length" },
+	{ ERROR_INVALID_CHANNEL, "invalid channel" },
+	{ ERROR_INVALID_MODE, "invalid mode" },
+	{ ERROR_INTERNAL, "internal" },
+	{ ERROR_PLAYING, "playing" },
+	{ ERROR_CRC16_MISMATCH, "CRC16 mismatch" },
+	{ ERROR_INVALID_GROUP, "invalid group" },
+	{ ERROR_INVALID_STAGE, "invalid stage" },
+	{ ERROR_NOT_PAUSED, "not paused" },
+	{ ERROR_NOT_PLAYING, "not playing" },
+	{ ERROR_ON_RX, "on RX" },
+	{ ERROR_RX_TIMEOUT, "RX timeout" },
+	{ ERROR_PARAM, "parameter" },
+};
+
+// As in playerStatus, Player.h
+static const char* const player_status[] =
+{
+	"stopped", "playing", "paused", "pausing", "stopping"
+};
+
+static const char* const modes[] =
+{
+	"?", "io", "latched", "serial"
+};
+
+#define COUNT_OF(x)		(sizeof(x) / sizeof(x[0]))
+
+static uint16_t get16(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static const char* codeName(const CodeName* table, uint32_t count, uint8_t code)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (table[i].code == code)
+			return table[i].name;
+	}
+
+	return "unknown";
+}
+
+// Prints one record, returns its size including a trailing
+// name, or 0 if it doesn't fit in 'len' bytes
+static uint32_t decode(const uint8_t* rec, uint32_t len)
+{
+	uint32_t time = get32(rec);
+	uint8_t event = rec[4];
+	uint8_t arg = rec[5];
+	uint16_t value = get16(&rec[6]);
+	uint32_t data = get32(&rec[8]);
+	uint32_t size = TRACE_RECORD_SIZE;
+
+	if (event == TracePlay || event == TracePlayError)
+		size += (value + 3) & ~3;
+
+	if (size > len)
+		return 0;
+
+	printf("%6u.%03u  ", time / 1000, time % 1000);
+
+	switch (event)
+	{
+		case TraceStart:
+			printf("start, mode %s, version %u.%u.%u\n", modes[arg < COUNT_OF(modes) ? arg : 0],
+				   value >> 8, value & 0xFF, data);
+			break;
+
+		case TraceInput:
+			printf("input     changed 0x%04x, levels 0x%04x\n", value, data);
+			break;
+
+		case TraceLatch:
+			printf("latch     %u\n", value);
+			break;
+
+		case TracePlay:
+		case TracePlayError:
+			printf("ch %-2u     %s \"%.*s\"%s\n", arg, event == TracePlay ? "play" : "cannot play",
+				   value, (const char*) &rec[TRACE_RECORD_SIZE], data ? " (loop)" : "");
+			break;
+
+		case TracePlayer:
+			printf("ch %-2u     %s\n", arg, value < COUNT_OF(player_status) ? player_status[value] : "?");
+			break;
+
+		case TraceUnderrun:
+			printf("ch %-2u     underrun, %u so far\n", arg, data);
+			break;
+
+		case TraceCommand:
+			printf("serial    0x%02x %s, %u bytes\n", arg, codeName(commands, COUNT_OF(commands), arg), value);
+			break;
+
+		case TraceError:
+			printf("serial    error 0x%02x %s\n", arg, codeName(errors, COUNT_OF(errors), arg));
+			break;
+
+		case TraceReload:
+			printf("reload    pins 0x%04x, flags 0x%02x\n", value, arg);
+			break;
+
+		case TraceLowPower:
+			printf("low power\n");
+			break;
+
+		case TraceSuspend:
+			printf("suspend\n");
+			break;
+
+		case TraceWake:
+			if (arg)
+				printf("wake      pins 0x%04x, levels 0x%04x\n", value, data);
+			else
+				printf("wake\n");
+			break;
+
+		case TraceDropped:
+			printf("dropped   %u records so far\n", data);
+			break;
+
+		default:
+			printf("unknown event %u\n", event);
+			break;
+	}
+
+	return size;
+}
+
+static int convert(const char* path)
+{
+	uint8_t header[TRACE_HEADER_SIZE];
+	uint8_t* block;
+	uint32_t block_size;
+	FILE* in;
+	size_t len;
+
+	if (!(in = fopen(path, "rb")))
+	{
+		fprintf(stderr, "wtetrace: cannot open %s\n", path);
+		return 0;
+	}
+
+	if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+		get32(header) != TRACE_MAGIC || get16(&header[4]) != TRACE_VERSION)
+	{
+		fprintf(stderr, "wtetrace: %s is not a trace file\n", path);
+		fclose(in);
+		return 0;
+	}
+
+	block_size = get16(&header[6]);
+	if (block_size < TRACE_HEADER_SIZE || !(block = malloc(block_size)))
+	{
+		fprintf(stderr, "wtetrace: %s has a bad block size\n", path);
+		fclose(in);
+		return 0;
+	}
+
+	printf("%s, file %u\n", path, get32(&header[8]));
+
+	// Records never cross a block, the unused end of a
+	// block is zeroed. The first block starts with the header.
+	memcpy(block, header, sizeof(header));
+	len = sizeof(header) + fread(&block[sizeof(header)], 1, block_size - sizeof(header), in);
+
+	for (uint32_t pos = TRACE_HEADER_SIZE; len > 0; pos = 0)
+	{
+		while (pos + TRACE_RECORD_SIZE <= len && block[pos + 4] != TracePadding)
+		{
+			uint32_t size = decode(&block[pos], len - pos);
+			if (!size)
+				break;
+
+			pos += size;
+		}
+
+		len = fread(block, 1, block_size, in);
+	}
+
+	free(block);
+	fclose(in);
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	int ok = 1;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s trace.bin [...]\n", argv[0]);
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++)
+		ok &= convert(argv[i]);
+
+	return ok ? 0 : 1;
+}